@@ -33,10 +33,11 @@
 #include <stdio.h>
 #include <float.h>
 #include <math.h>
-#include <pthread.h>
 
 #include "khashl.h"
 #include "kvec.h"
+#include "kalloc.h"
+#include "kthread.h"
 
 #include "syncmer.h"
 #include "syncasm.h"
@@ -44,6 +45,33 @@
 
 #undef DEBUG_READ_ALIGNMENT
 
+#ifdef DEBUG_READ_ALIGNMENT
+#include <pthread.h>
+// keeps debug dumps of concurrent workers from interleaving
+static pthread_mutex_t dbg_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// snapshot of the unitig graph a set of read alignments was made against
+// used to carry alignments over to the next alignment round for reads
+// not touched by the graph updates in between
+typedef struct {
+    uint64_t n_utg;
+    uint64_t *s_idx; // syncmer list of unitig u in s[s_idx[u]..s_idx[u+1]], empty for deleted unitigs
+    uint64_t *s;
+    uint64_t *a_idx; // arcs of vertex v in a[a_idx[v]..a_idx[v+1]]
+    uint128_t *a; // w << 64 | ln
+} ra_ref_t;
+
+static void ra_ref_destroy(ra_ref_t *ref)
+{
+    if (!ref) return;
+    free(ref->s_idx);
+    free(ref->s);
+    free(ref->a_idx);
+    free(ref->a);
+    free(ref);
+}
+
 static void scg_ra_v_clean(scg_ra_v *ra_v)
 {
     if (!ra_v) return;
@@ -57,9 +85,179 @@ void scg_ra_v_destroy(scg_ra_v *ra_v)
 {
     if (!ra_v) return;
     scg_ra_v_clean(ra_v);
+    ra_ref_destroy((ra_ref_t *) ra_v->ref);
     free(ra_v);
 }
 
+KHASHL_MAP_INIT(KH_LOCAL, kh_u64_t, kh_u64, uint64_t, uint64_t, kh_hash_uint64, kh_eq_generic)
+
+static ra_ref_t *ra_ref_snapshot(scg_t *g)
+{
+    uint64_t i, j, n, v;
+    asmg_t *ug;
+    asmg_vtx_t *utg;
+    asmg_arc_t *a;
+    ra_ref_t *ref;
+    kvec_t(uint64_t) s;
+    kvec_t(uint128_t) arc;
+
+    ug = g->utg_asmg;
+    MYCALLOC(ref, 1);
+    ref->n_utg = ug->n_vtx;
+    MYMALLOC(ref->s_idx, ref->n_utg + 1);
+    MYMALLOC(ref->a_idx, ref->n_utg * 2 + 1);
+    kv_init(s);
+    kv_init(arc);
+    for (i = 0; i < ref->n_utg; ++i) {
+        utg = &ug->vtx[i];
+        ref->s_idx[i] = s.n;
+        ref->a_idx[i<<1] = ref->a_idx[i<<1|1] = arc.n;
+        if (utg->del)
+            continue;
+        kv_pushn(uint64_t, s, utg->a, utg->n);
+        for (v = i<<1; v <= (i<<1|1); ++v) {
+            ref->a_idx[v] = arc.n;
+            a = asmg_arc_a(ug, v);
+            for (j = 0, n = asmg_arc_n(ug, v); j < n; ++j) {
+                // only the arc seen by asmg_arc1()
+                if (a[j].del || asmg_arc1(ug, v, a[j].w) != &a[j])
+                    continue;
+                kv_push(uint128_t, arc, (uint128_t) a[j].w << 64 | a[j].ln);
+            }
+        }
+    }
+    ref->s_idx[ref->n_utg] = s.n;
+    ref->a_idx[ref->n_utg * 2] = arc.n;
+    ref->s = s.a;
+    ref->a = arc.a;
+
+    return ref;
+}
+
+static inline uint64_t ra_mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// orientation independent hash of a unitig syncmer list
+static uint64_t utg_list_hash(uint64_t *a, uint64_t n)
+{
+    uint64_t i, h0, h1;
+    h0 = h1 = n;
+    for (i = 0; i < n; ++i) {
+        h0 = ra_mix64(h0 ^ a[i]);
+        h1 = ra_mix64(h1 ^ (a[n-i-1]^1));
+    }
+    return MIN(h0, h1);
+}
+
+// 0 for identical lists, 1 for reverse lists, -1 otherwise
+static int utg_list_cmp(uint64_t *a, uint64_t *b, uint64_t n)
+{
+    uint64_t i;
+    for (i = 0; i < n && a[i] == b[i]; ++i) {}
+    if (i == n) return 0;
+    for (i = 0; i < n && a[i] == (b[n-i-1]^1); ++i) {}
+    if (i == n) return 1;
+    return -1;
+}
+
+// map old vertex v to new vertex with o2n
+#define ra_ref_vmap(o2n, v) ((o2n)[(v)>>1]>>1<<1 | (((v)^(o2n)[(v)>>1])&1))
+
+static int ra_ref_arc_match(ra_ref_t *ref, asmg_t *ug, uint64_t *o2n, uint64_t *n2o, uint64_t v)
+{
+    uint64_t i, n, n0, n1, w, v1;
+    asmg_arc_t *a;
+
+    v1 = ra_ref_vmap(o2n, v);
+    n0 = 0;
+    for (i = ref->a_idx[v]; i < ref->a_idx[v+1]; ++i) {
+        w = (uint64_t) (ref->a[i] >> 64);
+        if (o2n[w>>1] == UINT64_MAX)
+            continue;
+        a = asmg_arc1(ug, v1, ra_ref_vmap(o2n, w));
+        if (!a || a->ln != (uint64_t) ref->a[i])
+            return 0;
+        ++n0;
+    }
+    n1 = 0;
+    a = asmg_arc_a(ug, v1);
+    for (i = 0, n = asmg_arc_n(ug, v1); i < n; ++i) {
+        if (a[i].del || n2o[a[i].w>>1] == UINT64_MAX)
+            continue;
+        if (asmg_arc1(ug, v1, a[i].w) == &a[i])
+            ++n1;
+    }
+    return n0 == n1;
+}
+
+// match unitigs of the snapshot to the current graph
+// two unitigs match if they have the same syncmer list in either orientation
+// and the same arcs to other matched unitigs
+// o2n[u] = u1 << 1 | flip for matched old unitig u, n2o[u1] = u; UINT64_MAX if unmatched
+static uint64_t ra_ref_match(ra_ref_t *ref, scg_t *g, uint64_t *o2n, uint64_t *n2o)
+{
+    uint64_t i, n, u, l, n_m;
+    int absent, f;
+    khint_t k;
+    kh_u64_t *h;
+    asmg_t *ug;
+    asmg_vtx_t *utg;
+
+    ug = g->utg_asmg;
+    utg = ug->vtx;
+    for (i = 0; i < ref->n_utg; ++i) o2n[i] = UINT64_MAX;
+    for (i = 0, n = ug->n_vtx; i < n; ++i) n2o[i] = UINT64_MAX;
+
+    h = kh_u64_init();
+    for (i = 0, n = ug->n_vtx; i < n; ++i) {
+        if (utg[i].del || utg[i].n == 0)
+            continue;
+        k = kh_u64_put(h, utg_list_hash(utg[i].a, utg[i].n), &absent);
+        // ambiguous lists are left unmatched
+        kh_val(h, k) = absent? i : UINT64_MAX;
+    }
+
+    for (i = 0; i < ref->n_utg; ++i) {
+        l = ref->s_idx[i+1] - ref->s_idx[i];
+        if (l == 0)
+            continue;
+        k = kh_u64_get(h, utg_list_hash(ref->s + ref->s_idx[i], l));
+        if (k == kh_end(h) || kh_val(h, k) == UINT64_MAX)
+            continue;
+        u = kh_val(h, k);
+        if (utg[u].n != l || n2o[u] != UINT64_MAX)
+            continue;
+        f = utg_list_cmp(ref->s + ref->s_idx[i], utg[u].a, l);
+        if (f < 0)
+            continue;
+        o2n[i] = u<<1 | f;
+        n2o[u] = i;
+    }
+    kh_u64_destroy(h);
+
+    n_m = 0;
+    for (i = 0; i < ref->n_utg; ++i) {
+        if (o2n[i] == UINT64_MAX)
+            continue;
+        if (!ra_ref_arc_match(ref, ug, o2n, n2o, i<<1) ||
+                !ra_ref_arc_match(ref, ug, o2n, n2o, i<<1|1)) {
+            n2o[o2n[i]>>1] = UINT64_MAX;
+            o2n[i] = UINT64_MAX;
+            continue;
+        }
+        ++n_m;
+    }
+
+    return n_m;
+}
+
 typedef struct { size_t n, m; uint32_t *a; } u32_v;
 typedef struct { size_t n, m; u32_v *a; } v32_v;
 
@@ -78,17 +276,37 @@ typedef struct {
     u32_v prev;
 } sr_frg_t;
 
+typedef kvec_t(sr_scm_t) sr_scm_v;
+typedef kvec_t(sr_frg_t) sr_frg_v;
+
+// per-thread working space kept across kt_for() chunks
 typedef struct {
-    int tid;
-    sr_t *sr;
-    scg_ra_v *ra_v;
+    sr_scm_v scm_v; // scm position triple (utg_id, utg_pos, sr_pos)
+    sr_scm_v buf_v; // radix sort buffer
+    sr_frg_v frg_v;
+    u32_v utg_v, pos_v;
+    v32_v aln_v;
+    void *km;
+    uint64_t m_stats[3]; // mapped reads, uniquely mapped reads, carried over reads
+} ra_cached_t;
+
+typedef struct {
+    sr_db_t *sr_db;
     scg_t *g;
     int64_t *old_ra;
-    uint64_t n;
-    uint64_t m_stats[4];
-} p_data_t;
+    scg_ra_v *old_v; // previous alignments
+    uint64_t *old_i; // 1-based index in old_v of the first alignment of a carried over read
+    uint64_t *o2n; // unitig id map from the previous graph
+    ra_cached_t *cache;
+    scg_ra_v *ra_v; // alignments of each chunk
+} ra_shared_t;
+
+// reads per kt_for() job
+// small enough to balance organelle and nuclear reads across threads
+#define RA_CHUNK_SIZE 64
 
-pthread_mutex_t lock;
+// reset the scratch arena when an outlier read blew it up
+#define RA_KM_MAX_CAP (1ULL<<28)
 
 static int sr_scm_cmpfunc(const void *a, const void *b)
 {
@@ -106,6 +324,57 @@ static int sr_scm_cmpfunc(const void *a, const void *b)
     return (x > y) - (x < y);
 }
 
+// sort scm triples by uid - s_pos - u_pos
+// triples are generated in s_pos order, so a stable LSD radix sort on uid
+// leaves them sorted by uid - s_pos; only the u_pos of the multiple hits of
+// a syncmer on the same unitig may be out of order, and each such group is
+// sorted on its own, which keeps repeat-rich unitigs out of quadratic time
+static void sr_scm_sort(void *km, sr_scm_v *scm_v, sr_scm_v *buf_v)
+{
+    size_t i, j, n, s, t, c[256];
+    uint64_t max_uid, shift;
+    sr_scm_t *a, *b, *p;
+
+    n = scm_v->n;
+    if (n < 2) return;
+
+    kv_resize_km(sr_scm_t, km, *buf_v, n);
+    a = scm_v->a;
+    b = buf_v->a;
+    max_uid = 0;
+    for (i = 0; i < n; ++i)
+        if (a[i].uid > max_uid)
+            max_uid = a[i].uid;
+    for (shift = 0; shift < 64 && max_uid >> shift; shift += 8) {
+        memset(c, 0, sizeof(c));
+        for (i = 0; i < n; ++i)
+            ++c[a[i].uid >> shift & 0xFF];
+        for (i = s = 0; i < 256; ++i) {
+            t = c[i];
+            c[i] = s;
+            s += t;
+        }
+        for (i = 0; i < n; ++i)
+            b[c[a[i].uid >> shift & 0xFF]++] = a[i];
+        p = a, a = b, b = p;
+    }
+
+    if (a != scm_v->a) {
+        // sorted triples are in the buffer
+        buf_v->a = scm_v->a;
+        scm_v->a = a;
+        t = buf_v->m, buf_v->m = scm_v->m, scm_v->m = t;
+    }
+
+    for (i = 0; i < n; i = j) {
+        s = 0; // set if the group is not sorted by u_pos
+        for (j = i + 1; j < n && a[j].uid == a[i].uid && a[j].s_pos == a[i].s_pos; ++j)
+            if (a[j-1].u_pos > a[j].u_pos)
+                s = 1;
+        if (s) qsort(&a[i], j - i, sizeof(sr_scm_t), sr_scm_cmpfunc);
+    }
+}
+
 static int sr_frg_cmpfunc(const void *a, const void *b)
 {
     uint64_t x, y;
@@ -129,28 +398,28 @@ static inline void rev_array(uint32_t *arr, int n)
     }
 }
 
-static void aln_frg_backtrace(uint32_t node, uint32_t len, sr_frg_t *frg_v, u32_v *utg_v, v32_v *aln_v)
+static void aln_frg_backtrace(void *km, uint32_t node, uint32_t len, sr_frg_t *frg_v, u32_v *utg_v, v32_v *aln_v)
 {
     if (node == UINT32_MAX)
         return;
 
-    kv_push(uint32_t, *utg_v, node);
+    kv_push_km(uint32_t, km, *utg_v, node);
     ++len;
 
     if (frg_v[node].prev.n == 0) {
         // no prev node
         // add aln path to aln_v
         u32_v *v;
-        kv_pushp(u32_v, *aln_v, &v);
+        kv_pushp_km(u32_v, km, *aln_v, &v);
         v->n = v->m = len;
-        MYMALLOC(v->a, len);
+        KMALLOC(km, v->a, len);
         memcpy(v->a, utg_v->a, sizeof(uint32_t) * len);
         rev_array(v->a, v->n);
     } else {
         // add paths for prev nodes
         size_t i, n;
         for (i = 0, n = frg_v[node].prev.n; i < n; ++i) {
-            aln_frg_backtrace(frg_v[node].prev.a[i], len, frg_v, utg_v, aln_v);
+            aln_frg_backtrace(km, frg_v[node].prev.a[i], len, frg_v, utg_v, aln_v);
             utg_v->n = len;
         }
     }
@@ -177,13 +446,10 @@ static void set_fragment(sr_frg_t *frg, uint64_t u,
     kv_init(frg->prev);
 }
 
-static void *scg_ra_analysis_thread(void *args)
+static void scg_ra_analysis_thread(void *_data, long c, int tid) // kt_for() callback
 {
-    p_data_t *dat = (p_data_t *) args;
-
-    if (dat->n == 0)
-        return NULL;
-
+    ra_shared_t *shared = (ra_shared_t *) _data;
+    ra_cached_t *cache = &shared->cache[tid];
     sr_t *sr;
     scg_ra_v *ra_v;
     scg_ra_t *ra;
@@ -192,36 +458,57 @@ static void *scg_ra_analysis_thread(void *args)
     asmg_arc_t *arc;
     uint64_t i, j, k, m, n, s, t, u, p, p1, u_beg, u_end, s_beg, s_end, s_cnt;
     int64_t score, score1, max_score, u_gap, u_clip, u_ovl, s_gap, *old_ra;
-    uint32_t n_m, n_u, n_a;
+    uint32_t n_m, n_u, n_a, n_r;
     uint128_t x;
     sr_scm_t *scm;
     sr_frg_t *frg, *frg1;
-    kvec_t(sr_scm_t) scm_v; // scm position triple (utg_id, utg_pos, sr_pos)
-    kvec_t(sr_frg_t) frg_v;
+    sr_scm_v scm_v, buf_v;
+    sr_frg_v frg_v;
     u32_v utg_v, pos_v, *v;
     v32_v aln_v;
+    void *km;
 
-    g = dat->g;
-    ra_v = dat->ra_v;
-    old_ra = dat->old_ra;
+    g = shared->g;
+    ra_v = &shared->ra_v[c];
+    old_ra = shared->old_ra;
     utg = g->utg_asmg->vtx;
 
-    kv_init(scm_v);
-    kv_init(frg_v);
-    kv_init(utg_v);
-    kv_init(pos_v);
-    kv_init(aln_v);
-    n_m = n_u = 0;
+    scm_v = cache->scm_v;
+    buf_v = cache->buf_v;
+    frg_v = cache->frg_v;
+    utg_v = cache->utg_v;
+    pos_v = cache->pos_v;
+    aln_v = cache->aln_v;
+    km = cache->km;
+    n_m = n_u = n_r = 0;
 
 #ifdef DEBUG_READ_ALIGNMENT
     uint64_t dbg_nr = 35; //16694; //31974; //7490; //23; //303579; //866; //910584;
 #endif
 
-    for (i = 0, n = dat->n; i < n; ++i) {
+    i = (uint64_t) c * RA_CHUNK_SIZE;
+    n = MIN(i + RA_CHUNK_SIZE, shared->sr_db->n);
+    for (; i < n; ++i) {
+        if (shared->old_i && shared->old_i[i]) {
+            // graph unchanged around the read, move the old alignments over
+            for (j = shared->old_i[i] - 1, n_a = 0; j < shared->old_v->n && shared->old_v->a[j].sid == i; ++j, ++n_a) {
+                ra = &shared->old_v->a[j];
+                for (k = 0; k < ra->n; ++k)
+                    ra->a[k].uid = ra_ref_vmap(shared->o2n, ra->a[k].uid);
+                kv_push(scg_ra_t, *ra_v, *ra);
+                ra->a = 0;
+                ra->n = 0;
+            }
+            if (n_a > 0)  ++n_m;
+            if (n_a == 1) ++n_u;
+            ++n_r;
+            continue;
+        }
+
         if ((old_ra[i]&1) == 0)
             continue;
 
-        sr = &dat->sr[i];
+        sr = &shared->sr_db->a[i];
 
         if (sr->n == 0)
             continue;
@@ -238,7 +525,7 @@ static void *scg_ra_analysis_thread(void *args)
                 p = scm_utg_pos(x);
                 t = scm_utg_rev(x)^(sr->m_pos[j]&1);
                 // push scm
-                kv_pushp(sr_scm_t, scm_v, &scm);
+                kv_pushp_km(sr_scm_t, km, scm_v, &scm);
                 scm->uid = u<<1 | t;
                 scm->u_pos = t? utg[u].n - p - 1 : p;
                 scm->s_pos = j;
@@ -250,7 +537,7 @@ static void *scg_ra_analysis_thread(void *args)
             continue;
 
         // sort scm triple by uid - s_pos - u_pos
-        qsort(scm_v.a, scm_v.n, sizeof(sr_scm_t), sr_scm_cmpfunc);
+        sr_scm_sort(km, &scm_v, &buf_v);
         
         // collect all alignment fragments
         frg_v.n = 0; // reset frg vector
@@ -263,15 +550,15 @@ static void *scg_ra_analysis_thread(void *args)
 
             // build position index
             pos_v.n = 0;
-            kv_push(uint32_t, pos_v, j);
+            kv_push_km(uint32_t, km, pos_v, j);
             p1 = scm_v.a[j].s_pos;
             for (k = j + 1; k < p; ++k) {
                 if (scm_v.a[k].s_pos != p1) {
-                    kv_push(uint32_t, pos_v, k);
+                    kv_push_km(uint32_t, km, pos_v, k);
                     p1 = scm_v.a[k].s_pos;
                 }
             }
-            kv_push(uint32_t, pos_v, p);
+            kv_push_km(uint32_t, km, pos_v, p);
 
             // for each scm find next mapping positions
             for (k = 0; k < pos_v.n - 2; ++k) {
@@ -320,7 +607,7 @@ static void *scg_ra_analysis_thread(void *args)
 
                 if (score >= 0) {
                     // push fragment
-                    kv_pushp(sr_frg_t, frg_v, &frg);
+                    kv_pushp_km(sr_frg_t, km, frg_v, &frg);
                     set_fragment(frg, u, s_beg, s_end, s_cnt, u_beg, u_end, u_gap, score);
                 }
             }
@@ -329,7 +616,7 @@ static void *scg_ra_analysis_thread(void *args)
             for (k = j; k < p; ++k) {
                 if (scm_v.a[k].next == 0xFFFFFFFFFFFFFFFEULL) {
                     scm = &scm_v.a[k];
-                    kv_pushp(sr_frg_t, frg_v, &frg);
+                    kv_pushp_km(sr_frg_t, km, frg_v, &frg);
                     set_fragment(frg, u, scm->s_pos, scm->s_pos, 1, scm->u_pos, scm->u_pos, 0, 1);
                     continue;
                 }
@@ -401,15 +688,15 @@ static void *scg_ra_analysis_thread(void *args)
         **/
 
 #ifdef DEBUG_READ_ALIGNMENT
-        pthread_mutex_lock(&lock);
+        pthread_mutex_lock(&dbg_lock);
         if (sr->sid == dbg_nr) {
-            fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] NO_READ: %lu\n", __func__, dat->tid, sr->sid);
+            fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] NO_READ: %u\n", __func__, tid, sr->sid);
             for (j = 0, m = sr->n; j < m; ++j)
-                fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] M_POS: %lu %u s%lu%c\n", __func__, dat->tid, 
+                fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] M_POS: %lu %u s%u%c\n", __func__, tid, 
                         j, sr->m_pos[j]>>1, sr->k_mer[j]>>1, "+-"[sr->m_pos[j]&1]);
             for (j = 0, m = scm_v.n; j < m; ++j)
                 fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] U_POS [%lu]: %lu%c %lu %lu [%lu]\n", 
-                        __func__, dat->tid, j,
+                        __func__, tid, j,
                         scm_v.a[j].uid>>1, "+-"[scm_v.a[j].uid&1], scm_v.a[j].u_pos, scm_v.a[j].s_pos,
                         scm_v.a[j].next >> 1);
         }
@@ -417,12 +704,12 @@ static void *scg_ra_analysis_thread(void *args)
         if (sr->sid == dbg_nr) {
             for (j = 0, m = frg_v.n; j < m; ++j)
                 fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] FRG_V: %lu%c [%lu] %lu %lu [%lu] %lu %lu [%lu] (%ld)\n",
-                        __func__, dat->tid, frg_v.a[j].uid>>1, "+-"[frg_v.a[j].uid&1], utg[frg_v.a[j].uid>>1].n,
+                        __func__, tid, frg_v.a[j].uid>>1, "+-"[frg_v.a[j].uid&1], utg[frg_v.a[j].uid>>1].n,
                         frg_v.a[j].u_beg, frg_v.a[j].u_end, frg_v.a[j].u_gap,
                         frg_v.a[j].s_beg, frg_v.a[j].s_end, frg_v.a[j].s_cnt,
                         frg_v.a[j].score);
         }
-        pthread_mutex_unlock(&lock);
+        pthread_mutex_unlock(&dbg_lock);
 #endif
 
         if (frg_v.n == 0) continue;
@@ -468,19 +755,19 @@ static void *scg_ra_analysis_thread(void *args)
                     frg1->score = score1;
                     frg1->prev.n = 0;
                 }
-                kv_push(uint32_t, frg1->prev, j);
+                kv_push_km(uint32_t, km, frg1->prev, j);
 #ifdef DEBUG_READ_ALIGNMENT
-                pthread_mutex_lock(&lock);
+                pthread_mutex_lock(&dbg_lock);
                 if (sr->sid == dbg_nr) {
                     uint32_t j1;
                     for (j1 = 0; j1 < m; ++j1)
                         fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] FRG_V [%lu %lu]: %lu%c [%lu] %lu %lu [%lu] %lu %lu [%lu] (%ld) <%lu:%u>\n",
-                                __func__, dat->tid, j, k, frg_v.a[j1].uid>>1, "+-"[frg_v.a[j1].uid&1], utg[frg_v.a[j1].uid>>1].n,
+                                __func__, tid, j, k, frg_v.a[j1].uid>>1, "+-"[frg_v.a[j1].uid&1], utg[frg_v.a[j1].uid>>1].n,
                                 frg_v.a[j1].u_beg, frg_v.a[j1].u_end, frg_v.a[j1].u_gap,
                                 frg_v.a[j1].s_beg, frg_v.a[j1].s_end, frg_v.a[j1].s_cnt,
                                 frg_v.a[j1].score, frg_v.a[j1].prev.n, frg_v.a[j1].prev.n > 0? frg_v.a[j1].prev.a[0] : 0);
                 }
-                pthread_mutex_unlock(&lock);
+                pthread_mutex_unlock(&dbg_lock);
 #endif
             }
         }
@@ -493,16 +780,16 @@ static void *scg_ra_analysis_thread(void *args)
         }
 
 #ifdef DEBUG_READ_ALIGNMENT
-        pthread_mutex_lock(&lock);
+        pthread_mutex_lock(&dbg_lock);
         if (sr->sid == dbg_nr) {
             for (j = 0; j < m; ++j)
                 fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] FRG_V: %lu%c [%lu] %lu %lu [%lu] %lu %lu [%lu] (%ld) <%lu:%u>\n",
-                        __func__, dat->tid, frg_v.a[j].uid>>1, "+-"[frg_v.a[j].uid&1], utg[frg_v.a[j].uid>>1].n,
+                        __func__, tid, frg_v.a[j].uid>>1, "+-"[frg_v.a[j].uid&1], utg[frg_v.a[j].uid>>1].n,
                         frg_v.a[j].u_beg, frg_v.a[j].u_end, frg_v.a[j].u_gap,
                         frg_v.a[j].s_beg, frg_v.a[j].s_end, frg_v.a[j].s_cnt,
                         frg_v.a[j].score, frg_v.a[j].prev.n, frg_v.a[j].prev.n > 0? frg_v.a[j].prev.a[0] : 0);
         }
-        pthread_mutex_unlock(&lock);
+        pthread_mutex_unlock(&dbg_lock);
 #endif
 
         // backtrace to get the alignment
@@ -515,20 +802,20 @@ static void *scg_ra_analysis_thread(void *args)
                 if (frg->score < max_score)
                     continue;
                 utg_v.n = 0;
-                aln_frg_backtrace(j, 0, frg_v.a, &utg_v, &aln_v);
+                aln_frg_backtrace(km, j, 0, frg_v.a, &utg_v, &aln_v);
             }
         }
 
 #ifdef DEBUG_READ_ALIGNMENT
-        pthread_mutex_lock(&lock);
+        pthread_mutex_lock(&dbg_lock);
         if (sr->sid == dbg_nr) {
-            fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] NO_ALN: %lu\n", __func__, dat->tid, aln_v.n);
+            fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] NO_ALN: %lu\n", __func__, tid, aln_v.n);
             for (j = 0; j < aln_v.n; ++j) {
                 v = &aln_v.a[j];
                 for (k = 0; k < v->n; ++k) {
                     t = v->a[k];
                     fprintf(stderr, "[DEBUG_READ_ALIGNMENT::%s_%d] FRG_V %lu/%lu: %lu%c [%lu] %lu %lu [%lu] %lu %lu [%lu] (%ld)\n",
-                            __func__, dat->tid, k, v->n,
+                            __func__, tid, k, v->n,
                             frg_v.a[t].uid>>1, "+-"[frg_v.a[t].uid&1], utg[frg_v.a[t].uid>>1].n,
                             frg_v.a[t].u_beg, frg_v.a[t].u_end, frg_v.a[t].u_gap,
                             frg_v.a[t].s_beg, frg_v.a[t].s_end, frg_v.a[t].s_cnt,
@@ -536,7 +823,7 @@ static void *scg_ra_analysis_thread(void *args)
                 }
             }
         }
-        pthread_mutex_unlock(&lock);
+        pthread_mutex_unlock(&dbg_lock);
 #endif
 
         // collect alignments
@@ -575,43 +862,65 @@ static void *scg_ra_analysis_thread(void *args)
         if (n_a == 1) ++n_u;
 
         for (j = 0; j < aln_v.n; ++j)
-            kv_destroy(aln_v.a[j]);
+            kv_destroy_km(km, aln_v.a[j]);
 
         for (j = 0; j < m; ++j)
-            kv_destroy(frg_v.a[j].prev);
+            kv_destroy_km(km, frg_v.a[j].prev);
+
+        if ((scm_v.m + buf_v.m) * sizeof(sr_scm_t) + frg_v.m * sizeof(sr_frg_t) > RA_KM_MAX_CAP) {
+            // drop scratch vectors and the arena after an outlier read
+            kv_destroy_km(km, scm_v);
+            kv_destroy_km(km, buf_v);
+            kv_destroy_km(km, frg_v);
+            kv_destroy_km(km, utg_v);
+            kv_destroy_km(km, pos_v);
+            kv_destroy_km(km, aln_v);
+            kv_init(scm_v);
+            kv_init(buf_v);
+            kv_init(frg_v);
+            kv_init(utg_v);
+            kv_init(pos_v);
+            kv_init(aln_v);
+            km = km_trim(km, RA_KM_MAX_CAP);
+        }
     }
 
-    dat->m_stats[0] = n_m;
-    dat->m_stats[1] = n_u;
-
-    kv_destroy(scm_v);
-    kv_destroy(frg_v);
-    kv_destroy(utg_v);
-    kv_destroy(pos_v);
-    kv_destroy(aln_v);
-
-    return NULL;
+    cache->m_stats[0] += n_m;
+    cache->m_stats[1] += n_u;
+    cache->m_stats[2] += n_r;
+
+    cache->scm_v = scm_v;
+    cache->buf_v = buf_v;
+    cache->frg_v = frg_v;
+    cache->utg_v = utg_v;
+    cache->pos_v = pos_v;
+    cache->aln_v = aln_v;
+    cache->km = km;
 }
 
-void scg_read_alignment(sr_db_t *sr_db, scg_ra_v *ra_v, scg_t *g, int n_threads, int for_unzip)
+void scg_read_alignment(sr_db_t *sr_db, scg_ra_v *ra_v, scg_t *g, const kt_ctx_t *kc, int for_unzip)
 {
     if (sr_db->n == 0 || !asmg_vtx_n1(g->utg_asmg)) return;
 
     int i;
     uint64_t j, b;
 
-    if (n_threads == 0)
-        n_threads = 1;
-
-    if (pthread_mutex_init(&lock, NULL) != 0) {
-        fprintf(stderr, "[E::%s] mutex init failed\n", __func__);
-        return;
-    }
+    int n_threads = kc? kc->n_threads : 1;
 
+    int full, incr;
     int64_t *old_ra;
+    uint64_t *old_i, *o2n;
     scg_ra_t *ra;
+    ra_ref_t *ref;
+
+    // all reads are mapped unless unzipping on top of previous alignments
+    full = !(for_unzip && ra_v->n > 0);
+    // previous alignments are reused if they cover all reads to map
+    ref = (ra_ref_t *) ra_v->ref;
+    incr = ref != 0 && (full? ra_v->all : 1);
+
     MYCALLOC(old_ra, sr_db->n);
-    if (for_unzip && ra_v->n > 0) {
+    if (!full) {
         // for unzipping purpose
         // only map reads previously mapped to at least three unitigs
         // only map previouly mapped reads
@@ -633,61 +942,136 @@ void scg_read_alignment(sr_db_t *sr_db, scg_ra_v *ra_v, scg_t *g, int n_threads,
         for (j = 0; j < sr_db->n; ++j) old_ra[j] = 1;
     }
 
-    b = sr_db->n / n_threads + 1;
-    p_data_t *dat;
-    MYCALLOC(dat, n_threads);
-    for (i = 0; i < n_threads; ++i) {
-        dat[i].tid = i;
-        dat[i].sr = sr_db->a + i * b;
-        dat[i].old_ra = old_ra + i * b;
-        MYCALLOC(dat[i].ra_v, 1);
-        dat[i].g = g;
-        if (sr_db->n >= (i + 1) * b) {
-            dat[i].n = b;
-        } else {
-            dat[i].n = sr_db->n - i * b;
-            break;
+    old_i = o2n = 0;
+    uint64_t n_o = 0;
+    if (incr) {
+        // carry over alignments of reads of which all syncmers are in unitigs unchanged since the last round
+        // the alignment of a read only depends on the unitigs containing its syncmers and the arcs between them
+        uint64_t u, l, *n2o, n_scm, n_utg;
+        uint8_t *aff;
+        sr_t *sr;
+        scg_utg_t *utg;
+
+        n_scm = scg_n_scm(g);
+        n_utg = scg_n_vtx(g);
+        utg = scg_a_vtx(g);
+        MYMALLOC(o2n, ref->n_utg);
+        MYMALLOC(n2o, n_utg);
+        n_o = ra_ref_match(ref, g, o2n, n2o);
+
+        // syncmers in unitigs added or removed
+        MYCALLOC(aff, n_scm);
+        for (u = 0; u < ref->n_utg; ++u) {
+            if (o2n[u] != UINT64_MAX)
+                continue;
+            for (l = ref->s_idx[u]; l < ref->s_idx[u+1]; ++l)
+                aff[ref->s[l]>>1] = 1;
+        }
+        for (u = 0; u < n_utg; ++u) {
+            if (n2o[u] != UINT64_MAX || utg[u].del)
+                continue;
+            for (l = 0; l < utg[u].n; ++l)
+                aff[utg[u].a[l]>>1] = 1;
         }
+        free(n2o);
+
+        MYCALLOC(old_i, sr_db->n);
+        for (j = ra_v->n; j > 0; --j)
+            old_i[ra_v->a[j-1].sid] = j;
+        for (j = 0; j < sr_db->n; ++j) {
+            if ((old_ra[j]&1) == 0) {
+                old_i[j] = 0;
+                continue;
+            }
+            sr = &sr_db->a[j];
+            for (l = 0; l < sr->n; ++l)
+                if (aff[sr->k_mer[l]>>1])
+                    break;
+            if (l < sr->n) {
+                // remap
+                old_i[j] = 0;
+            } else {
+                // carry over; nothing to do for unmapped reads
+                old_ra[j] = 0;
+            }
+        }
+        free(aff);
     }
 
-    pthread_t threads[n_threads];
-    for (i = 1; i < n_threads; ++i)
-        pthread_create(threads + i, NULL, scg_ra_analysis_thread, dat + i);
-
-    scg_ra_analysis_thread(dat);
-
-    for (i = 1; i < n_threads; ++i)
-        pthread_join(threads[i], NULL);
+    ra_shared_t shared;
+    ra_cached_t *cached;
+    uint64_t n_c;
+    n_c = (sr_db->n + RA_CHUNK_SIZE - 1) / RA_CHUNK_SIZE;
+    MYCALLOC(cached, n_threads);
+    for (i = 0; i < n_threads; ++i)
+        cached[i].km = km_init();
+    shared.sr_db = sr_db;
+    shared.g = g;
+    shared.old_ra = old_ra;
+    shared.old_v = ra_v;
+    shared.old_i = old_i;
+    shared.o2n = o2n;
+    shared.cache = cached;
+    MYCALLOC(shared.ra_v, n_c);
+
+    // dynamic scheduling with work stealing over small read chunks
+    double realtime1 = realtime();
+    kt_ctx_for(kc, scg_ra_analysis_thread, &shared, n_c);
+    realtime1 = realtime() - realtime1;
 
     // clean old results in ra_v
     scg_ra_v_clean(ra_v);
-    // collect results
+    // collect results in read id order
     ra_v->m = 0;
-    for (i = 0; i < n_threads; ++i)
-        ra_v->m += dat[i].ra_v->n;
+    for (b = 0; b < n_c; ++b)
+        ra_v->m += shared.ra_v[b].n;
     ra_v->n = 0;
     MYMALLOC(ra_v->a, ra_v->m);
-    for (i = 0; i < n_threads; ++i) {
+    for (b = 0; b < n_c; ++b) {
         // copy data
-        memcpy(ra_v->a + ra_v->n, dat[i].ra_v->a, sizeof(scg_ra_t) * dat[i].ra_v->n);
-        ra_v->n += dat[i].ra_v->n;
-        free(dat[i].ra_v->a);
-        free(dat[i].ra_v);
+        if (shared.ra_v[b].n == 0) continue;
+        memcpy(ra_v->a + ra_v->n, shared.ra_v[b].a, sizeof(scg_ra_t) * shared.ra_v[b].n);
+        ra_v->n += shared.ra_v[b].n;
+        free(shared.ra_v[b].a);
     }
+    free(shared.ra_v);
 
-    uint64_t n_r, n_m, n_u, n;
-    n_r = n_m = n_u = 0;
-    for (n = 0; n < sr_db->n; ++n)
+    uint64_t n_r, n_m, n_u, n_c1, n_a, n;
+    n_r = n_m = n_u = n_c1 = n_a = 0;
+    for (n = 0; n < sr_db->n; ++n) {
         n_r += sr_db->a[n].n > 0;
+        n_a += sr_db->a[n].n > 0 && (old_ra[n]&1);
+    }
     for (i = 0; i < n_threads; ++i) {
-        n_m += dat[i].m_stats[0];
-        n_u += dat[i].m_stats[1];
+        n_m += cached[i].m_stats[0];
+        n_u += cached[i].m_stats[1];
+        n_c1 += cached[i].m_stats[2];
     }
     fprintf(stderr ,"[M::%s] %lu mappable reads, %lu mapped (%lu unique mapping)\n", __func__, n_r, n_m, n_u);
+    if (incr)
+        fprintf(stderr ,"[M::%s] %lu of %lu unitigs unchanged, %lu reads carried over, %lu reads realigned\n",
+                __func__, n_o, ref->n_utg, n_c1, n_a);
+    fprintf(stderr, "[M::%s] %lu reads aligned in %.3f sec (%.1f reads/sec/thread)\n", __func__,
+            n_a, realtime1, realtime1 > 0? n_a / realtime1 / n_threads : 0.);
 
-    pthread_mutex_destroy(&lock);
+    // keep a snapshot of the graph for the next round
+    ra_ref_destroy(ref);
+    ra_v->ref = ra_ref_snapshot(g);
+    ra_v->all = full;
+
+    for (i = 0; i < n_threads; ++i) {
+        kv_destroy_km(cached[i].km, cached[i].scm_v);
+        kv_destroy_km(cached[i].km, cached[i].buf_v);
+        kv_destroy_km(cached[i].km, cached[i].frg_v);
+        kv_destroy_km(cached[i].km, cached[i].utg_v);
+        kv_destroy_km(cached[i].km, cached[i].pos_v);
+        kv_destroy_km(cached[i].km, cached[i].aln_v);
+        km_destroy(cached[i].km);
+    }
+    free(cached);
     free(old_ra);
-    free(dat);
+    free(old_i);
+    free(o2n);
 }
 
 void scg_ra_print(scg_ra_t *ra, FILE *fo)
@@ -0,0 +1,967 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2023 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "misc.h"
+#include "checkpoint.h"
+
+#define CKPT_MAX_STAGE 99
+
+typedef struct {
+    uint64_t o; // address of referenced data or offset into the copy buffer
+    uint64_t l;
+    int copy;
+} ckpt_seg_t;
+
+typedef struct {
+    char *fn;
+    ckpt_hdr_t hdr;
+    size_t n, m;
+    ckpt_seg_t *a;
+    // copies of data later stages change
+    // everything else is referenced and must stay untouched until the job is done
+    uint8_t *buf;
+    size_t l_buf, m_buf;
+    uint64_t len; // bytes in all segments
+    uint64_t part; // start of the open part
+    int ret;
+} ckpt_job_t;
+
+typedef struct {
+    const uint8_t *p, *end;
+    int err;
+} ckpt_cur_t;
+
+static uint64_t fnv1a64(uint64_t h, const void *p, size_t l)
+{
+    size_t i;
+    const uint8_t *s = (const uint8_t *) p;
+    for (i = 0; i < l; ++i) {
+        h ^= s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t ckpt_abi(void)
+{
+    uint64_t sz[] = {sizeof(sr_stat_t), sizeof(syncmer_t), sizeof(asmg_vtx_t), sizeof(asmg_arc_t),
+        sizeof(scg_ra_t), sizeof(ra_frg_t), sizeof(uint128_t)};
+    return fnv1a64(0xcbf29ce484222325ULL, sz, sizeof(sz));
+}
+
+static int ckpt_stage_parts(int stage)
+{
+    switch (stage) {
+        case CKPT_READ:  return CKPT_P_SEQ | CKPT_P_MER;
+        case CKPT_SCM:   return CKPT_P_MER | CKPT_P_SCM;
+        case CKPT_EC:    return CKPT_P_MER | CKPT_P_SCM;
+        case CKPT_CLEAN: return CKPT_P_SCM | CKPT_P_UTG;
+        default:         return CKPT_P_UTG | CKPT_P_RA;
+    }
+}
+
+static char *ckpt_file_name(ckpt_t *ck, int stage)
+{
+    char *fn;
+    MYMALLOC(fn, strlen(ck->dir) + 32);
+    sprintf(fn, "%s/stage%02d.ckpt", ck->dir, stage);
+    return fn;
+}
+
+static int ckpt_file_stage(const char *name)
+{
+    int stage, n;
+    if (sscanf(name, "stage%d.ckpt%n", &stage, &n) == 1 && name[n] == 0 && stage > 0 && stage <= CKPT_MAX_STAGE)
+        return stage;
+    return 0;
+}
+
+// remove stage files after stage 'from' and leftover temporary files
+static void ckpt_remove(ckpt_t *ck, int from)
+{
+    DIR *dir;
+    struct dirent *ent;
+    char *fn;
+    size_t l;
+    int stage;
+
+    dir = opendir(ck->dir);
+    if (!dir) return;
+    MYMALLOC(fn, strlen(ck->dir) + 256 + 2);
+    while ((ent = readdir(dir)) != 0) {
+        l = strlen(ent->d_name);
+        stage = ckpt_file_stage(ent->d_name);
+        if (stage > from || (l > 9 && strcmp(ent->d_name + l - 9, ".ckpt.tmp") == 0)) {
+            sprintf(fn, "%s/%s", ck->dir, ent->d_name);
+            unlink(fn);
+        }
+    }
+    free(fn);
+    closedir(dir);
+}
+
+static int ckpt_resume(ckpt_t *ck);
+static void ckpt_release(ckpt_t *ck);
+
+// with 'resume' the state of the last usable stage is loaded into the returned object
+// otherwise the checkpoints of earlier runs are removed
+ckpt_t *ckpt_init(const char *dir, char **file_in, int n_file, const char *param, int do_ec, int resume)
+{
+    int i;
+    uint64_t h;
+    struct stat st;
+    ckpt_t *ck;
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "[E::%s] failed to create checkpoint directory %s: %s\n", __func__, dir, strerror(errno));
+        return 0;
+    }
+
+    // the result only depends on the input files and the assembly parameters
+    h = fnv1a64(0xcbf29ce484222325ULL, param, strlen(param));
+    for (i = 0; i < n_file; ++i) {
+        h = fnv1a64(h, file_in[i], strlen(file_in[i]) + 1);
+        if (stat(file_in[i], &st) == 0 && S_ISREG(st.st_mode)) {
+            h = fnv1a64(h, &st.st_size, sizeof(st.st_size));
+            h = fnv1a64(h, &st.st_mtime, sizeof(st.st_mtime));
+        }
+    }
+
+    MYCALLOC(ck, 1);
+    MYMALLOC(ck->dir, strlen(dir) + 1);
+    strcpy(ck->dir, dir);
+    ck->phash = h;
+    ck->do_ec = do_ec;
+
+    if (resume) ckpt_resume(ck);
+    else ckpt_remove(ck, 0);
+
+    return ck;
+}
+
+void ckpt_destroy(ckpt_t *ck)
+{
+    if (!ck) return;
+    ckpt_wait(ck);
+    // resumed state not taken over
+    ckpt_release(ck);
+    free(ck->dir);
+    free(ck);
+}
+
+/*** snapshot ***/
+
+static void ckpt_ref(ckpt_job_t *j, const void *p, uint64_t l)
+{
+    if (l == 0) return;
+    if (j->n == j->m) MYEXPAND(j->a, j->m);
+    j->a[j->n].o = (uint64_t) p;
+    j->a[j->n].l = l;
+    j->a[j->n].copy = 0;
+    ++j->n;
+    j->len += l;
+}
+
+static void ckpt_copy(ckpt_job_t *j, const void *p, uint64_t l)
+{
+    if (l == 0) return;
+    if (j->l_buf + l > j->m_buf) {
+        j->m_buf = j->l_buf + l;
+        kroundup64(j->m_buf);
+        MYREALLOC(j->buf, j->m_buf);
+    }
+    memcpy(j->buf + j->l_buf, p, l);
+    // consecutive copies end up next to each other in the buffer
+    if (j->n && j->a[j->n - 1].copy) {
+        j->a[j->n - 1].l += l;
+    } else {
+        if (j->n == j->m) MYEXPAND(j->a, j->m);
+        j->a[j->n].o = j->l_buf;
+        j->a[j->n].l = l;
+        j->a[j->n].copy = 1;
+        ++j->n;
+    }
+    j->l_buf += l;
+    j->len += l;
+}
+
+#define ckpt_copy1(j, x) ckpt_copy((j), &(x), sizeof(x))
+
+// part header [uint32 part][uint64 length]
+// the length is filled in by ckpt_part_end()
+static uint64_t ckpt_part_beg(ckpt_job_t *j, uint32_t part)
+{
+    uint64_t l = 0;
+    ckpt_copy1(j, part);
+    ckpt_copy1(j, l);
+    j->part = j->len;
+    return j->l_buf - sizeof(uint64_t);
+}
+
+static void ckpt_part_end(ckpt_job_t *j, uint64_t l_field)
+{
+    uint64_t l = j->len - j->part;
+    memcpy(j->buf + l_field, &l, sizeof(uint64_t));
+}
+
+static void ckpt_put_seq(ckpt_job_t *j, sr_db_t *sr_db)
+{
+    uint64_t i, n, l_field;
+    uint32_t n_amb, n_lrl;
+    int32_t ks[2];
+    sr_t *sr;
+
+    l_field = ckpt_part_beg(j, CKPT_P_SEQ);
+    ks[0] = sr_db->k;
+    ks[1] = sr_db->s;
+    n = sr_db->n;
+    ckpt_copy1(j, ks);
+    ckpt_copy1(j, n);
+    for (i = 0; i < n; ++i) {
+        sr = &sr_db->a[i];
+        uint64_t l_name = sr->sname? strlen(sr->sname) + 1 : 0;
+        n_amb = sr->n_nucl? sr->n_nucl[0] : 0;
+        n_lrl = sr->ho_l_rl? sr->ho_l_rl[0] : 0;
+        ckpt_copy1(j, sr->sid);
+        ckpt_copy1(j, l_name);
+        ckpt_copy1(j, sr->hoco_l);
+        ckpt_copy1(j, n_amb);
+        ckpt_copy1(j, n_lrl);
+        ckpt_ref(j, sr->sname, l_name);
+        ckpt_ref(j, sr->hoco_s, (sr->hoco_l + 3) / 4);
+        ckpt_ref(j, sr->n_nucl, n_amb? (n_amb + 1) * sizeof(uint32_t) : 0);
+        ckpt_ref(j, sr->ho_rl, sr_rl_size(sr->hoco_l - n_amb));
+        ckpt_ref(j, sr->ho_l_rl, n_lrl? (n_lrl * 2 + 1) * sizeof(uint32_t) : 0);
+    }
+    ckpt_part_end(j, l_field);
+}
+
+static void ckpt_put_mer(ckpt_job_t *j, sr_db_t *sr_db)
+{
+    uint64_t i, n, l_field;
+    uint32_t has_stats, collected;
+    sr_t *sr;
+
+    l_field = ckpt_part_beg(j, CKPT_P_MER);
+    n = sr_db->n;
+    has_stats = sr_db->stats != 0;
+    collected = sr_db->collected;
+    ckpt_copy1(j, n);
+    ckpt_copy1(j, has_stats);
+    ckpt_copy1(j, collected);
+    if (has_stats) ckpt_copy(j, sr_db->stats, sizeof(sr_stat_t));
+    for (i = 0; i < n; ++i) {
+        sr = &sr_db->a[i];
+        ckpt_copy1(j, sr->n);
+        ckpt_copy(j, sr->m_pos, sizeof(uint32_t) * sr->n);
+        // smers before syncmer collection, kmer ids after
+        if (collected) ckpt_copy(j, sr->k_mer, sizeof(uint32_t) * sr->n);
+        else ckpt_copy(j, sr->s_mer, sizeof(uint64_t) * sr->n);
+    }
+    ckpt_part_end(j, l_field);
+}
+
+static void ckpt_put_scm(ckpt_job_t *j, syncmer_db_t *scm_db)
+{
+    uint64_t i, n, l_field;
+    uint32_t has_c, has_h;
+
+    l_field = ckpt_part_beg(j, CKPT_P_SCM);
+    n = scm_db->n;
+    has_c = scm_db->c != 0;
+    has_h = scm_db->h != 0;
+    ckpt_copy1(j, n);
+    ckpt_copy1(j, has_c);
+    ckpt_copy1(j, has_h);
+    for (i = 0; i < n; ++i) {
+        ckpt_copy(j, &scm_db->a[i], sizeof(syncmer_t));
+        ckpt_copy(j, scm_db->a[i].m_pos, sizeof(uint64_t) * scm_db->a[i].cov);
+    }
+    if (has_c) ckpt_copy(j, scm_db->c, sizeof(uint16_t) * n);
+    if (has_h) ckpt_copy(j, scm_db->h, sizeof(uint64_t) * n);
+    ckpt_part_end(j, l_field);
+}
+
+static void ckpt_put_utg(ckpt_job_t *j, scg_t *scg)
+{
+    uint64_t i, n_vtx, n_arc, l_seq, n_scm_u, n_idx, l_field;
+    uint32_t has_idx, has_idx_u;
+    asmg_t *g;
+    asmg_vtx_t *v;
+
+    l_field = ckpt_part_beg(j, CKPT_P_UTG);
+    g = scg->utg_asmg;
+    n_vtx = g->n_vtx;
+    n_arc = g->n_arc;
+    ckpt_copy1(j, n_vtx);
+    ckpt_copy1(j, n_arc);
+    for (i = 0; i < n_vtx; ++i) {
+        v = &g->vtx[i];
+        l_seq = v->seq? strlen(v->seq) : UINT64_MAX;
+        ckpt_copy(j, v, sizeof(asmg_vtx_t));
+        ckpt_copy(j, v->a, sizeof(uint64_t) * v->n);
+        ckpt_copy1(j, l_seq);
+        if (v->seq) ckpt_copy(j, v->seq, l_seq);
+    }
+    ckpt_copy(j, g->arc, sizeof(asmg_arc_t) * n_arc);
+    has_idx = g->idx_p != 0;
+    ckpt_copy1(j, has_idx);
+    if (has_idx) {
+        ckpt_copy(j, g->idx_p, sizeof(uint64_t) * n_vtx * 2);
+        ckpt_copy(j, g->idx_n, sizeof(uint64_t) * n_vtx * 2);
+    }
+    // syncmer to unitig index; the index pointers are saved as offsets
+    has_idx_u = scg->idx_u != 0;
+    n_idx = scg_n_scm(scg) + 1;
+    n_scm_u = has_idx_u? (uint64_t) (scg->idx_u[n_idx - 1] - scg->scm_u) : 0;
+    ckpt_copy1(j, has_idx_u);
+    ckpt_copy1(j, n_scm_u);
+    if (has_idx_u) {
+        ckpt_copy(j, scg->scm_u, sizeof(uint128_t) * n_scm_u);
+        for (i = 0; i < n_idx; ++i) {
+            uint64_t o = scg->idx_u[i] - scg->scm_u;
+            ckpt_copy1(j, o);
+        }
+    }
+    ckpt_part_end(j, l_field);
+}
+
+static void ckpt_put_ra(ckpt_job_t *j, scg_ra_v *ra_db)
+{
+    uint64_t i, n, l_field;
+    int32_t all;
+
+    l_field = ckpt_part_beg(j, CKPT_P_RA);
+    n = ra_db->n;
+    all = ra_db->all;
+    ckpt_copy1(j, n);
+    ckpt_copy1(j, all);
+    for (i = 0; i < n; ++i) {
+        ckpt_copy(j, &ra_db->a[i], sizeof(scg_ra_t));
+        ckpt_copy(j, ra_db->a[i].a, sizeof(ra_frg_t) * ra_db->a[i].n);
+    }
+    ckpt_part_end(j, l_field);
+}
+
+static int ckpt_fwrite(FILE *fo, const void *p, uint64_t l, uLong *crc)
+{
+    uint64_t l1;
+    const uint8_t *s = (const uint8_t *) p;
+    while (l > 0) {
+        l1 = l < (1ULL<<30)? l : (1ULL<<30);
+        if (fwrite(s, 1, l1, fo) != l1) return 1;
+        *crc = crc32(*crc, s, l1);
+        s += l1;
+        l -= l1;
+    }
+    return 0;
+}
+
+static void *ckpt_write_worker(void *data)
+{
+    ckpt_job_t *j = (ckpt_job_t *) data;
+    FILE *fo;
+    char *tmp;
+    uLong crc;
+    uint64_t i, len, crc64;
+    const void *p;
+    int ret;
+    double realtime0;
+
+    realtime0 = realtime();
+    MYMALLOC(tmp, strlen(j->fn) + 8);
+    sprintf(tmp, "%s.tmp", j->fn);
+    fo = fopen(tmp, "wb");
+    if (!fo) {
+        fprintf(stderr, "[W::%s] failed to open file %s to write: %s\n", __func__, tmp, strerror(errno));
+        free(tmp);
+        j->ret = 1;
+        return 0;
+    }
+
+    crc = crc32(0L, Z_NULL, 0);
+    len = sizeof(ckpt_hdr_t);
+    ret = ckpt_fwrite(fo, &j->hdr, sizeof(ckpt_hdr_t), &crc);
+    for (i = 0; i < j->n && !ret; ++i) {
+        p = j->a[i].copy? (const void *) (j->buf + j->a[i].o) : (const void *) j->a[i].o;
+        ret = ckpt_fwrite(fo, p, j->a[i].l, &crc);
+        len += j->a[i].l;
+    }
+    len += sizeof(uint64_t);
+    if (!ret) ret = ckpt_fwrite(fo, &len, sizeof(uint64_t), &crc);
+    crc64 = crc;
+    if (!ret) ret = fwrite(&crc64, sizeof(uint64_t), 1, fo) != 1;
+    if (!ret) ret = fflush(fo) != 0 || fsync(fileno(fo)) != 0;
+    ret |= fclose(fo) != 0;
+    // only complete files get the stage file name
+    if (!ret) ret = rename(tmp, j->fn) != 0;
+
+    if (ret) {
+        fprintf(stderr, "[W::%s] failed to write checkpoint %s: %s\n", __func__, j->fn, strerror(errno));
+        unlink(tmp);
+    } else {
+        fprintf(stderr, "[M::%s] checkpoint of stage %u written to %s in %.3f sec\n", __func__,
+                j->hdr.stage, j->fn, realtime() - realtime0);
+    }
+    free(tmp);
+
+    free(j->buf);
+    j->buf = 0;
+    j->ret = ret;
+
+    return 0;
+}
+
+void ckpt_wait(ckpt_t *ck)
+{
+    ckpt_job_t *j;
+    if (!ck || !ck->job) return;
+    j = (ckpt_job_t *) ck->job;
+    pthread_join(ck->tid, 0);
+    free(j->buf);
+    free(j->a);
+    free(j->fn);
+    free(j);
+    ck->job = 0;
+}
+
+// the snapshot is taken here and written to disk in the background
+// referenced data (read names and sequences) must not change until the next ckpt_save() or ckpt_wait()
+void ckpt_save(ckpt_t *ck, int stage, sr_db_t *sr_db, syncmer_db_t *scm_db, scg_t *scg, scg_ra_v *ra_db, int min_k_cov, int aux)
+{
+    if (!ck) return;
+
+    int parts;
+    ckpt_job_t *j;
+
+    ckpt_wait(ck);
+
+    parts = ckpt_stage_parts(stage);
+    MYCALLOC(j, 1);
+    j->fn = ckpt_file_name(ck, stage);
+    memcpy(j->hdr.magic, CKPT_MAGIC, 4);
+    j->hdr.version = CKPT_VERSION;
+    j->hdr.phash = ck->phash;
+    j->hdr.abi = ckpt_abi();
+    j->hdr.stage = stage;
+    j->hdr.parts = parts;
+    j->hdr.min_k_cov = min_k_cov;
+    j->hdr.aux = aux;
+
+    if (parts & CKPT_P_SEQ) ckpt_put_seq(j, sr_db);
+    if (parts & CKPT_P_MER) ckpt_put_mer(j, sr_db);
+    if (parts & CKPT_P_SCM) ckpt_put_scm(j, scm_db);
+    if (parts & CKPT_P_UTG) ckpt_put_utg(j, scg);
+    if (parts & CKPT_P_RA)  ckpt_put_ra(j, ra_db);
+
+    // a stage file of the same name from an earlier run is no longer valid
+    unlink(j->fn);
+    ck->job = j;
+    if (pthread_create(&ck->tid, 0, ckpt_write_worker, j) != 0) {
+        fprintf(stderr, "[W::%s] failed to start checkpoint writer - write in the foreground\n", __func__);
+        ckpt_write_worker(j);
+        ck->job = 0;
+        free(j->a);
+        free(j->fn);
+        free(j);
+    }
+}
+
+/*** resume ***/
+
+typedef struct {
+    uint8_t *mm;
+    uint64_t l;
+    ckpt_hdr_t hdr;
+} ckpt_file_t;
+
+static void *ckpt_get(ckpt_cur_t *c, uint64_t l)
+{
+    const uint8_t *p;
+    if (c->err || (uint64_t) (c->end - c->p) < l) {
+        c->err = 1;
+        return 0;
+    }
+    p = c->p;
+    c->p += l;
+    return (void *) p;
+}
+
+#define ckpt_get1(c, x) do { \
+    void *_p = ckpt_get((c), sizeof(x)); \
+    if (_p) memcpy(&(x), _p, sizeof(x)); \
+    else memset(&(x), 0, sizeof(x)); \
+} while (0)
+
+// a heap copy of an array of n elements of size sz
+static void *ckpt_get_array(ckpt_cur_t *c, uint64_t n, uint64_t sz)
+{
+    uint8_t *p, *q;
+    if (n == 0 || c->err) return 0;
+    if (n > UINT64_MAX / sz) {
+        c->err = 1;
+        return 0;
+    }
+    p = (uint8_t *) ckpt_get(c, n * sz);
+    if (!p) return 0;
+    MYMALLOC(q, n * sz);
+    memcpy(q, p, n * sz);
+    return q;
+}
+
+// at least one byte left for each of n records
+static int ckpt_check_n(ckpt_cur_t *c, uint64_t n)
+{
+    if (!c->err && n > (uint64_t) (c->end - c->p))
+        c->err = 1;
+    return c->err;
+}
+
+static const char *ckpt_stage_name(int stage)
+{
+    switch (stage) {
+        case CKPT_READ:  return "reads";
+        case CKPT_SCM:   return "syncmers";
+        case CKPT_EC:    return "read error correction";
+        case CKPT_CLEAN: return "graph cleanup";
+        default:         return "unzipping";
+    }
+}
+
+static void ckpt_close(ckpt_file_t *f)
+{
+    if (f->mm) munmap(f->mm, f->l);
+    f->mm = 0;
+    f->l = 0;
+}
+
+static int ckpt_open(ckpt_t *ck, int stage, ckpt_file_t *f)
+{
+    int fd;
+    char *fn;
+    struct stat st;
+    uint64_t len, crc64, i, l1;
+    uLong crc;
+
+    f->mm = 0;
+    f->l = 0;
+    fn = ckpt_file_name(ck, stage);
+    fd = open(fn, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT)
+            fprintf(stderr, "[W::%s] failed to open checkpoint %s: %s\n", __func__, fn, strerror(errno));
+        free(fn);
+        return 1;
+    }
+    if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < sizeof(ckpt_hdr_t) + 2 * sizeof(uint64_t)) {
+        fprintf(stderr, "[W::%s] truncated checkpoint %s\n", __func__, fn);
+        close(fd);
+        free(fn);
+        return 1;
+    }
+    f->l = st.st_size;
+    f->mm = (uint8_t *) mmap(0, f->l, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (f->mm == MAP_FAILED) {
+        fprintf(stderr, "[W::%s] failed to map checkpoint %s: %s\n", __func__, fn, strerror(errno));
+        f->mm = 0;
+        free(fn);
+        return 1;
+    }
+
+    memcpy(&f->hdr, f->mm, sizeof(ckpt_hdr_t));
+    if (memcmp(f->hdr.magic, CKPT_MAGIC, 4) != 0 || f->hdr.version != CKPT_VERSION || f->hdr.abi != ckpt_abi()
+            || f->hdr.stage != (uint32_t) stage) {
+        fprintf(stderr, "[W::%s] not a checkpoint of this program: %s\n", __func__, fn);
+        goto do_fail;
+    }
+    if (f->hdr.phash != ck->phash) {
+        fprintf(stderr, "[W::%s] checkpoint made with different input files or parameters: %s\n", __func__, fn);
+        goto do_fail;
+    }
+    memcpy(&len, f->mm + f->l - 2 * sizeof(uint64_t), sizeof(uint64_t));
+    memcpy(&crc64, f->mm + f->l - sizeof(uint64_t), sizeof(uint64_t));
+    crc = crc32(0L, Z_NULL, 0);
+    for (i = 0; i < f->l - sizeof(uint64_t); i += l1) {
+        l1 = f->l - sizeof(uint64_t) - i;
+        if (l1 > (1ULL<<30)) l1 = 1ULL<<30;
+        crc = crc32(crc, f->mm + i, l1);
+    }
+    if (len != f->l - sizeof(uint64_t) || crc64 != crc) {
+        fprintf(stderr, "[W::%s] checksum mismatch in checkpoint %s\n", __func__, fn);
+        goto do_fail;
+    }
+    free(fn);
+    return 0;
+
+do_fail:
+    ckpt_close(f);
+    free(fn);
+    return 1;
+}
+
+static int ckpt_find_part(ckpt_file_t *f, uint32_t part, ckpt_cur_t *c)
+{
+    uint32_t p;
+    uint64_t l;
+    ckpt_cur_t c0;
+    c0.p = f->mm + sizeof(ckpt_hdr_t);
+    c0.end = f->mm + f->l - 2 * sizeof(uint64_t);
+    c0.err = 0;
+    while (c0.p < c0.end) {
+        ckpt_get1(&c0, p);
+        ckpt_get1(&c0, l);
+        c->p = c0.p;
+        if (!ckpt_get(&c0, l)) break;
+        if (p == part) {
+            c->end = c0.p;
+            c->err = 0;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static sr_db_t *ckpt_get_seq(ckpt_cur_t *c)
+{
+    int32_t ks[2];
+    uint64_t i, n, l_name;
+    uint32_t sid, hoco_l, n_amb, n_lrl;
+    sr_db_t *sr_db;
+    sr_t *sr;
+
+    ckpt_get1(c, ks);
+    ckpt_get1(c, n);
+    if (ckpt_check_n(c, n)) return 0;
+    MYMALLOC(sr_db, 1);
+    sr_db_init(sr_db, ks[0], ks[1]);
+    MYCALLOC(sr_db->a, n);
+    sr_db->m = n;
+    for (i = 0; i < n && !c->err; ++i) {
+        sr = &sr_db->a[i];
+        sr_db->n = i + 1;
+        ckpt_get1(c, sid);
+        ckpt_get1(c, l_name);
+        ckpt_get1(c, hoco_l);
+        ckpt_get1(c, n_amb);
+        ckpt_get1(c, n_lrl);
+        if (n_amb > hoco_l) c->err = 1;
+        sr->sid = sid;
+        sr->hoco_l = hoco_l;
+        sr->sname = ckpt_get_array(c, l_name, 1);
+        if (sr->sname && sr->sname[l_name - 1] != 0) c->err = 1;
+        sr->hoco_s = ckpt_get_array(c, (hoco_l + 3) / 4, 1);
+        sr->n_nucl = ckpt_get_array(c, n_amb? n_amb + 1 : 0, sizeof(uint32_t));
+        sr->ho_rl = ckpt_get_array(c, sr_rl_size(hoco_l - n_amb), 1);
+        sr->ho_l_rl = ckpt_get_array(c, n_lrl? n_lrl * 2 + 1 : 0, sizeof(uint32_t));
+        if (sr->ho_l_rl && sr->ho_l_rl[0] != n_lrl) c->err = 1;
+    }
+    if (c->err) {
+        sr_db_destroy(sr_db);
+        return 0;
+    }
+    return sr_db;
+}
+
+static int ckpt_get_mer(ckpt_cur_t *c, sr_db_t *sr_db)
+{
+    uint64_t i, n;
+    uint32_t has_stats, collected, n1;
+    sr_t *sr;
+
+    ckpt_get1(c, n);
+    ckpt_get1(c, has_stats);
+    ckpt_get1(c, collected);
+    if (n != sr_db->n) c->err = 1;
+    sr_db->collected = collected;
+    if (has_stats) {
+        free(sr_db->stats);
+        sr_db->stats = ckpt_get_array(c, 1, sizeof(sr_stat_t));
+    }
+    for (i = 0; i < n && !c->err; ++i) {
+        sr = &sr_db->a[i];
+        free(sr->m_pos);
+        free(sr->s_mer);
+        free(sr->k_mer);
+        ckpt_get1(c, n1);
+        sr->n = n1;
+        sr->m_pos = ckpt_get_array(c, n1, sizeof(uint32_t));
+        sr->s_mer = collected? 0 : ckpt_get_array(c, n1, sizeof(uint64_t));
+        sr->k_mer = collected? ckpt_get_array(c, n1, sizeof(uint32_t)) : 0;
+    }
+    return c->err;
+}
+
+static syncmer_db_t *ckpt_get_scm(ckpt_cur_t *c)
+{
+    uint64_t i, n;
+    uint32_t has_c, has_h;
+    syncmer_db_t *scm_db;
+
+    ckpt_get1(c, n);
+    ckpt_get1(c, has_c);
+    ckpt_get1(c, has_h);
+    if (ckpt_check_n(c, n)) return 0;
+    MYMALLOC(scm_db, 1);
+    syncmer_db_init(scm_db);
+    MYCALLOC(scm_db->a, n);
+    scm_db->m = n;
+    for (i = 0; i < n && !c->err; ++i) {
+        scm_db->n = i + 1;
+        ckpt_get1(c, scm_db->a[i]);
+        scm_db->a[i].m_pos = ckpt_get_array(c, scm_db->a[i].cov, sizeof(uint64_t));
+    }
+    if (has_c) scm_db->c = ckpt_get_array(c, n, sizeof(uint16_t));
+    if (has_h) scm_db->h = ckpt_get_array(c, n, sizeof(uint64_t));
+    if (c->err) {
+        syncmer_db_destroy(scm_db);
+        return 0;
+    }
+    return scm_db;
+}
+
+static scg_t *ckpt_get_utg(ckpt_cur_t *c, syncmer_db_t *scm_db)
+{
+    uint64_t i, n_vtx, n_arc, l_seq, n_scm_u, n_idx, o;
+    uint32_t has_idx, has_idx_u;
+    char *seq;
+    scg_t *scg;
+    asmg_t *g;
+    asmg_vtx_t *v;
+
+    ckpt_get1(c, n_vtx);
+    ckpt_get1(c, n_arc);
+    if (ckpt_check_n(c, n_vtx) || ckpt_check_n(c, n_arc)) return 0;
+    MYCALLOC(scg, 1);
+    scg->scm_db = scm_db;
+    MYCALLOC(g, 1);
+    scg->utg_asmg = g;
+    MYCALLOC(g->vtx, n_vtx);
+    g->m_vtx = n_vtx;
+    for (i = 0; i < n_vtx && !c->err; ++i) {
+        v = &g->vtx[i];
+        g->n_vtx = i + 1;
+        ckpt_get1(c, *v);
+        v->a = ckpt_get_array(c, v->n, sizeof(uint64_t));
+        v->seq = 0;
+        ckpt_get1(c, l_seq);
+        if (l_seq != UINT64_MAX && (seq = (char *) ckpt_get(c, l_seq)) != 0) {
+            MYMALLOC(v->seq, l_seq + 1);
+            memcpy(v->seq, seq, l_seq);
+            v->seq[l_seq] = 0;
+        }
+    }
+    g->arc = ckpt_get_array(c, n_arc, sizeof(asmg_arc_t));
+    g->n_arc = g->m_arc = g->arc? n_arc : 0;
+    ckpt_get1(c, has_idx);
+    if (has_idx && !c->err) {
+        g->idx_p = ckpt_get_array(c, n_vtx * 2, sizeof(uint64_t));
+        g->idx_n = ckpt_get_array(c, n_vtx * 2, sizeof(uint64_t));
+    }
+    ckpt_get1(c, has_idx_u);
+    ckpt_get1(c, n_scm_u);
+    if (has_idx_u && !c->err) {
+        scg->scm_u = ckpt_get_array(c, n_scm_u, sizeof(uint128_t));
+        n_idx = scg_n_scm(scg) + 1;
+        MYMALLOC(scg->idx_u, n_idx);
+        for (i = 0; i < n_idx; ++i) {
+            ckpt_get1(c, o);
+            if (o > n_scm_u) c->err = 1;
+            scg->idx_u[i] = scg->scm_u + (c->err? 0 : o);
+        }
+    }
+    if (c->err) {
+        scg_destroy(scg);
+        return 0;
+    }
+    return scg;
+}
+
+static scg_ra_v *ckpt_get_ra(ckpt_cur_t *c)
+{
+    uint64_t i, n;
+    int32_t all;
+    scg_ra_v *ra_db;
+
+    ckpt_get1(c, n);
+    ckpt_get1(c, all);
+    if (ckpt_check_n(c, n)) return 0;
+    // the graph snapshot for incremental alignment is not kept
+    // the first round after resuming realigns every read it needs
+    MYCALLOC(ra_db, 1);
+    ra_db->all = all;
+    MYCALLOC(ra_db->a, n);
+    ra_db->m = n;
+    for (i = 0; i < n && !c->err; ++i) {
+        ra_db->n = i + 1;
+        ckpt_get1(c, ra_db->a[i]);
+        ra_db->a[i].a = ckpt_get_array(c, ra_db->a[i].n, sizeof(ra_frg_t));
+    }
+    if (c->err) {
+        scg_ra_v_destroy(ra_db);
+        return 0;
+    }
+    return ra_db;
+}
+
+// the last stage before 'stage' that wrote the part
+static int ckpt_provider(ckpt_t *ck, int stage, int part)
+{
+    int s;
+    for (s = stage; s > 0; --s) {
+        if (s == CKPT_EC && !ck->do_ec) continue;
+        if (ckpt_stage_parts(s) & part) return s;
+    }
+    return 0;
+}
+
+static void ckpt_release(ckpt_t *ck)
+{
+    scg_ra_v_destroy(ck->ra_db);
+    scg_destroy(ck->scg);
+    syncmer_db_destroy(ck->scm_db);
+    sr_db_destroy(ck->sr_db);
+    ck->ra_db = 0;
+    ck->scg = 0;
+    ck->scm_db = 0;
+    ck->sr_db = 0;
+}
+
+// 'bad' marks stage files already found unusable
+static int ckpt_load(ckpt_t *ck, int stage, uint8_t *bad)
+{
+    static const int parts[5] = {CKPT_P_SEQ, CKPT_P_MER, CKPT_P_SCM, CKPT_P_UTG, CKPT_P_RA};
+    int i, s, s1, need, ret;
+    ckpt_file_t f;
+    ckpt_cur_t c;
+
+    need = CKPT_P_SEQ | CKPT_P_MER;
+    if (stage >= CKPT_SCM) need |= CKPT_P_SCM;
+    if (stage >= CKPT_CLEAN) need |= CKPT_P_UTG;
+    if (stage > CKPT_CLEAN) need |= CKPT_P_RA;
+
+    // parts are ordered by the stage that provides them so each file is opened once
+    f.mm = 0;
+    s1 = 0;
+    ret = 0;
+    for (i = 0; i < 5 && !ret; ++i) {
+        if (!(need & parts[i])) continue;
+        s = ckpt_provider(ck, stage, parts[i]);
+        if (s != s1) {
+            ckpt_close(&f);
+            s1 = s;
+            if (bad[s] || ckpt_open(ck, s, &f)) {
+                bad[s] = 1;
+                ret = 1;
+                break;
+            }
+            if (s == stage) {
+                ck->min_k_cov = f.hdr.min_k_cov;
+                ck->aux = f.hdr.aux;
+            }
+        }
+        if (ckpt_find_part(&f, parts[i], &c)) {
+            fprintf(stderr, "[W::%s] incomplete checkpoint of stage %d\n", __func__, s);
+            bad[s] = 1;
+            ret = 1;
+            break;
+        }
+        switch (parts[i]) {
+            case CKPT_P_SEQ:
+                ret = (ck->sr_db = ckpt_get_seq(&c)) == 0;
+                break;
+            case CKPT_P_MER:
+                ret = ckpt_get_mer(&c, ck->sr_db);
+                break;
+            case CKPT_P_SCM:
+                ret = (ck->scm_db = ckpt_get_scm(&c)) == 0;
+                break;
+            case CKPT_P_UTG:
+                ret = (ck->scg = ckpt_get_utg(&c, ck->scm_db)) == 0;
+                break;
+            case CKPT_P_RA:
+                ret = (ck->ra_db = ckpt_get_ra(&c)) == 0;
+                break;
+        }
+        if (ret) {
+            fprintf(stderr, "[W::%s] corrupted checkpoint of stage %d\n", __func__, s);
+            bad[s] = 1;
+        }
+    }
+    ckpt_close(&f);
+
+    if (ret) ckpt_release(ck);
+
+    return ret;
+}
+
+static int ckpt_resume(ckpt_t *ck)
+{
+    DIR *dir;
+    struct dirent *ent;
+    int stage, max_stage;
+    uint8_t bad[CKPT_MAX_STAGE + 1];
+
+    MYBZERO(bad, CKPT_MAX_STAGE + 1);
+    max_stage = 0;
+    dir = opendir(ck->dir);
+    if (dir) {
+        while ((ent = readdir(dir)) != 0) {
+            stage = ckpt_file_stage(ent->d_name);
+            if (stage > max_stage) max_stage = stage;
+        }
+        closedir(dir);
+    }
+
+    for (stage = max_stage; stage > 0; --stage) {
+        if (stage == CKPT_EC && !ck->do_ec) continue;
+        if (ckpt_load(ck, stage, bad) == 0) {
+            if (stage > CKPT_CLEAN)
+                fprintf(stderr, "[M::%s] resume from checkpoint stage %d (%s round %d)\n", __func__,
+                        stage, ckpt_stage_name(stage), stage - CKPT_UNZIP);
+            else
+                fprintf(stderr, "[M::%s] resume from checkpoint stage %d (%s)\n", __func__,
+                        stage, ckpt_stage_name(stage));
+            ck->stage = stage;
+            ckpt_remove(ck, stage);
+            return stage;
+        }
+    }
+
+    fprintf(stderr, "[M::%s] no usable checkpoint in %s - start from the beginning\n", __func__, ck->dir);
+    ckpt_remove(ck, 0);
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2023 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "syncmer.h"
+#include "syncasm.h"
+
+/* Stage checkpoints for syncasm
+ *
+ * One file per stage, DIR/stageNN.ckpt, written to a temporary file and
+ * renamed when complete:
+ *
+ * [ckpt_hdr_t][parts][uint64 file length][uint64 crc32 of everything before]
+ *
+ * A stage only stores the parts changed since the previous stage; a resumed
+ * run collects each part from the last stage that wrote it. Checkpoints are
+ * only meant to be read back by the same build: structures are dumped in
+ * host layout and the header records their sizes.
+ */
+
+#define CKPT_MAGIC "OACK"
+#define CKPT_VERSION 3
+
+#define CKPT_READ  1 // reads collected
+#define CKPT_SCM   2 // syncmer database
+#define CKPT_EC    3 // read error correction
+#define CKPT_CLEAN 4 // unitig graph after initial cleanup
+#define CKPT_UNZIP 4 // CKPT_UNZIP + r for unzipping round r
+
+#define CKPT_P_SEQ 0x1  // read names and sequences
+#define CKPT_P_MER 0x2  // read syncmers and stats
+#define CKPT_P_SCM 0x4  // syncmer database
+#define CKPT_P_UTG 0x8  // unitig graph
+#define CKPT_P_RA  0x10 // read alignments
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t phash; // parameter hash
+    uint64_t abi; // structure sizes
+    uint32_t stage, parts;
+    int32_t min_k_cov; // resolved minimum kmer coverage
+    int32_t aux; // unzip: updated flag of the round
+} ckpt_hdr_t;
+
+typedef struct {
+    char *dir;
+    uint64_t phash;
+    int do_ec;
+    // resumed state
+    int stage;
+    int min_k_cov;
+    int aux;
+    sr_db_t *sr_db;
+    syncmer_db_t *scm_db;
+    scg_t *scg;
+    scg_ra_v *ra_db;
+    // background writer
+    pthread_t tid;
+    void *job; // snapshot being written
+} ckpt_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ckpt_t *ckpt_init(const char *dir, char **file_in, int n_file, const char *param, int do_ec, int resume);
+void ckpt_destroy(ckpt_t *ck);
+void ckpt_save(ckpt_t *ck, int stage, sr_db_t *sr_db, syncmer_db_t *scm_db, scg_t *scg, scg_ra_v *ra_db, int min_k_cov, int aux);
+void ckpt_wait(ckpt_t *ck);
+static inline int ckpt_stage(ckpt_t *ck) { return ck? ck->stage : 0; }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,363 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2023 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "khashl.h"
+#include "kstring.h"
+#include "kseq.h"
+#include "kvec.h"
+
+#include "gfai.h"
+#include "misc.h"
+
+KSTREAM_INIT(gzFile, gzread, 65536)
+KHASHL_MAP_INIT(KH_LOCAL, kh_gfai_t, kh_gfai, kh_cstr_t, uint64_t, kh_hash_str, kh_eq_str)
+
+// return the total size of a BGZF block from its header, or 0 if it is not a BGZF block
+static int bgzf_block_size(const uint8_t *h, int l_h)
+{
+    int i, xlen;
+    if (l_h < 12 || h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || !(h[3] & 4))
+        return 0;
+    xlen = h[10] | h[11] << 8;
+    if (l_h < 12 + xlen) return 0;
+    for (i = 12; i + 4 <= 12 + xlen; i += 4 + (h[i+2] | h[i+3] << 8)) {
+        if (h[i] == 'B' && h[i+1] == 'C' && (h[i+2] | h[i+3] << 8) == 2 && i + 6 <= 12 + xlen)
+            return (h[i+4] | h[i+5] << 8) + 1;
+    }
+    return 0;
+}
+
+// load the block at coff
+// return 0 on success, -1 at the end of the file, -2 on errors
+static int gfai_rdr_load(gfai_rdr_t *r, uint64_t coff)
+{
+    ssize_t n;
+    r->coff = coff;
+    r->pos = r->l_blk = 0;
+    if (!r->is_bgzf) {
+        n = pread(r->fd, r->ubuf, GFAI_BLOCK_SIZE, coff);
+        if (n < 0) return -2;
+        if (n == 0) return -1;
+        r->l_blk = n;
+        r->next_coff = coff + n;
+    } else {
+        int b_size, xlen, ret;
+        z_stream zs;
+        n = pread(r->fd, r->cbuf, 18, coff);
+        if (n == 0) return -1;
+        if (n < 18) return -2;
+        xlen = r->cbuf[10] | r->cbuf[11] << 8;
+        if (12 + xlen > GFAI_BLOCK_SIZE) return -2;
+        if (pread(r->fd, r->cbuf, 12 + xlen, coff) != 12 + xlen) return -2;
+        b_size = bgzf_block_size(r->cbuf, 12 + xlen);
+        if (b_size < 12 + xlen + 8 || b_size > GFAI_BLOCK_SIZE) return -2;
+        if (pread(r->fd, r->cbuf, b_size, coff) != b_size) return -2;
+        memset(&zs, 0, sizeof(z_stream));
+        if (inflateInit2(&zs, -15) != Z_OK) return -2;
+        zs.next_in = r->cbuf + 12 + xlen;
+        zs.avail_in = b_size - 12 - xlen - 8;
+        zs.next_out = (uint8_t *) r->ubuf;
+        zs.avail_out = GFAI_BLOCK_SIZE;
+        ret = inflate(&zs, Z_FINISH);
+        r->l_blk = GFAI_BLOCK_SIZE - zs.avail_out;
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END) return -2;
+        r->next_coff = coff + b_size;
+    }
+    return 0;
+}
+
+// open a plain or bgzip-compressed GFA file for random access
+// return 0 for other files (gzip, FASTA/FASTQ, binary graph, stdin etc)
+gfai_rdr_t *gfai_rdr_open(const char *fn)
+{
+    int fd, l, i;
+    uint8_t h[GFAI_BLOCK_SIZE];
+    struct stat st;
+    gfai_rdr_t *r;
+
+    if (fn == 0 || strcmp(fn, "-") == 0) return 0;
+    fd = open(fn, O_RDONLY);
+    if (fd < 0) return 0;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+            (l = pread(fd, h, GFAI_BLOCK_SIZE, 0)) <= 0 ||
+            (l >= 2 && h[0] == 0x1f && h[1] == 0x8b && !bgzf_block_size(h, l)) ||
+            (l >= 4 && !memcmp(h, "OAGB", 4))) {
+        close(fd);
+        return 0;
+    }
+
+    MYCALLOC(r, 1);
+    r->fd = fd;
+    r->is_bgzf = h[0] == 0x1f && h[1] == 0x8b;
+    MYMALLOC(r->ubuf, GFAI_BLOCK_SIZE);
+    if (r->is_bgzf) MYMALLOC(r->cbuf, GFAI_BLOCK_SIZE);
+    if (gfai_rdr_load(r, 0) < 0) {
+        gfai_rdr_close(r);
+        return 0;
+    }
+    // the first line tells GFA from FASTA/FASTQ
+    for (i = 0; i < r->l_blk && r->ubuf[i] == '\n'; ++i) {}
+    if (i == r->l_blk || r->ubuf[i] == '>' || r->ubuf[i] == '@') {
+        gfai_rdr_close(r);
+        return 0;
+    }
+    return r;
+}
+
+void gfai_rdr_close(gfai_rdr_t *r)
+{
+    if (r == 0) return;
+    close(r->fd);
+    free(r->cbuf);
+    free(r->ubuf);
+    free(r);
+}
+
+int gfai_rdr_seek(gfai_rdr_t *r, uint64_t voff)
+{
+    uint64_t coff = voff >> 16;
+    int uoff = voff & 0xffff;
+    if (coff != r->coff || r->l_blk == 0) {
+        if (gfai_rdr_load(r, coff) < 0)
+            return -1;
+    }
+    if (uoff > r->l_blk) return -1;
+    r->pos = uoff;
+    return 0;
+}
+
+// read a line without the newline and set voff to the virtual offset of its start
+// return the line length, -1 at the end of the file or -2 on errors
+int gfai_rdr_getline(gfai_rdr_t *r, kstring_t *s, uint64_t *voff)
+{
+    int ret;
+    char *p;
+    s->l = 0;
+    while (r->pos == r->l_blk) // end of the block
+        if ((ret = gfai_rdr_load(r, r->next_coff)) < 0) return ret;
+    if (voff) *voff = r->coff << 16 | r->pos;
+    for (;;) {
+        p = memchr(r->ubuf + r->pos, '\n', r->l_blk - r->pos);
+        if (p) {
+            kputsn(r->ubuf + r->pos, p - r->ubuf - r->pos, s);
+            r->pos = p - r->ubuf + 1;
+            break;
+        }
+        kputsn(r->ubuf + r->pos, r->l_blk - r->pos, s);
+        r->pos = r->l_blk;
+        do {
+            ret = gfai_rdr_load(r, r->next_coff);
+        } while (ret == 0 && r->l_blk == 0);
+        if (ret == -1) break; // no newline at the end of the file
+        if (ret < 0) return ret;
+    }
+    if (s->l > 1 && s->s[s->l-1] == '\r') // as ks_getuntil() does
+        s->s[--s->l] = 0;
+    if (s->s == 0) kputsn("", 0, s);
+    return s->l;
+}
+
+typedef struct {
+    uint64_t s_voff;
+    kvec_t(uint64_t) l_voff;
+} gfai_ent_t;
+
+typedef struct {size_t n, m; gfai_ent_t *a;} gfai_ent_v;
+
+static uint64_t gfai_ent_get(kh_gfai_t *h, gfai_ent_v *ents, const char *name)
+{
+    khint_t k;
+    int absent;
+    gfai_ent_t *e;
+    k = kh_gfai_put(h, name, &absent);
+    if (absent) {
+        kh_key(h, k) = strdup(name);
+        kh_val(h, k) = ents->n;
+        kv_pushp(gfai_ent_t, *ents, &e);
+        e->s_voff = UINT64_MAX;
+        kv_init(e->l_voff);
+    }
+    return kh_val(h, k);
+}
+
+// build the index in a streaming pass and write it to fn_idx
+// return 0 on success
+int gfai_build(gfai_rdr_t *r, const char *fn, const char *fn_idx)
+{
+    int ret;
+    uint64_t i, j, voff, v, w;
+    char *p, *q, *t, *tmp;
+    FILE *fo;
+    struct stat st;
+    kh_gfai_t *h;
+    khint_t k;
+    gfai_ent_v ents;
+    kstring_t s = {0, 0, 0};
+
+    if (stat(fn, &st) < 0 || gfai_rdr_seek(r, 0) < 0)
+        return 1;
+    h = kh_gfai_init();
+    kv_init(ents);
+    while ((ret = gfai_rdr_getline(r, &s, &voff)) >= 0) {
+        if (s.l < 2 || s.s[1] != '\t' || (s.s[0] != 'S' && s.s[0] != 'L'))
+            continue;
+        p = s.s + 2;
+        q = strchr(p, '\t');
+        if (q) *q = 0;
+        v = gfai_ent_get(h, &ents, p);
+        if (s.s[0] == 'S') {
+            ents.a[v].s_voff = voff;
+        } else {
+            kv_push(uint64_t, ents.a[v].l_voff, voff);
+            // the other end in the third field
+            if (q && (q = strchr(q + 1, '\t')) != 0) {
+                p = q + 1;
+                t = strchr(p, '\t');
+                if (t) *t = 0;
+                w = gfai_ent_get(h, &ents, p);
+                if (w != v) kv_push(uint64_t, ents.a[w].l_voff, voff);
+            }
+        }
+    }
+
+    // write to a temporary file so that a concurrent reader never sees a partial index
+    MYMALLOC(tmp, strlen(fn_idx) + 32);
+    sprintf(tmp, "%s.%d.tmp", fn_idx, (int) getpid());
+    fo = ret == -1? fopen(tmp, "w") : 0;
+    if (fo) {
+        // keys in the order of the first appearance
+        char **names;
+        MYMALLOC(names, ents.n);
+        for (k = 0; k < kh_end(h); ++k)
+            if (kh_exist(h, k)) names[kh_val(h, k)] = (char *) kh_key(h, k);
+        fprintf(fo, "#gfai\t%lld\t%lld\t%ld\n", (long long) st.st_size, (long long) st.st_mtime, (long) st.st_mtim.tv_nsec);
+        for (i = 0; i < ents.n; ++i) {
+            gfai_ent_t *e = &ents.a[i];
+            fprintf(fo, "%s\t", names[i]);
+            if (e->s_voff == UINT64_MAX) fputc('*', fo);
+            else fprintf(fo, "%lu", e->s_voff);
+            fputc('\t', fo);
+            if (e->l_voff.n == 0) fputc('*', fo);
+            for (j = 0; j < e->l_voff.n; ++j)
+                fprintf(fo, j? ",%lu" : "%lu", e->l_voff.a[j]);
+            fputc('\n', fo);
+        }
+        free(names);
+        if (fclose(fo) != 0) ret = -2;
+        if (ret == -1 && rename(tmp, fn_idx) != 0) ret = -2;
+    }
+    if (ret != -1 || fo == 0) {
+        fprintf(stderr, "[W::%s] failed to build the index %s\n", __func__, fn_idx);
+        remove(tmp);
+    }
+    free(tmp);
+
+    for (k = 0; k < kh_end(h); ++k)
+        if (kh_exist(h, k)) free((char *) kh_key(h, k));
+    kh_gfai_destroy(h);
+    for (i = 0; i < ents.n; ++i)
+        kv_destroy(ents.a[i].l_voff);
+    kv_destroy(ents);
+    free(s.s);
+
+    return ret != -1 || fo == 0;
+}
+
+static int u64_cmpfunc(const void *a, const void *b)
+{
+    uint64_t x = *(uint64_t *) a, y = *(uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// collect the virtual offsets of the S-lines of the named segs and the L-lines on them
+// return a sorted list, or 0 if the index is missing or out of date
+uint64_t *gfai_query(const char *fn, const char *fn_idx, char **names, uint64_t n_names, uint64_t *n_voff)
+{
+    int dret, absent;
+    uint64_t i, j;
+    long long size, mtime;
+    long nsec;
+    char *p, *q;
+    gzFile fp;
+    kstream_t *ks;
+    struct stat st;
+    kh_gfai_t *h;
+    kvec_t(uint64_t) voffs;
+    kstring_t s = {0, 0, 0};
+
+    if (stat(fn, &st) < 0 || (fp = gzopen(fn_idx, "r")) == 0)
+        return 0;
+    ks = ks_init(fp);
+    if (ks_getuntil(ks, KS_SEP_LINE, &s, &dret) < 0 ||
+            sscanf(s.s, "#gfai\t%lld\t%lld\t%ld", &size, &mtime, &nsec) != 3 ||
+            size != (long long) st.st_size || mtime != (long long) st.st_mtime ||
+            nsec != (long) st.st_mtim.tv_nsec) {
+        ks_destroy(ks);
+        gzclose(fp);
+        free(s.s);
+        return 0;
+    }
+
+    h = kh_gfai_init();
+    for (i = 0; i < n_names; ++i)
+        kh_gfai_put(h, names[i], &absent);
+    kv_init(voffs);
+    while (ks_getuntil(ks, KS_SEP_LINE, &s, &dret) >= 0) {
+        p = strchr(s.s, '\t');
+        if (p == 0) continue;
+        *p++ = 0;
+        if (kh_gfai_get(h, s.s) == kh_end(h)) continue;
+        if (*p != '*') kv_push(uint64_t, voffs, strtoull(p, &p, 10));
+        else ++p;
+        if (*p++ != '\t') continue;
+        while (*p && *p != '*') {
+            kv_push(uint64_t, voffs, strtoull(p, &q, 10));
+            if (q == p) break;
+            p = *q == ','? q + 1 : q;
+        }
+    }
+    kh_gfai_destroy(h);
+    ks_destroy(ks);
+    gzclose(fp);
+    free(s.s);
+
+    // an L-line is listed under both of its segs
+    if (voffs.n > 1) qsort(voffs.a, voffs.n, sizeof(uint64_t), u64_cmpfunc);
+    for (i = j = 0; i < voffs.n; ++i)
+        if (j == 0 || voffs.a[i] != voffs.a[j-1])
+            voffs.a[j++] = voffs.a[i];
+    *n_voff = j;
+    if (voffs.a == 0) MYMALLOC(voffs.a, 1);
+    return voffs.a;
+}
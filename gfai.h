@@ -0,0 +1,69 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2023 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+#ifndef __GFAI_H__
+#define __GFAI_H__
+
+#include <stdint.h>
+
+#include "kstring.h"
+
+/* Sidecar index (.gfai) for random access to the S- and L-lines of a plain or
+ * bgzip-compressed GFA file
+ *
+ * #gfai <file size> <file mtime seconds> <file mtime nanoseconds>
+ * <seg name> <voff of the S-line or *> <comma separated voffs of the L-lines on the seg or *>
+ *
+ * A virtual offset (voff) is coff<<16|uoff, where coff is the file offset of a
+ * block and uoff the offset in the uncompressed block. Blocks of a plain file are
+ * 64 KB slices of the file; blocks of a bgzip file are its BGZF blocks.
+ */
+
+#define GFAI_BLOCK_SIZE 0x10000
+
+typedef struct {
+    int fd;
+    int is_bgzf;
+    uint64_t coff, next_coff; // file offset of the current and the next block
+    int l_blk, pos; // size of and position in the uncompressed current block
+    uint8_t *cbuf;
+    char *ubuf;
+} gfai_rdr_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+gfai_rdr_t *gfai_rdr_open(const char *fn);
+void gfai_rdr_close(gfai_rdr_t *r);
+int gfai_rdr_seek(gfai_rdr_t *r, uint64_t voff);
+int gfai_rdr_getline(gfai_rdr_t *r, kstring_t *s, uint64_t *voff);
+int gfai_build(gfai_rdr_t *r, const char *fn, const char *fn_idx);
+uint64_t *gfai_query(const char *fn, const char *fn_idx, char **names, uint64_t n_names, uint64_t *n_voff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1289,66 +1289,81 @@ do_clean:
     return exists;
 }
 
-static void scc_util(asmg_t *g, uint64_t v, int *disc, int *low, kdq_u64_t *st, int *stb, int *depth, int *scc, int *n_scc)
-{
-    uint64_t i, w, n;
-    asmg_arc_t *a;
-
-    disc[v] = low[v] = ++*depth;
-    kdq_push(uint64_t, st, v);
-    stb[v] = 1;
-
-    a = asmg_arc_a(g, v);
-    n = asmg_arc_n(g, v);
-    for (i = 0; i < n; ++i) {
-        if (a[i].del) continue;
-        w = a[i].w;
-        if (g->vtx[w>>1].del) continue;
-        if (disc[w] == -1) {
-            scc_util(g, w, disc, low, st, stb, depth, scc, n_scc);
-            low[v] = MIN(low[v], low[w]);
-        } else if (stb[w] == 1) {
-            low[v] = MIN(low[v], disc[w]);
-        }
-    }
-    
-    if (low[v] == disc[v]) {
-        do {
-            w = *kdq_pop(uint64_t, st);
-            stb[w] = 0;
-            scc[w] = *n_scc;
-        } while (w != v);
-        ++*n_scc;
-    }
-}
-
+// Tarjan's algorithm without recursion
+// the DFS call stack is kept in cs (vertex) and ci (next arc to visit)
+// so the stack depth is not limited by long chains
+// vertices are visited in the same order as the recursive version
 int asmg_tarjans_scc(asmg_t *g, int *scc)
 {
-    uint64_t i, n_seg;
-    int n_scc, depth, *low, *disc, *stb;
-    kdq_u64_t *st;
+    uint32_t i, v, w, n_seg, n_cs, n_st, *cs, *ci, *st;
+    uint64_t k, n;
+    int n_scc, depth, *low, *disc;
+    uint8_t *stb;
+    asmg_arc_t *a;
 
     n_seg = asmg_vtx_n(g);
     MYMALLOC(low, n_seg);
     MYMALLOC(disc, n_seg);
-    MYMALLOC(stb, n_seg);
-    st = kdq_init(uint64_t, 0);
+    MYCALLOC(stb, n_seg);
+    MYMALLOC(cs, n_seg);
+    MYMALLOC(ci, n_seg);
+    MYMALLOC(st, n_seg);
     for (i = 0; i < n_seg; ++i) {
         scc[i] = -1;
         low[i] = -1;
         disc[i] = -1;
-        stb[i] = 0;
     }
     
     n_scc = depth = 0;
-    for (i = 0; i < n_seg; ++i)
-        if (disc[i] == -1 && !g->vtx[i>>1].del)
-            scc_util(g, i, disc, low, st, stb, &depth, scc, &n_scc);
+    n_st = 0;
+    for (i = 0; i < n_seg; ++i) {
+        if (disc[i] != -1 || g->vtx[i>>1].del)
+            continue;
+        disc[i] = low[i] = ++depth;
+        st[n_st++] = i;
+        stb[i] = 1;
+        cs[0] = i, ci[0] = 0, n_cs = 1;
+        while (n_cs > 0) {
+            v = cs[n_cs-1];
+            a = asmg_arc_a(g, v);
+            n = asmg_arc_n(g, v);
+            if (ci[n_cs-1] < n) {
+                k = ci[n_cs-1]++;
+                if (a[k].del) continue;
+                w = a[k].w;
+                if (g->vtx[w>>1].del) continue;
+                if (disc[w] == -1) {
+                    // descend to w
+                    disc[w] = low[w] = ++depth;
+                    st[n_st++] = w;
+                    stb[w] = 1;
+                    cs[n_cs] = w, ci[n_cs] = 0, ++n_cs;
+                } else if (stb[w] == 1) {
+                    low[v] = MIN(low[v], disc[w]);
+                }
+                continue;
+            }
+            // all arcs of v visited
+            if (low[v] == disc[v]) {
+                do {
+                    w = st[--n_st];
+                    stb[w] = 0;
+                    scc[w] = n_scc;
+                } while (w != v);
+                ++n_scc;
+            }
+            // return to the caller
+            if (--n_cs > 0)
+                low[cs[n_cs-1]] = MIN(low[cs[n_cs-1]], low[v]);
+        }
+    }
 
     free(low);
     free(disc);
     free(stb);
-    kdq_destroy(uint64_t, st);
+    free(cs);
+    free(ci);
+    free(st);
     
     return n_scc;
 }
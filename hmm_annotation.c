@@ -30,12 +30,22 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
 #include <zlib.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <assert.h>
+#include <signal.h>
+#include <pthread.h>
 
 #include "kthread.h"
 #include "kvec.h"
+#include "khashl.h"
+#include "kstring.h"
 #include "kseq.h"
 
 #include "misc.h"
@@ -51,19 +61,66 @@ typedef struct {
     uint32_t max_batch_size;
     uint32_t max_batch_num;
     char *nhmmscan;
-    char *nhmmdb;
+    char **nhmm_argv; // words of the nhmmscan command
+    int nhmm_argc;
+    char **nhmmdb; // HMM databases sharing the batches
+    int n_db;
     kstream_t *ks;
     kstring_t *s;
-    FILE *fo;
+    int fmt; // input format: 0 for unknown, 1 for FASTA, 2 for FASTQ and 3 for GFA
+    FILE **fo; // output of each database
     char *tmpdir;
-    int n_threads;
+    const kt_ctx_t *kc; // threads the nhmmscan jobs of a batch run on
+    int stream; // pipe sequences and results through nhmmscan instead of using temp files
+    char *cache_dir; // on-disk annotation cache
+    void *pf; // k-mer prefilter
+    int pf_min; // minimum number of seed hits to run nhmmscan
+    uint64_t *db_sum; // checksum of each HMM database (two words per database)
 } annot_pipeline_t;
 
+typedef struct {
+    char *name;
+    char *seq;
+    uint32_t len, n_win; // sequence length and number of nhmmscan windows
+    uint64_t h[2]; // sequence hash
+    int hit; // found in the annotation cache for all databases
+    int skip; // no seed hit in the prefilter
+    kstring_t *tbl; // tblout rows for each database
+} annot_rec_t;
+
+typedef struct {
+    size_t n, m;
+    annot_rec_t *a;
+} annot_rec_v;
+
+typedef struct {
+    uint32_t rid, off, len, bid; // record index, window offset and length, batch index
+} annot_win_t;
+
+typedef struct {
+    uint32_t rid, off; // record index and window offset
+    uint32_t st, en; // envelope on the record sequence
+    uint32_t strand:1, del:1;
+    double score;
+    size_t t_o, t_l; // target name in the row
+    size_t o, l; // row in the buffer
+} annot_hit_t;
+
+typedef struct {
+    size_t n, m;
+    annot_hit_t *a;
+} annot_hit_v;
+
 typedef struct {
     annot_pipeline_t *shared;
-    int batch_num;
-    char **temp_in;
-    char **temp_out;
+    int batch_num; // job (b, d) for batch b and database d has index b * n_db + d
+    char **temp_in; // FASTA of each batch
+    char **temp_out; // nhmmscan tblout of each job
+    // stream mode
+    char **seq_in; // FASTA of each batch
+    size_t *l_seq_in;
+    kstring_t *tbl_out; // nhmmscan tblout of each job
+    annot_rec_v rec; // all sequences of the step in input order
 } annot_step_t;
 
 static inline int parse_fheader(char *s)
@@ -104,196 +161,905 @@ static inline int parse_gseq(char *s, char **seg, char **seq)
     return 0;
 }
 
+// read the next sequence record from a FASTA/FASTQ/GFA file
+// return 0 on success, -1 at the end of the file or a positive error code
+static int annot_read_record(kstream_t *ks, kstring_t *s, int *fmt, kstring_t *name, kstring_t *seq)
+{
+    int dret, ret;
+    char *seg, *sq;
+
+    name->l = seq->l = 0;
+    while (s->l || ks_getuntil(ks, KS_SEP_LINE, s, &dret) >= 0) {
+        if (s->l == 0) // empty line
+            continue;
+
+        if (*fmt == 0)
+            *fmt = s->s[0] == '>'? 1 : (s->s[0] == '@'? 2 : 3);
+
+        if (*fmt == 3) { // GFA
+            if (s->s[0] != 'S') {
+                s->l = 0;
+                continue;
+            }
+            ret = parse_gseq(s->s, &seg, &sq);
+            if (!ret) {
+                kputs(seg, name);
+                kputs(sq, seq);
+            }
+            s->l = 0;
+            return ret;
+        }
+
+        // FASTA or FASTQ header
+        if (parse_fheader(s->s))
+            return 1;
+        kputs(s->s + 1, name);
+        s->l = 0;
+
+        if (*fmt == 2) {
+            if (ks_getuntil(ks, KS_SEP_LINE, s, &dret) < 0)
+                return 2;
+            kputsn(s->s, s->l, seq);
+            // skip quality score lines
+            if (ks_getuntil(ks, KS_SEP_LINE, s, &dret) < 0 ||
+                    ks_getuntil(ks, KS_SEP_LINE, s, &dret) < 0)
+                return 3;
+            s->l = 0;
+            return 0;
+        }
+
+        while (ks_getuntil(ks, KS_SEP_LINE, s, &dret) >= 0) {
+            if (s->l && s->s[0] == '>') // keep the next header
+                return 0;
+            kputsn(s->s, s->l, seq);
+        }
+        s->l = 0;
+        return 0;
+    }
+
+    return -1;
+}
+
+/***************************
+ * On-disk annotation cache *
+ ***************************/
+// a cache entry <cache_dir>/<db checksum>/<sequence hash> keeps the tblout rows of a sequence against a database
+// it is empty if nhmmscan found nothing; the query name is rewritten when the entry is used
+
+static inline uint64_t annot_fnv64(const void *p, size_t l, uint64_t h)
+{
+    const uint8_t *s = (const uint8_t *) p;
+    size_t i;
+    for (i = 0; i < l; ++i)
+        h = (h ^ s[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static inline uint64_t annot_mix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static inline void annot_seq_hash(const char *seq, size_t l, uint64_t h[2])
+{
+    h[0] = annot_mix64(annot_fnv64(seq, l, 0xcbf29ce484222325ULL) ^ l);
+    h[1] = annot_mix64(annot_fnv64(seq, l, 0x84222325cbf29ce4ULL) + l);
+}
+
+static int annot_db_checksum(char *db, uint64_t h[2])
+{
+    FILE *fp;
+    char buf[65536];
+    size_t n, l;
+
+    fp = fopen(db, "r");
+    if (fp == NULL) return 1;
+    h[0] = 0xcbf29ce484222325ULL;
+    h[1] = 0x84222325cbf29ce4ULL;
+    l = 0;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        h[0] = annot_fnv64(buf, n, h[0]);
+        h[1] = annot_fnv64(buf, n, h[1]);
+        l += n;
+    }
+    fclose(fp);
+    h[0] = annot_mix64(h[0] ^ l);
+    h[1] = annot_mix64(h[1] + l);
+    return 0;
+}
+
+static int annot_cache_init(annot_pipeline_t *p, int d)
+{
+    kstring_t path = {0, 0, 0};
+    uint64_t *db_sum = &p->db_sum[d << 1];
+    int ret = 0;
+
+    if (annot_db_checksum(p->nhmmdb[d], db_sum)) {
+        fprintf(stderr, "[W::%s] failed to read HMM database %s\n", __func__, p->nhmmdb[d]);
+        return 1;
+    }
+    ksprintf(&path, "%s/%016lx%016lx", p->cache_dir, db_sum[0], db_sum[1]);
+    if ((mkdir(p->cache_dir, 0755) && errno != EEXIST) || (mkdir(path.s, 0755) && errno != EEXIST)) {
+        fprintf(stderr, "[W::%s] failed to create cache directory %s: %s\n", __func__, path.s, strerror(errno));
+        ret = 1;
+    }
+    free(path.s);
+    return ret;
+}
+
+static inline void annot_cache_path(annot_pipeline_t *p, int d, uint64_t h[2], kstring_t *path)
+{
+    path->l = 0;
+    ksprintf(path, "%s/%016lx%016lx/%016lx%016lx", p->cache_dir, p->db_sum[d << 1], p->db_sum[d << 1 | 1], h[0], h[1]);
+}
+
+static int annot_cache_get(annot_pipeline_t *p, int d, uint64_t h[2], kstring_t *tbl, kstring_t *path)
+{
+    FILE *fp;
+    char buf[65536];
+    size_t n;
+
+    annot_cache_path(p, d, h, path);
+    fp = fopen(path->s, "r");
+    if (fp == NULL) return 0;
+    tbl->l = 0;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        kputsn(buf, n, tbl);
+    fclose(fp);
+    return 1;
+}
+
+static void annot_cache_put(annot_pipeline_t *p, int d, uint64_t h[2], kstring_t *tbl, kstring_t *path)
+{
+    static unsigned n_put = 0;
+    FILE *fp;
+    size_t l;
+
+    annot_cache_path(p, d, h, path);
+    l = path->l;
+    // write to a temp file first so a concurrent run never reads a partial entry
+    // the counter keeps names apart when several samples annotate in one process
+    ksprintf(path, ".%d.%u.tmp", (int) getpid(), __sync_fetch_and_add(&n_put, 1));
+    fp = fopen(path->s, "w");
+    if (fp == NULL) return;
+    if (tbl->l) fwrite(tbl->s, 1, tbl->l, fp);
+    if (fclose(fp) == 0) {
+        char *tmp = strdup(path->s);
+        path->s[l] = 0;
+        rename(tmp, path->s);
+        free(tmp);
+    } else {
+        remove(path->s);
+    }
+}
+
+// the query name is the third column of a tblout row
+static inline int annot_tbl_qname(char *row, char *end, char **qb, char **qe)
+{
+    int i;
+    char *c = row;
+    for (i = 0; i < 3; ++i) {
+        while (c < end && isspace(*c)) ++c;
+        *qb = c;
+        while (c < end && !isspace(*c)) ++c;
+        *qe = c;
+    }
+    return *qe > *qb? 0 : 1;
+}
+
+// write cached tblout rows with the query name replaced by the sequence name
+static void annot_tbl_rename(kstring_t *tbl, char *name, FILE *fo)
+{
+    char *row, *end, *qb, *qe;
+
+    row = tbl->s;
+    end = tbl->s + tbl->l;
+    while (row < end) {
+        char *eol = memchr(row, '\n', end - row);
+        eol = eol? eol + 1 : end;
+        if (!annot_tbl_qname(row, eol, &qb, &qe)) {
+            fwrite(row, 1, qb - row, fo);
+            fputs(name, fo);
+            fwrite(qe, 1, eol - qe, fo);
+        }
+        row = eol;
+    }
+}
+
+/*******************
+ * K-mer prefilter *
+ *******************/
+// spaced seeds skipping the third base of each codon: 16 informative bases in a span of 24
+#define ANNOT_SEED_SPAN 24
+
+KHASHL_SET_INIT(KH_LOCAL, kh_seed_t, kh_seed, uint32_t, kh_hash_uint32, kh_eq_generic)
+
+typedef struct {
+    kh_seed_t *h;
+    double occ; // fraction of all seeds in the index
+} annot_pf_t;
+
+static inline int annot_nt4(int c)
+{
+    switch (c) {
+        case 'A': case 'a': return 0;
+        case 'C': case 'c': return 1;
+        case 'G': case 'g': return 2;
+        case 'T': case 't': case 'U': case 'u': return 3;
+        default: return 4;
+    }
+}
+
+// seed at position i of an nt4 sequence; return -1 if it has an ambiguous base
+static inline int64_t annot_seed(const uint8_t *s, size_t i)
+{
+    int j;
+    uint32_t x = 0;
+    for (j = 0; j < ANNOT_SEED_SPAN; ++j) {
+        if (j % 3 == 2) continue;
+        if (s[i + j] > 3) return -1;
+        x = x << 2 | s[i + j];
+    }
+    return x;
+}
+
+static void annot_pf_add(annot_pf_t *pf, const char *seq, size_t l)
+{
+    size_t i;
+    int64_t x;
+    int absent;
+    uint8_t *s;
+
+    if (l < ANNOT_SEED_SPAN) return;
+    MYMALLOC(s, l);
+    // forward strand
+    for (i = 0; i < l; ++i)
+        s[i] = annot_nt4(seq[i]);
+    for (i = 0; i + ANNOT_SEED_SPAN <= l; ++i)
+        if ((x = annot_seed(s, i)) >= 0)
+            kh_seed_put(pf->h, x, &absent);
+    // reverse strand
+    for (i = 0; i < l; ++i) {
+        int c = annot_nt4(seq[l - 1 - i]);
+        s[i] = c < 4? 3 - c : 4;
+    }
+    for (i = 0; i + ANNOT_SEED_SPAN <= l; ++i)
+        if ((x = annot_seed(s, i)) >= 0)
+            kh_seed_put(pf->h, x, &absent);
+    free(s);
+}
+
+// collect the consensus of each nucleotide profile HMM, i.e. the most likely base of each match state
+static int annot_hmm_consensus(char *db, kstring_t *cons)
+{
+    FILE *fp;
+    char *line = NULL, *p, *q;
+    size_t ln = 0;
+    int i, b, in_hmm, is_nt;
+    double e, best;
+
+    fp = fopen(db, "r");
+    if (fp == NULL) return -1;
+
+    in_hmm = 0, is_nt = 1;
+    while (getline(&line, &ln, fp) != -1) {
+        if (!strncmp(line, "//", 2)) {
+            kputc('N', cons); // separate models
+            in_hmm = 0, is_nt = 1;
+        } else if (!strncmp(line, "ALPH", 4) && isspace(line[4])) {
+            for (p = line + 4; isspace(*p); ++p) {}
+            is_nt = !strncasecmp(p, "DNA", 3) || !strncasecmp(p, "RNA", 3);
+        } else if (!strncmp(line, "HMM", 3) && isspace(line[3])) {
+            in_hmm = 1;
+        } else if (in_hmm && is_nt) {
+            // a match state line starts with the node index followed by four emission scores
+            for (p = line; isspace(*p); ++p) {}
+            if (!isdigit(*p)) continue;
+            strtol(p, &q, 10);
+            if (!isspace(*q)) continue;
+            for (i = 0, b = 4, best = HUGE_VAL; i < 4; ++i) {
+                p = q;
+                while (isspace(*p)) ++p;
+                if (*p == '*') { // zero probability
+                    q = p + 1;
+                    continue;
+                }
+                e = strtod(p, &q);
+                if (q == p) break;
+                if (e < best) best = e, b = i;
+            }
+            kputc(b < 4? "ACGT"[b] : 'N', cons);
+        }
+    }
+
+    free(line);
+    fclose(fp);
+    return 0;
+}
+
+static annot_pf_t *annot_pf_build(char **nhmmdb, int n_db, char *ref)
+{
+    int d, fmt, ret;
+    kstring_t s = {0, 0, 0}, name = {0, 0, 0}, seq = {0, 0, 0};
+    annot_pf_t *pf;
+
+    MYCALLOC(pf, 1);
+    pf->h = kh_seed_init();
+    if (ref) {
+        gzFile fp = gzopen(ref, "r");
+        if (fp == 0) {
+            fprintf(stderr, "[E::%s] failed to open file %s to read\n", __func__, ref);
+            exit(EXIT_FAILURE);
+        }
+        kstream_t *ks = ks_init(fp);
+        fmt = 0;
+        while ((ret = annot_read_record(ks, &s, &fmt, &name, &seq)) >= 0) {
+            if (ret) {
+                fprintf(stderr, "[E::%s] failed to parse reference file %s (error code: %d)\n", __func__, ref, ret);
+                exit(EXIT_FAILURE);
+            }
+            annot_pf_add(pf, seq.s, seq.l);
+        }
+        ks_destroy(ks);
+        gzclose(fp);
+    } else {
+        for (d = 0; d < n_db; ++d) {
+            seq.l = 0;
+            if (annot_hmm_consensus(nhmmdb[d], &seq)) {
+                fprintf(stderr, "[E::%s] failed to open file %s to read\n", __func__, nhmmdb[d]);
+                exit(EXIT_FAILURE);
+            }
+            annot_pf_add(pf, seq.s, seq.l);
+        }
+    }
+    free(s.s);
+    free(name.s);
+    free(seq.s);
+
+    pf->occ = (double) kh_size(pf->h) / (1ULL << 32);
+    fprintf(stderr, "[M::%s] %u seeds collected from %s\n", __func__, kh_size(pf->h), ref? ref : "HMM consensus sequences");
+
+    return pf;
+}
+
+static void annot_pf_destroy(annot_pf_t *pf)
+{
+    if (!pf) return;
+    kh_seed_destroy(pf->h);
+    free(pf);
+}
+
+// return 1 if the sequence has fewer seed hits than min_hit in excess of the number expected by chance
+static int annot_pf_skip(annot_pf_t *pf, const char *seq, size_t l, int min_hit)
+{
+    size_t i;
+    int64_t x;
+    uint64_t n_hit;
+    uint8_t *s;
+
+    if (l < ANNOT_SEED_SPAN) return 1;
+    MYMALLOC(s, l);
+    for (i = 0; i < l; ++i)
+        s[i] = annot_nt4(seq[i]);
+    n_hit = 0;
+    for (i = 0; i + ANNOT_SEED_SPAN <= l; ++i)
+        if ((x = annot_seed(s, i)) >= 0 && kh_seed_get(pf->h, x) < kh_end(pf->h))
+            ++n_hit;
+    free(s);
+
+    return n_hit < min_hit + pf->occ * l;
+}
+
+/*****************************
+ * Batching and tblout rows *
+ *****************************/
+#define ANNOT_WIN_MIN 50000 // minimum window size for splitting long sequences
+#define ANNOT_WIN_OVL 10000 // window overlap; longer than any organelle gene
+
+static int annot_win_len_cmp(const void *a, const void *b)
+{
+    const annot_win_t *x = (const annot_win_t *) a, *y = (const annot_win_t *) b;
+    if (x->len != y->len) return x->len > y->len? -1 : 1;
+    if (x->rid != y->rid) return x->rid < y->rid? -1 : 1;
+    return (x->off > y->off) - (x->off < y->off);
+}
+
+static int annot_win_bid_cmp(const void *a, const void *b)
+{
+    const annot_win_t *x = (const annot_win_t *) a, *y = (const annot_win_t *) b;
+    if (x->bid != y->bid) return x->bid < y->bid? -1 : 1;
+    if (x->rid != y->rid) return x->rid < y->rid? -1 : 1;
+    return (x->off > y->off) - (x->off < y->off);
+}
+
+static FILE *annot_batch_open(annot_pipeline_t *p, annot_step_t *annot_s, int b);
+
+// split long sequences into overlapping windows and pack them into batches longest first
+// a query is named by <record index>:<window offset>:<window length>
+static void annot_step_pack(annot_pipeline_t *p, annot_step_t *annot_s, uint64_t l_seq)
+{
+    size_t i, n_win, m_win;
+    uint32_t j, w, n, step, n_batch, b;
+    uint64_t *load;
+    annot_rec_t *rec;
+    annot_win_t *win;
+    FILE *fo;
+
+    n_batch = p->max_batch_num;
+    w = (l_seq + n_batch - 1) / n_batch;
+    if (w < ANNOT_WIN_MIN) w = ANNOT_WIN_MIN;
+
+    n_win = m_win = 0;
+    win = 0;
+    for (i = 0; i < annot_s->rec.n; ++i) {
+        rec = &annot_s->rec.a[i];
+        if (rec->hit || rec->skip || rec->len == 0) continue;
+        n = rec->len <= w? 1 : (rec->len - ANNOT_WIN_OVL + (w - ANNOT_WIN_OVL) - 1) / (w - ANNOT_WIN_OVL);
+        step = n == 1? rec->len : (rec->len - ANNOT_WIN_OVL + n - 1) / n;
+        for (j = 0; j < n; ++j) {
+            if (n_win == m_win) {
+                m_win = m_win? m_win << 1 : 16;
+                MYREALLOC(win, m_win);
+            }
+            win[n_win].rid = i;
+            win[n_win].off = j * step;
+            win[n_win].len = n == 1? rec->len : MIN(step + ANNOT_WIN_OVL, rec->len - j * step);
+            ++n_win;
+        }
+        rec->n_win = n;
+    }
+
+    if (n_win < n_batch) n_batch = n_win;
+    annot_s->batch_num = n_batch;
+    if (n_win == 0) return;
+
+    // longest processing time first
+    qsort(win, n_win, sizeof(annot_win_t), annot_win_len_cmp);
+    MYCALLOC(load, n_batch);
+    for (i = 0; i < n_win; ++i) {
+        for (b = 0, j = 1; j < n_batch; ++j)
+            if (load[j] < load[b]) b = j;
+        win[i].bid = b;
+        load[b] += win[i].len;
+    }
+
+    qsort(win, n_win, sizeof(annot_win_t), annot_win_bid_cmp);
+    fo = 0;
+    for (i = 0; i < n_win; ++i) {
+        if (i == 0 || win[i].bid != win[i-1].bid) {
+            if (fo) fclose(fo);
+            fo = annot_batch_open(p, annot_s, win[i].bid);
+        }
+        rec = &annot_s->rec.a[win[i].rid];
+        fprintf(fo, ">%u:%u:%u\n", win[i].rid, win[i].off, win[i].len);
+        fwrite(rec->seq + win[i].off, 1, win[i].len, fo);
+        fputc('\n', fo);
+    }
+    if (fo) fclose(fo);
+
+    for (b = 1, j = 0; b < n_batch; ++b)
+        if (load[b] > load[j]) j = b;
+    fprintf(stderr, "[M::%s] %lu queries packed in %u batc%s (window size %u bp; largest batch %lu bp)\n",
+            __func__, n_win, n_batch, n_batch == 1? "h" : "hes", w, load[j]);
+
+    for (i = 0; i < annot_s->rec.n; ++i) {
+        free(annot_s->rec.a[i].seq);
+        annot_s->rec.a[i].seq = 0;
+    }
+    free(load);
+    free(win);
+}
+
+// locate the first 15 columns of a tblout row; the rest is the target description
+static inline int annot_tbl_split(char *row, char *end, char *b[15], char *e[15])
+{
+    int i;
+    char *c = row;
+    for (i = 0; i < 15; ++i) {
+        while (c < end && isspace(*c)) ++c;
+        b[i] = c;
+        while (c < end && !isspace(*c)) ++c;
+        e[i] = c;
+        if (e[i] == b[i]) return 1;
+    }
+    return 0;
+}
+
+// parse nhmmscan tblout rows of queries named by annot_step_pack()
+// rows are rewritten with sequence names, coordinates on the whole sequence and E-values scaled to the sequence length
+static void annot_hit_parse(annot_rec_v *recs, char *rows, size_t l, annot_hit_v *hits, kstring_t *buf)
+{
+    int i;
+    uint32_t rid, off, len, x, y;
+    char *row, *end, *eol, *q, *b[15], *e[15];
+    annot_rec_t *rec;
+    annot_hit_t *hit;
+
+    row = rows;
+    end = rows + l;
+    for (; row < end; row = eol) {
+        eol = memchr(row, '\n', end - row);
+        eol = eol? eol + 1 : end;
+        if (*row == '#' || annot_tbl_split(row, eol, b, e))
+            continue;
+        rid = strtoul(b[2], &q, 10);
+        if (*q != ':' || rid >= recs->n) continue;
+        off = strtoul(q + 1, &q, 10);
+        if (*q != ':') continue;
+        len = strtoul(q + 1, &q, 10);
+        if (q != e[2] || len == 0) continue;
+        rec = &recs->a[rid];
+
+        kv_pushp(annot_hit_t, *hits, &hit);
+        hit->rid = rid;
+        hit->off = off;
+        hit->strand = *b[11] == '-';
+        hit->del = 0;
+        hit->score = strtod(b[13], 0);
+        x = strtoul(b[8], 0, 10) + off;
+        y = strtoul(b[9], 0, 10) + off;
+        hit->st = MIN(x, y);
+        hit->en = MAX(x, y);
+        hit->o = buf->l;
+        hit->t_o = buf->l;
+        hit->t_l = e[0] - b[0];
+        for (i = 0; i < 15; ++i) {
+            if (i) kputc(' ', buf);
+            if (i == 2)
+                kputs(rec->name, buf);
+            else if (rec->n_win > 1 && i >= 6 && i <= 9)
+                kputuw(strtoul(b[i], 0, 10) + off, buf);
+            else if (rec->n_win > 1 && i == 12)
+                ksprintf(buf, "%.2g", strtod(b[i], 0) * rec->len / len);
+            else
+                kputsn(b[i], e[i] - b[i], buf);
+        }
+        kputsn(e[14], eol - e[14], buf);
+        if (buf->s[buf->l - 1] != '\n') kputc('\n', buf);
+        hit->l = buf->l - hit->o;
+    }
+}
+
+static int annot_hit_cmp(const void *a, const void *b)
+{
+    const annot_hit_t *x = (const annot_hit_t *) a, *y = (const annot_hit_t *) b;
+    if (x->rid != y->rid) return x->rid < y->rid? -1 : 1;
+    return (x->o > y->o) - (x->o < y->o);
+}
+
+// collect rows of each sequence; a hit found in two overlapping windows is kept once with the higher score
+static void annot_hit_collect(annot_rec_v *recs, int d, annot_hit_v *hits, kstring_t *buf)
+{
+    size_t i, j, k, s;
+    uint32_t ov;
+    annot_hit_t *x, *y;
+
+    qsort(hits->a, hits->n, sizeof(annot_hit_t), annot_hit_cmp);
+    for (s = 0, i = 1; i <= hits->n; ++i) {
+        if (i < hits->n && hits->a[i].rid == hits->a[s].rid)
+            continue;
+        if (recs->a[hits->a[s].rid].n_win > 1) {
+            for (j = s; j < i; ++j) {
+                x = &hits->a[j];
+                for (k = j + 1; k < i && !x->del; ++k) {
+                    y = &hits->a[k];
+                    if (y->del || y->off == x->off || y->strand != x->strand || y->t_l != x->t_l ||
+                            memcmp(buf->s + x->t_o, buf->s + y->t_o, x->t_l))
+                        continue;
+                    ov = MIN(x->en, y->en) + 1 > MAX(x->st, y->st)? MIN(x->en, y->en) + 1 - MAX(x->st, y->st) : 0;
+                    if (ov * 2 < MIN(x->en - x->st, y->en - y->st) + 1)
+                        continue;
+                    if (y->score > x->score) x->del = 1;
+                    else y->del = 1;
+                }
+            }
+        }
+        for (j = s; j < i; ++j)
+            if (!hits->a[j].del)
+                kputsn(buf->s + hits->a[j].o, hits->a[j].l, &recs->a[hits->a[j].rid].tbl[d]);
+        s = i;
+    }
+}
+
 static void annot_worker_for(void *_data, long i, int tid) // kt_for() callback
 {
     annot_step_t *annot_s = (annot_step_t *) _data;
-    int exit_code, wexit_st;
+    annot_pipeline_t *p = annot_s->shared;
+    int exit_code, b, d;
 
+    b = i / p->n_db;
+    d = i % p->n_db;
     char cmd[4096];
-    sprintf(cmd, "%s --noali --cpu 1 -o /dev/null --tblout %s %s %s", annot_s->shared->nhmmscan, annot_s->temp_out[i], annot_s->shared->nhmmdb, annot_s->temp_in[i]);
+    // the command words come first, e.g. a container wrapper or fixed options
+    char *argv[p->nhmm_argc + 13];
+    int n = p->nhmm_argc;
+    memcpy(argv, p->nhmm_argv, n * sizeof(char *));
+    if (p->stream) {
+        char *args[] = {"--noali", "--cpu", "1", "-o", "/dev/null", "--tblout", "/dev/stdout",
+            "--qformat", "fasta", p->nhmmdb[d], "-", 0};
+        memcpy(argv + n, args, sizeof(args));
+        sprintf(cmd, "%s --noali --cpu 1 -o /dev/null --tblout /dev/stdout --qformat fasta %s -", p->nhmmscan, p->nhmmdb[d]);
+        exit_code = run_spawn_cmd(argv, annot_s->seq_in[b], annot_s->l_seq_in[b], &annot_s->tbl_out[i], 0, 3);
+    } else {
+        char *args[] = {"--noali", "--cpu", "1", "-o", "/dev/null", "--tblout", annot_s->temp_out[i],
+            p->nhmmdb[d], annot_s->temp_in[b], 0};
+        memcpy(argv + n, args, sizeof(args));
+        sprintf(cmd, "%s --noali --cpu 1 -o /dev/null --tblout %s %s %s", p->nhmmscan, annot_s->temp_out[i], p->nhmmdb[d], annot_s->temp_in[b]);
+        exit_code = run_spawn_cmd(argv, 0, 0, 0, 0, 3);
+    }
 
-    exit_code = run_system_cmd(cmd, 3);
     if (exit_code == -1) {
         fprintf(stderr, "[E::%s] failed to execute command: %s\n", __func__, cmd);
         exit(EXIT_FAILURE);
     }
     
-    wexit_st = WEXITSTATUS(exit_code);
-    if (wexit_st) {
-        fprintf(stderr, "[E::%s] command with non-zero exit code: %d\n", __func__, wexit_st);
+    // a command killed by a signal leaves a truncated table behind
+    if (spawn_failed(exit_code)) {
+        if (WIFSIGNALED(exit_code))
+            fprintf(stderr, "[E::%s] command killed by signal %d: %s\n", __func__, WTERMSIG(exit_code), cmd);
+        else
+            fprintf(stderr, "[E::%s] command with non-zero exit code: %d\n", __func__, WEXITSTATUS(exit_code));
         exit(EXIT_FAILURE);
     }
 
     return;
 }
 
+// open the input of batch b: an in-memory buffer in stream mode or a temp FASTA file otherwise
+static FILE *annot_batch_open(annot_pipeline_t *p, annot_step_t *annot_s, int b)
+{
+    if (p->stream)
+        return open_memstream(&annot_s->seq_in[b], &annot_s->l_seq_in[b]);
+    // need the file names only and the file descriptors have already been closed
+    int d;
+    char file_template[strlen(p->tmpdir) + 32]; // <tmpdir>/tmpXXXXXXXXXX.out
+    annot_s->temp_in[b] = make_tempfile(p->tmpdir, file_template, ".fa");
+    for (d = 0; d < p->n_db; ++d)
+        annot_s->temp_out[b * p->n_db + d] = make_tempfile(p->tmpdir, file_template, ".out");
+    return fopen(annot_s->temp_in[b], "w");
+}
+
+static void annot_batch_clean(annot_pipeline_t *p, annot_step_t *annot_s, int b)
+{
+    int d, i;
+    if (p->stream) {
+        free(annot_s->seq_in[b]);
+        for (d = 0; d < p->n_db; ++d)
+            free(annot_s->tbl_out[b * p->n_db + d].s);
+    } else {
+        remove(annot_s->temp_in[b]);
+        free(annot_s->temp_in[b]);
+        for (d = 0; d < p->n_db; ++d) {
+            i = b * p->n_db + d;
+            remove(annot_s->temp_out[i]);
+            free(annot_s->temp_out[i]);
+        }
+    }
+}
+
+static void annot_step_destroy(annot_step_t *annot_s)
+{
+    size_t i;
+    int d;
+    for (i = 0; i < annot_s->rec.n; ++i) {
+        free(annot_s->rec.a[i].name);
+        free(annot_s->rec.a[i].seq);
+        for (d = 0; d < annot_s->shared->n_db; ++d)
+            free(annot_s->rec.a[i].tbl[d].s);
+        free(annot_s->rec.a[i].tbl);
+    }
+    free(annot_s->rec.a);
+    free(annot_s->temp_in);
+    free(annot_s->temp_out);
+    free(annot_s->seq_in);
+    free(annot_s->l_seq_in);
+    free(annot_s->tbl_out);
+    free(annot_s);
+}
+
 static void *annot_worker_pipeline(void *shared, int step, void *in)
 {
     annot_pipeline_t *p = (annot_pipeline_t *) shared;
     if (step == 0) { // read sequence data into bacthes        
         annot_step_t *annot_s;
         MYCALLOC(annot_s, 1);
-        MYMALLOC(annot_s->temp_in, p->max_batch_num);
-        MYMALLOC(annot_s->temp_out, p->max_batch_num);
-
-        kstream_t *ks = p->ks;
-        kstring_t *s = p->s;
-        int dret, ret, is_fa, is_fq, is_gfa;
-        uint32_t batch_size, batch_num, n_seq, l_seq;
-        FILE *fo;
-        char file_template[strlen(p->tmpdir) + 16];
-
-        is_fa = is_fq = is_gfa = 0;
-        batch_size = batch_num = 0;
-        fo = 0;
-        n_seq = l_seq = 0;
-
-        // need the file names only and the file descriptors have already been closed
-        annot_s->temp_in[batch_num]  = make_tempfile(p->tmpdir, file_template, ".fa");
-        annot_s->temp_out[batch_num] = make_tempfile(p->tmpdir, file_template, ".out");
-        
-        fo = fopen(annot_s->temp_in[batch_num], "w");
-        ++batch_num;
-
-        while (s->l || ks_getuntil(ks, KS_SEP_LINE, s, &dret) >= 0) {
-            if (s->l == 0) // empty line
-                continue;
-            
-            if (batch_size >= p->max_batch_size && (is_gfa || (is_fa && s->s[0] == '>') || (is_fq && s->s[0] == '@'))) {
-                fclose(fo);
-                fo = 0;
-                l_seq += batch_size;
-
-                if (batch_num >= p->max_batch_num) {
-                    break;
-                } else {
-                    // make a new batch
-                    // need the file names only and the file descriptors have already been closed
-                    annot_s->temp_in[batch_num]  = make_tempfile(p->tmpdir, file_template, ".fa");
-                    annot_s->temp_out[batch_num] = make_tempfile(p->tmpdir, file_template, ".out");
-                    fo = fopen(annot_s->temp_in[batch_num], "w");
-                    ++batch_num;
-                    batch_size = 0;
-                }
-            }
-
-            ret = 0; 
-            if (!is_gfa && s->s[0] == '>') { // FASTA header
-                is_fa = 1;
-                // parse header
-                ret = parse_fheader(s->s);
-                if (!ret)
-                    fprintf(fo, "%s\n", s->s);
-                ++n_seq;
-            } else if (!is_gfa && s->s[0] == '@') { // FASTQ header
-                is_fq = 1;
-                // parse and write header
-                ret = parse_fheader(s->s);
-                if (!ret)
-                    fprintf(fo, ">%s\n", s->s + 1);
-                // parse sequence
-                if(ks_getuntil(ks, KS_SEP_LINE, s, &dret) < 0)
-                    ret = 2;
-                if (!ret) {
-                    fprintf(fo, "%s\n", s->s);
-                    batch_size += s->l;
-                }
+        annot_s->shared = p;
+        if (p->stream) {
+            MYCALLOC(annot_s->seq_in, p->max_batch_num);
+            MYCALLOC(annot_s->l_seq_in, p->max_batch_num);
+            MYCALLOC(annot_s->tbl_out, p->max_batch_num * p->n_db);
+        } else {
+            MYMALLOC(annot_s->temp_in, p->max_batch_num);
+            MYMALLOC(annot_s->temp_out, p->max_batch_num * p->n_db);
+        }
 
-                // skip quality score lines
-                if (ks_getuntil(ks, KS_SEP_LINE, s, &dret) < 0 ||
-                        ks_getuntil(ks, KS_SEP_LINE, s, &dret) < 0)
-                    ret = 3;
-                ++n_seq;
-            } else if (is_fa) { // FASTA sequence line
-                fprintf(fo, "%s\n", s->s);
-                batch_size += s->l;
-            } else {
-                is_gfa = 1;
-                if (s->s[0] == 'S') {
-                    char *seg, *seq;
-                    ret = parse_gseq(s->s, &seg, &seq);
-                    if (!ret) {
-                        fprintf(fo, ">%s\n", seg);
-                        fprintf(fo, "%s\n", seq);
-                        batch_size += strlen(seq);
-                    }
-                    ++n_seq;
-                }
-            }
+        int d, ret;
+        uint32_t n_seq, n_hit, n_skip;
+        uint64_t l_seq, l_skip;
+        kstring_t name = {0, 0, 0}, seq = {0, 0, 0}, path = {0, 0, 0};
+        annot_rec_t *rec;
 
+        n_seq = n_hit = n_skip = 0;
+        l_seq = l_skip = 0;
+        // load all sequences of the step to balance the batches
+        while (l_seq < (uint64_t) p->max_batch_size * p->max_batch_num) {
+            ret = annot_read_record(p->ks, p->s, &p->fmt, &name, &seq);
+            if (ret < 0) break;
             if (ret) {
-                fprintf(stderr, "[E::%s] failed to parse %s file (error code: %d)\n", __func__, is_fa? "FASTA" : (is_fq? "FASTQ" : "GFA"), ret);
+                fprintf(stderr, "[E::%s] failed to parse %s file (error code: %d)\n", __func__,
+                        p->fmt == 1? "FASTA" : (p->fmt == 2? "FASTQ" : "GFA"), ret);
                 exit(EXIT_FAILURE);
             }
+            ++n_seq;
 
-            s->l = 0;
-        }
-
-        if (fo) {
-            fclose(fo);
-            l_seq += batch_size;
-            if (batch_size == 0) {
-                --batch_num;
-                remove(annot_s->temp_in[batch_num]);
-                remove(annot_s->temp_out[batch_num]);
-                free(annot_s->temp_in[batch_num]);
-                free(annot_s->temp_out[batch_num]);
+            kv_pushp(annot_rec_t, annot_s->rec, &rec);
+            MYBZERO(rec, 1);
+            MYCALLOC(rec->tbl, p->n_db);
+            rec->name = strdup(name.s);
+            rec->len = seq.l;
+            if (p->cache_dir) {
+                // a sequence missing for any database is annotated again against all
+                annot_seq_hash(seq.s, seq.l, rec->h);
+                for (d = 0; d < p->n_db; ++d)
+                    if (!annot_cache_get(p, d, rec->h, &rec->tbl[d], &path))
+                        break;
+                rec->hit = d == p->n_db;
+                if (rec->hit) {
+                    ++n_hit;
+                    continue;
+                }
+                // the new rows must not be appended to those found for the first databases
+                for (d = 0; d < p->n_db; ++d) rec->tbl[d].l = 0;
+            }
+            if (p->pf && annot_pf_skip((annot_pf_t *) p->pf, seq.s, seq.l, p->pf_min)) {
+                // reported as unannotated
+                rec->skip = 1;
+                ++n_skip;
+                l_skip += seq.l;
+                continue;
             }
+            rec->seq = seq.s;
+            seq.s = 0, seq.l = seq.m = 0;
+            l_seq += rec->len;
         }
 
-        assert(is_fa + is_fq + is_gfa <= 1);
+        free(name.s);
+        free(seq.s);
+        free(path.s);
 
-        if (batch_num == 0) {
-            free(annot_s->temp_in);
-            free(annot_s->temp_out);
-            free(annot_s);
+        if (n_seq == 0) {
+            annot_step_destroy(annot_s);
         } else {
-            annot_s->batch_num = batch_num;
-            annot_s->shared = p;
-            fprintf(stderr, "[M::%s] %u sequences (%u bp) loaded in %u batc%s\n", __func__, n_seq, l_seq, batch_num, batch_num > 1? "hes" : "h");
+            fprintf(stderr, "[M::%s] %u sequences (%lu bp) loaded\n", __func__, n_seq - n_hit - n_skip, l_seq);
+            if (p->cache_dir)
+                fprintf(stderr, "[M::%s] %u of %u sequences found in the annotation cache\n", __func__, n_hit, n_seq);
+            if (p->pf)
+                fprintf(stderr, "[M::%s] %u of %u sequences (%lu of %lu bp) skipped by the k-mer prefilter\n", __func__,
+                        n_skip, n_seq - n_hit, l_skip, l_seq + l_skip);
+            annot_step_pack(p, annot_s, l_seq);
             return annot_s;
         }
-    } else if (step == 1) { // do nhmmscan annotation
-        kt_for(p->n_threads, annot_worker_for, in, ((annot_step_t*)in)->batch_num);
+    } else if (step == 1) { // do nhmmscan annotation of all (batch, database) jobs
+        kt_ctx_for(p->kc, annot_worker_for, in, ((annot_step_t*)in)->batch_num * p->n_db);
         return in;
     } else if (step == 2) { // parse nhmmscan output
         annot_step_t *annot_s = (annot_step_t *) in;
-        int i;
+        int b, d, i;
+        size_t j, n;
         FILE *fp;
-        char c;
+        char buf[65536];
+        kstring_t tbl = {0, 0, 0}, rows = {0, 0, 0}, path = {0, 0, 0};
+        annot_hit_v hits = {0, 0, 0};
+        annot_rec_t *rec;
 
-        for (i = 0; i < annot_s->batch_num; ++i) {
-            fp = fopen(annot_s->temp_out[i], "r");
-            while ((c = fgetc(fp)) != EOF)
-                fputc(c, p->fo);
-            fclose(fp);
+        for (d = 0; d < p->n_db; ++d) {
+            hits.n = rows.l = 0;
+            for (b = 0; b < annot_s->batch_num; ++b) {
+                i = b * p->n_db + d;
+                if (p->stream) {
+                    annot_hit_parse(&annot_s->rec, annot_s->tbl_out[i].s, annot_s->tbl_out[i].l, &hits, &rows);
+                } else {
+                    fp = fopen(annot_s->temp_out[i], "r");
+                    tbl.l = 0;
+                    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+                        kputsn(buf, n, &tbl);
+                    fclose(fp);
+                    annot_hit_parse(&annot_s->rec, tbl.s, tbl.l, &hits, &rows);
+                }
+            }
+            annot_hit_collect(&annot_s->rec, d, &hits, &rows);
 
-            remove(annot_s->temp_in[i]);
-            remove(annot_s->temp_out[i]);
-            free(annot_s->temp_in[i]);
-            free(annot_s->temp_out[i]);
+            for (j = 0; j < annot_s->rec.n; ++j) {
+                rec = &annot_s->rec.a[j];
+                if (rec->hit) {
+                    annot_tbl_rename(&rec->tbl[d], rec->name, p->fo[d]);
+                } else {
+                    if (rec->tbl[d].l) fwrite(rec->tbl[d].s, 1, rec->tbl[d].l, p->fo[d]);
+                    // a sequence skipped by the prefilter was never annotated
+                    if (p->cache_dir && !rec->skip) annot_cache_put(p, d, rec->h, &rec->tbl[d], &path);
+                }
+            }
         }
-        free(annot_s->temp_in);
-        free(annot_s->temp_out);
-        free(annot_s);
+        for (b = 0; b < annot_s->batch_num; ++b)
+            annot_batch_clean(p, annot_s, b);
+
+        free(tbl.s);
+        free(rows.s);
+        free(path.s);
+        free(hits.a);
+        annot_step_destroy(annot_s);
     }
 
     return 0;
 }
 
-int hmm_annotate(char **file_in, int n_file, char *nhmmscan, char *nhmmdb, FILE *fo, uint32_t max_batch_size, uint32_t max_batch_num, int n_threads, char *tmpdir)
+// annotate the sequences against n_db HMM databases; the results of nhmmdb[i] go to fo[i]
+// SIGPIPE is ignored while any annotation streams to nhmmscan
+// the jobs of a batch may overlap, so the old handler is put back by the last one
+static pthread_mutex_t sigpipe_lock = PTHREAD_MUTEX_INITIALIZER;
+static int sigpipe_n = 0;
+static void (*sigpipe_old)(int);
+
+static void annot_sigpipe_ignore(void)
 {
+    pthread_mutex_lock(&sigpipe_lock);
+    if (sigpipe_n++ == 0)
+        sigpipe_old = signal(SIGPIPE, SIG_IGN);
+    pthread_mutex_unlock(&sigpipe_lock);
+}
+
+static void annot_sigpipe_restore(void)
+{
+    pthread_mutex_lock(&sigpipe_lock);
+    if (--sigpipe_n == 0 && sigpipe_old != SIG_ERR)
+        signal(SIGPIPE, sigpipe_old);
+    pthread_mutex_unlock(&sigpipe_lock);
+}
+
+int hmm_annotate(char **file_in, int n_file, char *nhmmscan, char **nhmmdb, FILE **fo, int n_db, uint32_t max_batch_size, uint32_t max_batch_num, const kt_ctx_t *kc, char *tmpdir, int stream, char *cache_dir, char *pf_ref, int pf_min)
+{
+    int n_threads = kc? kc->n_threads : 1;
     annot_pipeline_t pl;
     MYBZERO(&pl, 1);
 
+    if (n_db <= 0) return 0;
+
     pl.max_batch_size = max_batch_size;
     pl.max_batch_num = max_batch_num;
     pl.nhmmscan = nhmmscan? nhmmscan : "nhmmscan";
+    pl.nhmm_argc = split_cmd(pl.nhmmscan, &pl.nhmm_argv);
+    if (pl.nhmm_argc <= 0) {
+        fprintf(stderr, "[E::%s] invalid nhmmscan command: %s\n", __func__, pl.nhmmscan);
+        return 1;
+    }
     pl.nhmmdb = nhmmdb;
+    pl.n_db = n_db;
     pl.fo = fo;
-    pl.n_threads = n_threads;
+    pl.kc = kc;
+    pl.stream = stream;
+    // a failed nhmmscan closes its end of the pipe
+    if (stream) annot_sigpipe_ignore();
+    pl.cache_dir = cache_dir;
+    if (pf_min > 0) {
+        pl.pf = annot_pf_build(nhmmdb, n_db, pf_ref);
+        pl.pf_min = pf_min;
+    }
+    if (cache_dir) {
+        int d;
+        MYCALLOC(pl.db_sum, n_db * 2);
+        for (d = 0; d < n_db; ++d) {
+            if (annot_cache_init(&pl, d)) {
+                fprintf(stderr, "[W::%s] annotation cache disabled\n", __func__);
+                pl.cache_dir = 0;
+                break;
+            }
+        }
+    }
 
     int rm_tmpdir = 0;
+    char tmp_template[] = "tmp_XXXXXXXXXX"; // holds the name of the created temp dir
     if (tmpdir) {
         struct stat st = {0};
         if (stat(tmpdir, &st) == -1) {
@@ -302,8 +1068,7 @@ int hmm_annotate(char **file_in, int n_file, char *nhmmscan, char *nhmmdb, FILE
         }
         pl.tmpdir = tmpdir;
     } else {
-        char file_template[] = "tmp_XXXXXXXXXX";
-        pl.tmpdir = mkdtemp(file_template); // no need to free
+        pl.tmpdir = mkdtemp(tmp_template); // no need to free
         rm_tmpdir = 1;
     }
 
@@ -318,6 +1083,7 @@ int hmm_annotate(char **file_in, int n_file, char *nhmmscan, char *nhmmdb, FILE
         }
         ks = ks_init(fp);
         pl.ks = ks;
+        pl.fmt = 0;
         MYCALLOC(pl.s, 1);
         kt_pipeline(n_threads, annot_worker_pipeline, &pl, 3);
         ks_destroy(ks);
@@ -327,6 +1093,11 @@ int hmm_annotate(char **file_in, int n_file, char *nhmmscan, char *nhmmdb, FILE
     }
 
     if (rm_tmpdir) rmdir(pl.tmpdir); // should be empty
+    if (stream) annot_sigpipe_restore();
+    free(pl.db_sum);
+    annot_pf_destroy((annot_pf_t *) pl.pf);
+    free(pl.nhmm_argv[0]);
+    free(pl.nhmm_argv);
 
     return 0;
 }
@@ -338,6 +1109,10 @@ int VERBOSE = 0;
 
 static ko_longopt_t long_options[] = {
     { "nhmmscan", ko_required_argument, 301 },
+    { "stream",   ko_no_argument,       302 },
+    { "cache",    ko_required_argument, 303 },
+    { "prefilter-min", ko_required_argument, 304 },
+    { "prefilter-ref", ko_required_argument, 305 },
     { "threads",  ko_required_argument, 't' },
     { "verbose",  ko_required_argument, 'v' },
     { "version",  ko_no_argument,       'V' },
@@ -350,20 +1125,22 @@ int main(int argc, char *argv[])
     const char *opt_str = "t:b:T:o:Vv:h";
     ketopt_t opt = KETOPT_INIT;
     int c, ret = 0;
-    int n_threads, batch_size, n_file;
+    int n_threads, batch_size, n_file, stream, pf_min;
     FILE *fp_help, *out_fp;
-    char *out, *nhmmdb, *tmpdir;
+    char *out, *nhmmdb, *tmpdir, *cache_dir, *pf_ref;
     char **file_in;
 
     sys_init();
     
     fp_help = stderr;
     out_fp = stdout;
-    out = nhmmdb = tmpdir = 0;
+    out = nhmmdb = tmpdir = cache_dir = pf_ref = 0;
     file_in = 0;
     n_file = 0;
     batch_size = 1000000;
     n_threads = 4;
+    stream = 0;
+    pf_min = 0;
     char *nhmmscan = "nhmmscan";
 
     while ((c = ketopt(&opt, argc, argv, 1, opt_str, long_options)) >=0 ) {
@@ -371,6 +1148,10 @@ int main(int argc, char *argv[])
         else if (c == 'b') batch_size = atoi(opt.arg);
         else if (c == 'T') tmpdir = opt.arg;
         else if (c == 301) nhmmscan = opt.arg;
+        else if (c == 302) stream = 1;
+        else if (c == 303) cache_dir = opt.arg;
+        else if (c == 304) pf_min = atoi(opt.arg);
+        else if (c == 305) pf_ref = opt.arg;
         else if (c == 'v') VERBOSE = atoi(opt.arg);
         else if (c == 'h') fp_help = stdout;
         else if (c == 'o') {
@@ -400,7 +1181,13 @@ int main(int argc, char *argv[])
         fprintf(fp_help, "    -t INT           number threads [4]\n");
         fprintf(fp_help, "    -T STR           temporary directory [NULL]\n");
         fprintf(fp_help, "    -o FILE          output results to FILE [stdout]\n");
-        fprintf(fp_help, "    --nhmmscan STR   nhmmscan executable path [%s]\n", nhmmscan);
+        fprintf(fp_help, "    --nhmmscan STR   nhmmscan command, may start with a wrapper [%s]\n", nhmmscan);
+        fprintf(fp_help, "    --stream         pipe sequences and results through nhmmscan instead of temp files\n");
+        fprintf(fp_help, "    --cache DIR      reuse annotations of unchanged sequences cached in DIR [NULL]\n");
+        fprintf(fp_help, "    --prefilter-min INT\n");
+        fprintf(fp_help, "                     skip nhmmscan for sequences with < INT seed hits to the HMM consensus; 0 to disable [%d]\n", pf_min);
+        fprintf(fp_help, "    --prefilter-ref FILE\n");
+        fprintf(fp_help, "                     build the prefilter seeds from the sequences in FILE instead [NULL]\n");
         fprintf(fp_help, "    -v INT           verbose level [%d]\n", VERBOSE);
         fprintf(fp_help, "    --version        show version number\n");
         fprintf(fp_help, "\n");
@@ -432,7 +1219,13 @@ int main(int argc, char *argv[])
 
     if (out) out_fp = fopen(out, "w");
 
-    ret = hmm_annotate(file_in, n_file, nhmmscan, nhmmdb, out_fp, batch_size, n_threads * 5, n_threads, tmpdir);
+    // one thread pool for the whole run, handed down to every parallel stage
+    kt_ctx_t kc;
+    kt_ctx_init(&kc, n_threads);
+
+    ret = hmm_annotate(file_in, n_file, nhmmscan, &nhmmdb, &out_fp, 1, batch_size, n_threads * 5, &kc, tmpdir, stream, cache_dir, pf_ref, pf_min);
+
+    kt_ctx_destroy(&kc);
 
     if (out) fclose(out_fp);
 
@@ -38,6 +38,9 @@ static void panic(const char *s)
 void *km_init2(void *km_par, size_t min_core_size)
 {
 	kmem_t *km;
+#ifdef NO_KALLOC
+	if (km_par == 0) return 0; /* build-time switch: all k*alloc() calls fall back to libc */
+#endif
 	km = (kmem_t*)kcalloc(km_par, 1, sizeof(kmem_t));
 	km->par = km_par;
 	if (km_par) km->min_core_size = min_core_size > 0? min_core_size : ((kmem_t*)km_par)->min_core_size - 2;
@@ -62,6 +65,20 @@ void km_destroy(void *_km)
 	kfree(km_par, km);
 }
 
+void *km_trim(void *_km, size_t max_capacity) /* NB: every block in the arena must have been freed */
+{
+	kmem_t *km = (kmem_t*)_km;
+	km_stat_t st;
+	void *km_par;
+	size_t min_core_size;
+	if (km == NULL) return 0;
+	km_stat(km, &st);
+	if (st.capacity <= max_capacity) return km;
+	km_par = km->par, min_core_size = km->min_core_size;
+	km_destroy(km);
+	return km_init2(km_par, min_core_size);
+}
+
 static header_t *morecore(kmem_t *km, size_t nu)
 {
 	header_t *q;
@@ -20,6 +20,7 @@ void kfree(void *km, void *ptr);
 void *km_init(void);
 void *km_init2(void *km_par, size_t min_core_size);
 void km_destroy(void *km);
+void *km_trim(void *km, size_t max_capacity);
 void km_stat(const void *_km, km_stat_t *s);
 void km_stat_print(const void *km);
 
@@ -1,6 +1,7 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <limits.h>
+#include "kthread.h"
 
 /************
  * kt_for() *
@@ -85,8 +86,11 @@ typedef struct kt_forpool_t {
 	void *data;
 	pthread_mutex_t mutex;
 	pthread_cond_t cv_m, cv_s;
+	pthread_mutex_t mutex_c; // callers from different threads take turns
 } kt_forpool_t;
 
+static __thread int kt_fp_in_worker; // nested calls from a pool worker must not wait for the pool
+
 static inline long kt_fp_steal_work(kt_forpool_t *t)
 {
 	int i, min_i = -1;
@@ -97,12 +101,25 @@ static inline long kt_fp_steal_work(kt_forpool_t *t)
 	return k >= t->n? -1 : k;
 }
 
+static void kt_fp_work(kto_worker_t *w)
+{
+	kt_forpool_t *fp = w->t;
+	long i;
+	for (;;) { // process jobs allocated to this worker
+		i = __sync_fetch_and_add(&w->i, fp->n_threads);
+		if (i >= fp->n) break;
+		fp->func(fp->data, i, w - fp->w);
+	}
+	while ((i = kt_fp_steal_work(fp)) >= 0) // steal jobs allocated to other workers
+		fp->func(fp->data, i, w - fp->w);
+}
+
 static void *kt_fp_worker(void *data)
 {
 	kto_worker_t *w = (kto_worker_t*)data;
 	kt_forpool_t *fp = w->t;
+	kt_fp_in_worker = 1;
 	for (;;) {
-		long i;
 		int action;
 		pthread_mutex_lock(&fp->mutex);
 		if (--fp->n_pending == 0)
@@ -112,13 +129,7 @@ static void *kt_fp_worker(void *data)
 		action = w->action;
 		pthread_mutex_unlock(&fp->mutex);
 		if (action < 0) break;
-		for (;;) { // process jobs allocated to this worker
-			i = __sync_fetch_and_add(&w->i, fp->n_threads);
-			if (i >= fp->n) break;
-			fp->func(fp->data, i, w - fp->w);
-		}
-		while ((i = kt_fp_steal_work(fp)) >= 0) // steal jobs allocated to other workers
-			fp->func(fp->data, i, w - fp->w);
+		kt_fp_work(w);
 	}
 	pthread_exit(0);
 }
@@ -128,14 +139,15 @@ void *kt_forpool_init(int n_threads)
 	kt_forpool_t *fp;
 	int i;
 	fp = (kt_forpool_t*)calloc(1, sizeof(kt_forpool_t));
-	fp->n_threads = fp->n_pending = n_threads;
+	fp->n_threads = n_threads, fp->n_pending = n_threads - 1; // the caller of kt_forpool() is worker 0
 	fp->tid = (pthread_t*)calloc(fp->n_threads, sizeof(pthread_t));
 	fp->w = (kto_worker_t*)calloc(fp->n_threads, sizeof(kto_worker_t));
 	for (i = 0; i < fp->n_threads; ++i) fp->w[i].t = fp;
 	pthread_mutex_init(&fp->mutex, 0);
+	pthread_mutex_init(&fp->mutex_c, 0);
 	pthread_cond_init(&fp->cv_m, 0);
 	pthread_cond_init(&fp->cv_s, 0);
-	for (i = 0; i < fp->n_threads; ++i) pthread_create(&fp->tid[i], 0, kt_fp_worker, &fp->w[i]);
+	for (i = 1; i < fp->n_threads; ++i) pthread_create(&fp->tid[i], 0, kt_fp_worker, &fp->w[i]);
 	pthread_mutex_lock(&fp->mutex);
 	while (fp->n_pending) pthread_cond_wait(&fp->cv_m, &fp->mutex);
 	pthread_mutex_unlock(&fp->mutex);
@@ -146,12 +158,15 @@ void kt_forpool_destroy(void *_fp)
 {
 	kt_forpool_t *fp = (kt_forpool_t*)_fp;
 	int i;
-	for (i = 0; i < fp->n_threads; ++i) fp->w[i].action = -1;
+	pthread_mutex_lock(&fp->mutex);
+	for (i = 1; i < fp->n_threads; ++i) fp->w[i].action = -1;
 	pthread_cond_broadcast(&fp->cv_s);
-	for (i = 0; i < fp->n_threads; ++i) pthread_join(fp->tid[i], 0);
+	pthread_mutex_unlock(&fp->mutex);
+	for (i = 1; i < fp->n_threads; ++i) pthread_join(fp->tid[i], 0);
 	pthread_cond_destroy(&fp->cv_s);
 	pthread_cond_destroy(&fp->cv_m);
 	pthread_mutex_destroy(&fp->mutex);
+	pthread_mutex_destroy(&fp->mutex_c);
 	free(fp->w); free(fp->tid); free(fp);
 }
 
@@ -160,15 +175,45 @@ void kt_forpool(void *_fp, void (*func)(void*,long,int), void *data, long n)
 	kt_forpool_t *fp = (kt_forpool_t*)_fp;
 	long i;
 	if (fp && fp->n_threads > 1) {
-		fp->n = n, fp->func = func, fp->data = data, fp->n_pending = fp->n_threads;
+		int in_worker = kt_fp_in_worker;
+		pthread_mutex_lock(&fp->mutex_c);
+		fp->n = n, fp->func = func, fp->data = data, fp->n_pending = fp->n_threads - 1;
 		for (i = 0; i < fp->n_threads; ++i) fp->w[i].i = i, fp->w[i].action = 1;
 		pthread_mutex_lock(&fp->mutex);
 		pthread_cond_broadcast(&fp->cv_s);
+		pthread_mutex_unlock(&fp->mutex);
+		kt_fp_in_worker = 1; // as in kt_for(), the caller does its share of the work
+		kt_fp_work(&fp->w[0]);
+		kt_fp_in_worker = in_worker;
+		pthread_mutex_lock(&fp->mutex);
 		while (fp->n_pending) pthread_cond_wait(&fp->cv_m, &fp->mutex);
 		pthread_mutex_unlock(&fp->mutex);
+		pthread_mutex_unlock(&fp->mutex_c);
 	} else for (i = 0; i < n; ++i) func(data, i, 0);
 }
 
+/* A run creates one context and hands it down to every parallel stage, which
+ * then shares the context's pool instead of starting threads for each loop.
+ * Calls from different threads share the pool one at a time. */
+void kt_ctx_init(kt_ctx_t *kc, int n_threads)
+{
+	kc->n_threads = n_threads > 1? n_threads : 1;
+	kc->pool = kc->n_threads > 1? kt_forpool_init(kc->n_threads) : 0;
+}
+
+void kt_ctx_destroy(kt_ctx_t *kc)
+{
+	if (kc->pool) kt_forpool_destroy(kc->pool);
+	kc->pool = 0;
+}
+
+void kt_ctx_for(const kt_ctx_t *kc, void (*func)(void*,long,int), void *data, long n)
+{
+	if (kc == 0) kt_for(1, func, data, n);
+	else if (kc->pool && !kt_fp_in_worker) kt_forpool(kc->pool, func, data, n);
+	else kt_for(kc->n_threads, func, data, n); // a nested call must not wait for the pool it runs on
+}
+
 /*****************
  * kt_pipeline() *
  *****************/
@@ -12,6 +12,16 @@ void *kt_forpool_init(int n_threads);
 void kt_forpool_destroy(void *_fp);
 void kt_forpool(void *_fp, void (*func)(void*,long,int), void *data, long n);
 
+// threads of a run: NULL stands for a single thread
+typedef struct {
+	int n_threads;
+	void *pool; // persistent kt_forpool; NULL with one thread
+} kt_ctx_t;
+
+void kt_ctx_init(kt_ctx_t *kc, int n_threads);
+void kt_ctx_destroy(kt_ctx_t *kc);
+void kt_ctx_for(const kt_ctx_t *kc, void (*func)(void*,long,int), void *data, long n);
+
 #ifdef __cplusplus
 }
 #endif
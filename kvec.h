@@ -49,6 +49,9 @@ int main() {
 #define AC_KVEC_H
 
 #include <stdlib.h>
+#include <string.h>
+
+#include "kalloc.h"
 
 #define kv_roundup32(x) (--(x), (x)|=(x)>>1, (x)|=(x)>>2, (x)|=(x)>>4, (x)|=(x)>>8, (x)|=(x)>>16, ++(x))
 
@@ -118,4 +121,42 @@ int main() {
 		} \
 	} while (0)
 
+/* variants allocating from a kalloc arena; km == NULL falls back to libc */
+#define kv_destroy_km(km, v) kfree((km), (v).a)
+
+#define kv_resize_km(type, km, v, s) do { \
+		if ((v).m < (s)) { \
+			(v).m = (s); \
+			kv_roundup32((v).m); \
+			(v).a = (type*)krealloc((km), (v).a, sizeof(type) * (v).m); \
+		} \
+	} while (0)
+
+#define kv_push_km(type, km, v, x) do { \
+		if ((v).n == (v).m) { \
+			(v).m = (v).m? (v).m<<1 : 2; \
+			(v).a = (type*)krealloc((km), (v).a, sizeof(type) * (v).m); \
+		} \
+		(v).a[(v).n++] = (x); \
+	} while (0)
+
+#define kv_pushp_km(type, km, v, p) do { \
+		if ((v).n == (v).m) { \
+			(v).m = (v).m? (v).m<<1 : 2; \
+			(v).a = (type*)krealloc((km), (v).a, sizeof(type) * (v).m); \
+		} \
+		*(p) = &(v).a[(v).n++]; \
+	} while (0)
+
+#define kv_pushn_km(type, km, v, x, l) do { \
+		if ((v).n + (l) > (v).m) { \
+			(v).m = (v).n + (l); \
+			(v).m = (v).m? (v).m : 1; \
+			kv_roundup32((v).m); \
+			(v).a = (type*)krealloc((km), (v).a, sizeof(type) * (v).m); \
+		} \
+		memcpy((v).a + (v).n, (x), sizeof(type) * (l)); \
+		(v).n += (l); \
+	} while (0)
+
 #endif
@@ -27,12 +27,19 @@
  * 11/08/22 - Chenxi Zhou: Created                                               *
  *                                                                               *
  *********************************************************************************/
+#define _GNU_SOURCE // pipe2()
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "misc.h"
 
@@ -204,22 +211,187 @@ char *make_tempfile(char *temp_dir, char *file_template, const char *suffix)
     return 0;
 }
 
-int run_system_cmd(char *cmd, int retry)
+/*************************
+ * External command spawn *
+ *************************/
+
+// commands are started with posix_spawn() rather than system()
+// glibc implements it with vfork semantics so the page tables of a large
+// parent process are not copied for every launch
+
+extern char **environ;
+
+// run argv[0] searched in PATH
+// if in is not NULL, l_in bytes of in are fed to its stdin
+// if out is not NULL, its stdout is appended to out
+// SPAWN_NULL_OUT sends stdout and stderr to /dev/null
+// returns the wait status as system() does or -1 if the command could not be run
+int spawn_cmd(char *const argv[], const char *in, size_t l_in, kstring_t *out, int flags)
+{
+    int fd_in[2], fd_out[2], status;
+    size_t off;
+    ssize_t r;
+    pid_t pid;
+    struct pollfd pfd[2];
+    posix_spawn_file_actions_t fa;
+
+    // close-on-exec so the pipes do not leak into commands spawned by other threads
+    fd_in[0] = fd_in[1] = fd_out[0] = fd_out[1] = -1;
+    if ((in && pipe2(fd_in, O_CLOEXEC) < 0) || (out && pipe2(fd_out, O_CLOEXEC) < 0)) {
+        if (fd_in[0] >= 0) {
+            close(fd_in[0]);
+            close(fd_in[1]);
+        }
+        return -1;
+    }
+    posix_spawn_file_actions_init(&fa);
+    if (in)
+        posix_spawn_file_actions_adddup2(&fa, fd_in[0], STDIN_FILENO);
+    if (out)
+        posix_spawn_file_actions_adddup2(&fa, fd_out[1], STDOUT_FILENO);
+    else if (flags & SPAWN_NULL_OUT)
+        posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    if (flags & SPAWN_NULL_OUT)
+        posix_spawn_file_actions_addopen(&fa, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    status = posix_spawnp(&pid, argv[0], &fa, 0, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    if (in) close(fd_in[0]);
+    if (out) close(fd_out[1]);
+    if (status != 0) {
+        if (in) close(fd_in[1]);
+        if (out) close(fd_out[0]);
+        return -1;
+    }
+
+    // feed stdin and drain stdout at the same time so neither side blocks
+    pfd[0].fd = out? fd_out[0] : -1;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = in? fd_in[1] : -1;
+    pfd[1].events = POLLOUT;
+    off = 0;
+    if (in) {
+        fcntl(fd_in[1], F_SETFL, O_NONBLOCK);
+        if (l_in == 0) {
+            close(fd_in[1]);
+            pfd[1].fd = -1;
+        }
+    }
+    while (pfd[0].fd >= 0 || pfd[1].fd >= 0) {
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfd[0].fd >= 0 && pfd[0].revents) {
+            if (out->m - out->l < 65536)
+                ks_resize(out, out->l + 65536);
+            r = read(pfd[0].fd, out->s + out->l, out->m - out->l);
+            if (r > 0) {
+                out->l += r;
+            } else if (r == 0 || (errno != EINTR && errno != EAGAIN)) {
+                close(pfd[0].fd);
+                pfd[0].fd = -1;
+            }
+        }
+        if (pfd[1].fd >= 0 && pfd[1].revents) {
+            // POLLERR without POLLOUT or EPIPE if the command exits without reading all input
+            // SIGPIPE needs to be ignored by the caller for the latter
+            r = -1;
+            if (pfd[1].revents & POLLOUT) {
+                r = write(pfd[1].fd, in + off, MIN(l_in - off, 65536));
+                if (r < 0 && (errno == EINTR || errno == EAGAIN))
+                    r = 0;
+            }
+            if (r > 0)
+                off += r;
+            if (r < 0 || off == l_in) {
+                close(pfd[1].fd);
+                pfd[1].fd = -1;
+            }
+        }
+    }
+    if (pfd[0].fd >= 0) close(pfd[0].fd);
+    if (pfd[1].fd >= 0) close(pfd[1].fd);
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            return -1;
+    }
+    return status;
+}
+
+// a command that could not run, was killed by a signal or exited with non-zero
+int spawn_failed(int status)
 {
-    int exit_code = system(cmd);
-    --retry;
-    if ((exit_code != -1 && !WEXITSTATUS(exit_code)) || !retry)
-        return exit_code;
-    return run_system_cmd(cmd, retry);
+    return status == -1 || !WIFEXITED(status) || WEXITSTATUS(status);
 }
 
+// spawn_cmd() with up to retry attempts until the command exits with zero
+// out is reset for each attempt
+int run_spawn_cmd(char *const argv[], const char *in, size_t l_in, kstring_t *out, int flags, int retry)
+{
+    int exit_code;
+    do {
+        if (out) out->l = 0;
+        exit_code = spawn_cmd(argv, in, l_in, out, flags);
+    } while (spawn_failed(exit_code) && --retry > 0);
+    return exit_code;
+}
+
+// split a command line into words at blanks as the shell would
+// single and double quotes group blanks into a word; no other expansion
+// returns the number of words or -1 on an unbalanced quote
+// the words share one buffer: free(argv[0]) then free(argv)
+int split_cmd(const char *cmd, char ***_argv)
+{
+    int n, q;
+    size_t l;
+    char *buf, *d, **argv;
+    const char *p;
+
+    l = strlen(cmd);
+    MYMALLOC(buf, l + 1);
+    MYMALLOC(argv, l / 2 + 2);
+    d = buf, p = cmd, n = q = 0;
+    while (1) {
+        while (*p && isspace((unsigned char) *p)) ++p;
+        if (*p == 0) break;
+        argv[n++] = d;
+        while (*p && (q || !isspace((unsigned char) *p))) {
+            if (!q && (*p == '\'' || *p == '"')) q = *p++;
+            else if (q && *p == q) q = 0, ++p;
+            else *d++ = *p++;
+        }
+        *d++ = 0;
+    }
+    argv[n] = 0;
+    if (q || n == 0) {
+        free(buf);
+        free(argv);
+        *_argv = 0;
+        return q? -1 : 0;
+    }
+    *_argv = argv;
+    return n;
+}
+
+// exe may carry leading words such as a container wrapper or fixed options
 void check_executable(char *exe)
 {
-    char cmd[4096];
-    sprintf(cmd, "%s -h >/dev/null 2>&1", exe);
+    int n, exit_code;
+    char **words;
 
-    int exit_code = run_system_cmd(cmd, 1);
-    if (exit_code == -1 || WEXITSTATUS(exit_code)) {
+    n = split_cmd(exe, &words);
+    if (n <= 0) {
+        fprintf(stderr, "[E::%s] invalid command: %s\n", __func__, exe);
+        exit(EXIT_FAILURE);
+    }
+    char *argv[n + 2];
+    memcpy(argv, words, n * sizeof(char *));
+    argv[n] = "-h", argv[n + 1] = 0;
+    exit_code = run_spawn_cmd(argv, 0, 0, 0, SPAWN_NULL_OUT, 1);
+    free(words[0]);
+    free(words);
+    if (spawn_failed(exit_code)) {
         fprintf(stderr, "[E::%s] executable %s is not available\n", __func__, exe);
         exit(EXIT_FAILURE);
     }
@@ -281,14 +453,14 @@ void parse_pathname(char *path, char **_dirname, char **_basename)
         if (_dirname) *_dirname = strdup(path);
         return;
     }
-    char *dirname, *basename, *token;
+    char *dirname, *basename, *token, *save;
     dirname = strdup(path);
-    token = strtok(dirname, "/");
+    token = strtok_r(dirname, "/", &save);
     n_token = 0;
     do {
         ++n_token;
         basename = token;
-        token = strtok(NULL, "/");
+        token = strtok_r(NULL, "/", &save);
     } while (token);
     // necessary for duplicate '/'
     for (i = 0; i < len; ++i)
@@ -321,3 +493,28 @@ void parse_pathname(char *path, char **_dirname, char **_basename)
     return;
 }
 
+
+// parse a comma separated list of positive integers such as "20,30,50"
+// return the number of integers or -1 on invalid input
+int parse_int_list(const char *s, int **_a)
+{
+    int n, *a;
+    size_t m;
+    long x;
+    char *p;
+    n = m = 0;
+    a = 0;
+    for (;;) {
+        x = strtol(s, &p, 10);
+        if (p == s || x <= 0 || x > INT32_MAX || (*p != ',' && *p != 0)) {
+            free(a);
+            return -1;
+        }
+        if (n == m) MYEXPAND(a, m);
+        a[n++] = x;
+        if (*p == 0) break;
+        s = p + 1;
+    }
+    *_a = a;
+    return n;
+}
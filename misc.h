@@ -34,6 +34,8 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "kstring.h"
+
 extern double realtime0;
 
 #define MIN(a, b) (((a)<(b))?(a):(b))
@@ -78,14 +80,20 @@ double realtime(void);
 void liftrlimit(void);
 void sys_init(void);
 void sleep_ms(int ms);
+#define SPAWN_NULL_OUT 0x1 // discard stdout and stderr of a spawned command
+
+int split_cmd(const char *cmd, char ***argv);
 void check_executable(char *exe);
-int run_system_cmd(char *cmd, int retry);
+int spawn_cmd(char *const argv[], const char *in, size_t l_in, kstring_t *out, int flags);
+int run_spawn_cmd(char *const argv[], const char *in, size_t l_in, kstring_t *out, int flags, int retry);
+int spawn_failed(int status);
 int is_file(const char *path);
 int is_dir(const char *path);
 int is_fifo(const char *path);
 char *make_tempfile(char *temp_dir, char *file_template, const char *suffix);
 FILE *open_outstream(char *prefix, char *suffix);
 void parse_pathname(char *path, char **_dirname, char **_basename);
+int parse_int_list(const char *s, int **_a);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,218 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2023 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kvec.h"
+#include "kstring.h"
+
+#include "oagb.h"
+#include "misc.h"
+
+static inline int oagb_nt4(int c)
+{
+    switch (c) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+        default:  return 4;
+    }
+}
+
+oagb_w_t *oagb_w_init(FILE *fo)
+{
+    oagb_w_t *w;
+    MYCALLOC(w, 1);
+    w->fo = fo;
+    return w;
+}
+
+// return the record index of the segment which arcs refer to
+// SC is stored as it is printed in the GFA so the two formats load to the same graph
+uint32_t oagb_add_seg(oagb_w_t *w, const char *name, const char *seq, uint32_t len, uint32_t ln, int64_t kc, double sc, uint32_t flag)
+{
+    uint32_t i;
+    oagb_seg_t *s;
+    char buf[64];
+
+    kv_pushp(oagb_seg_t, w->seg, &s);
+    memset(s, 0, sizeof(oagb_seg_t));
+    s->name = w->name.l;
+    kputsn(name, strlen(name) + 1, &w->name);
+    s->ln = ln;
+    s->kc = kc;
+    if (flag & OAGB_F_SC) {
+        snprintf(buf, sizeof(buf), "%.3f", sc);
+        s->sc = strtod(buf, 0);
+    }
+    s->flag = flag & (OAGB_F_LN | OAGB_F_KC | OAGB_F_SC);
+    if (seq) {
+        s->flag |= OAGB_F_SEQ;
+        s->len = len;
+        s->seq = w->seq.l;
+        for (i = 0; i < len; ++i)
+            if (oagb_nt4((uint8_t) seq[i]) > 3) break;
+        if (i < len) {
+            s->flag |= OAGB_F_RAW;
+            kputsn(seq, len, &w->seq);
+            kputc(0, &w->seq);
+        } else {
+            uint64_t n = ((uint64_t) len + 3) >> 2;
+            ks_resize(&w->seq, w->seq.l + n + 1);
+            MYBZERO(w->seq.s + w->seq.l, n);
+            for (i = 0; i < len; ++i)
+                w->seq.s[w->seq.l + (i >> 2)] |= oagb_nt4((uint8_t) seq[i]) << ((i & 3) << 1);
+            w->seq.l += n;
+        }
+    }
+    return w->seg.n - 1;
+}
+
+void oagb_add_arc(oagb_w_t *w, uint32_t v, uint32_t u, uint64_t ov, uint32_t ec, uint32_t flag)
+{
+    oagb_arc_t *a;
+    kv_pushp(oagb_arc_t, w->arc, &a);
+    a->ov = ov;
+    a->v = v, a->w = u;
+    a->ec = ec;
+    a->flag = flag & OAGB_F_EC;
+}
+
+// write the graph and free the writer; the stream is not closed
+// return 0 on success
+int oagb_w_close(oagb_w_t *w)
+{
+    int ret = 0;
+    oagb_hdr_t h;
+
+    memset(&h, 0, sizeof(oagb_hdr_t));
+    memcpy(h.magic, OAGB_MAGIC, 4);
+    h.version = OAGB_VERSION;
+    h.n_seg = w->seg.n;
+    h.n_arc = w->arc.n;
+    h.off_seg = sizeof(oagb_hdr_t);
+    h.off_arc = h.off_seg + h.n_seg * sizeof(oagb_seg_t);
+    h.off_name = h.off_arc + h.n_arc * sizeof(oagb_arc_t);
+    h.off_seq = h.off_name + w->name.l;
+    h.l_file = h.off_seq + w->seq.l;
+
+    if (fwrite(&h, sizeof(oagb_hdr_t), 1, w->fo) != 1 ||
+            fwrite(w->seg.a, sizeof(oagb_seg_t), w->seg.n, w->fo) != w->seg.n ||
+            fwrite(w->arc.a, sizeof(oagb_arc_t), w->arc.n, w->fo) != w->arc.n ||
+            fwrite(w->name.s, 1, w->name.l, w->fo) != w->name.l ||
+            fwrite(w->seq.s, 1, w->seq.l, w->fo) != w->seq.l) {
+        fprintf(stderr, "[E::%s] failed to write the binary graph\n", __func__);
+        ret = 1;
+    }
+
+    kv_destroy(w->seg);
+    kv_destroy(w->arc);
+    free(w->name.s);
+    free(w->seq.s);
+    free(w);
+    return ret;
+}
+
+// return 1 if the buffer starts with the magic, -1 if it is a truncated or
+// corrupted binary graph, 0 if it is not a binary graph
+int oagb_check(const char *mm, uint64_t l_mm)
+{
+    uint64_t i;
+    const oagb_hdr_t *h;
+    const oagb_seg_t *s;
+    const oagb_arc_t *a;
+
+    if (l_mm < 4 || memcmp(mm, OAGB_MAGIC, 4)) return 0;
+    if (l_mm < sizeof(oagb_hdr_t)) return -1;
+    h = (const oagb_hdr_t *) mm;
+    if (h->version != OAGB_VERSION || h->l_file != l_mm ||
+            h->off_seg != sizeof(oagb_hdr_t) ||
+            h->off_arc != h->off_seg + h->n_seg * sizeof(oagb_seg_t) ||
+            h->off_name != h->off_arc + h->n_arc * sizeof(oagb_arc_t) ||
+            h->off_seq < h->off_name || h->off_seq > l_mm ||
+            (h->off_seq > h->off_name && mm[h->off_seq - 1] != 0))
+        return -1;
+    s = (const oagb_seg_t *) (mm + h->off_seg);
+    for (i = 0; i < h->n_seg; ++i) {
+        if (h->off_name + s[i].name >= h->off_seq) return -1;
+        if (s[i].flag & OAGB_F_SEQ) {
+            if (h->off_seq + s[i].seq + oagb_seq_size(&s[i]) > l_mm) return -1;
+            if ((s[i].flag & OAGB_F_RAW) && mm[h->off_seq + s[i].seq + s[i].len] != 0) return -1;
+        }
+    }
+    a = (const oagb_arc_t *) (mm + h->off_arc);
+    for (i = 0; i < h->n_arc; ++i)
+        if ((a[i].v >> 1) >= h->n_seg || (a[i].w >> 1) >= h->n_seg) return -1;
+    return 1;
+}
+
+// the four bases packed in a byte
+static const char oagb_unpack_table[256][4] = {
+    "AAAA", "CAAA", "GAAA", "TAAA", "ACAA", "CCAA", "GCAA", "TCAA",
+    "AGAA", "CGAA", "GGAA", "TGAA", "ATAA", "CTAA", "GTAA", "TTAA",
+    "AACA", "CACA", "GACA", "TACA", "ACCA", "CCCA", "GCCA", "TCCA",
+    "AGCA", "CGCA", "GGCA", "TGCA", "ATCA", "CTCA", "GTCA", "TTCA",
+    "AAGA", "CAGA", "GAGA", "TAGA", "ACGA", "CCGA", "GCGA", "TCGA",
+    "AGGA", "CGGA", "GGGA", "TGGA", "ATGA", "CTGA", "GTGA", "TTGA",
+    "AATA", "CATA", "GATA", "TATA", "ACTA", "CCTA", "GCTA", "TCTA",
+    "AGTA", "CGTA", "GGTA", "TGTA", "ATTA", "CTTA", "GTTA", "TTTA",
+    "AAAC", "CAAC", "GAAC", "TAAC", "ACAC", "CCAC", "GCAC", "TCAC",
+    "AGAC", "CGAC", "GGAC", "TGAC", "ATAC", "CTAC", "GTAC", "TTAC",
+    "AACC", "CACC", "GACC", "TACC", "ACCC", "CCCC", "GCCC", "TCCC",
+    "AGCC", "CGCC", "GGCC", "TGCC", "ATCC", "CTCC", "GTCC", "TTCC",
+    "AAGC", "CAGC", "GAGC", "TAGC", "ACGC", "CCGC", "GCGC", "TCGC",
+    "AGGC", "CGGC", "GGGC", "TGGC", "ATGC", "CTGC", "GTGC", "TTGC",
+    "AATC", "CATC", "GATC", "TATC", "ACTC", "CCTC", "GCTC", "TCTC",
+    "AGTC", "CGTC", "GGTC", "TGTC", "ATTC", "CTTC", "GTTC", "TTTC",
+    "AAAG", "CAAG", "GAAG", "TAAG", "ACAG", "CCAG", "GCAG", "TCAG",
+    "AGAG", "CGAG", "GGAG", "TGAG", "ATAG", "CTAG", "GTAG", "TTAG",
+    "AACG", "CACG", "GACG", "TACG", "ACCG", "CCCG", "GCCG", "TCCG",
+    "AGCG", "CGCG", "GGCG", "TGCG", "ATCG", "CTCG", "GTCG", "TTCG",
+    "AAGG", "CAGG", "GAGG", "TAGG", "ACGG", "CCGG", "GCGG", "TCGG",
+    "AGGG", "CGGG", "GGGG", "TGGG", "ATGG", "CTGG", "GTGG", "TTGG",
+    "AATG", "CATG", "GATG", "TATG", "ACTG", "CCTG", "GCTG", "TCTG",
+    "AGTG", "CGTG", "GGTG", "TGTG", "ATTG", "CTTG", "GTTG", "TTTG",
+    "AAAT", "CAAT", "GAAT", "TAAT", "ACAT", "CCAT", "GCAT", "TCAT",
+    "AGAT", "CGAT", "GGAT", "TGAT", "ATAT", "CTAT", "GTAT", "TTAT",
+    "AACT", "CACT", "GACT", "TACT", "ACCT", "CCCT", "GCCT", "TCCT",
+    "AGCT", "CGCT", "GGCT", "TGCT", "ATCT", "CTCT", "GTCT", "TTCT",
+    "AAGT", "CAGT", "GAGT", "TAGT", "ACGT", "CCGT", "GCGT", "TCGT",
+    "AGGT", "CGGT", "GGGT", "TGGT", "ATGT", "CTGT", "GTGT", "TTGT",
+    "AATT", "CATT", "GATT", "TATT", "ACTT", "CCTT", "GCTT", "TCTT",
+    "AGTT", "CGTT", "GGTT", "TGTT", "ATTT", "CTTT", "GTTT", "TTTT"
+};
+
+void oagb_unpack_seq(const uint8_t *p, uint32_t len, char *s)
+{
+    uint32_t i;
+    for (i = 0; i + 4 <= len; i += 4)
+        memcpy(s + i, oagb_unpack_table[p[i >> 2]], 4);
+    for (; i < len; ++i)
+        s[i] = "ACGT"[p[i >> 2] >> ((i & 3) << 1) & 3];
+    s[len] = 0;
+}
@@ -0,0 +1,102 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2023 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+#ifndef __OAGB_H__
+#define __OAGB_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "kvec.h"
+#include "kstring.h"
+
+/* Compact binary assembly graph (.oagb)
+ *
+ * [oagb_hdr_t][oagb_seg_t x n_seg][oagb_arc_t x n_arc][name table][sequences]
+ *
+ * Names are NUL-terminated. A sequence of ACGT only is 2-bit packed with four
+ * bases per byte, the first base in the lowest two bits; any other sequence is
+ * kept as NUL-terminated text. Integers are stored in the host byte order.
+ * The tags oatk uses (LN:i, KC:i and SC:f for segments, EC:i for arcs) are
+ * kept with the values they have in the GFA output.
+ */
+
+#define OAGB_MAGIC "OAGB"
+#define OAGB_VERSION 1
+
+#define OAGB_F_SEQ 0x1  // sequence present
+#define OAGB_F_RAW 0x2  // sequence stored as text
+#define OAGB_F_LN  0x4  // LN:i
+#define OAGB_F_KC  0x8  // KC:i
+#define OAGB_F_SC  0x10 // SC:f
+#define OAGB_F_EC  0x1  // arc EC:i
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t n_seg, n_arc;
+    uint64_t off_seg, off_arc, off_name, off_seq;
+    uint64_t l_file;
+} oagb_hdr_t;
+
+typedef struct {
+    uint64_t name, seq; // offsets into the name table and the sequences
+    int64_t kc;
+    double sc;
+    uint32_t len, ln; // sequence length; LN:i
+    uint32_t flag, pad;
+} oagb_seg_t;
+
+typedef struct {
+    uint64_t ov; // overlap length
+    uint32_t v, w; // seg<<1|ori; seg is the record index
+    uint32_t ec;
+    uint32_t flag;
+} oagb_arc_t;
+
+typedef struct {
+    FILE *fo;
+    kvec_t(oagb_seg_t) seg;
+    kvec_t(oagb_arc_t) arc;
+    kstring_t name, seq;
+} oagb_w_t;
+
+#define oagb_seq_size(s) (((s)->flag & OAGB_F_RAW)? (uint64_t) (s)->len + 1 : ((uint64_t) (s)->len + 3) >> 2)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+oagb_w_t *oagb_w_init(FILE *fo);
+uint32_t oagb_add_seg(oagb_w_t *w, const char *name, const char *seq, uint32_t len, uint32_t ln, int64_t kc, double sc, uint32_t flag);
+void oagb_add_arc(oagb_w_t *w, uint32_t v, uint32_t u, uint64_t ov, uint32_t ec, uint32_t flag);
+int oagb_w_close(oagb_w_t *w);
+int oagb_check(const char *mm, uint64_t l_mm);
+void oagb_unpack_seq(const uint8_t *p, uint32_t len, char *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -32,13 +32,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
 #include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
 #include "kvec.h"
 #include "khashl.h"
 #include "ketopt.h"
 
+#include "kthread.h"
 #include "misc.h"
 #include "path.h"
 #include "graph.h"
@@ -49,34 +53,101 @@
 int VERBOSE = 0;
 
 int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_size, int tip_size, int min_k_cov,
-        double min_a_cov_f, double weak_cross, int do_ec, int do_unzip, int n_threads, char *out, scg_meta_t *meta, int VERBOSE);
+        int *sweep_c, int n_sweep, double min_a_cov_f, double weak_cross, int do_ec, int do_unzip, const kt_ctx_t *kc, char *out, int out_bin,
+        char *ckpt_dir, int resume, char *bait_file, int min_bait, int n_recruit, scg_meta_t *meta, int VERBOSE);
 
-int hmm_annotate(char **file_in, int n_file, char *nhmmscan, char *nhmmdb, FILE *fo, uint32_t max_batch_size, 
-        uint32_t max_batch_num, int n_threads, char *tmpdir);
+int hmm_annotate(char **file_in, int n_file, char *nhmmscan, char **nhmmdb, FILE **fo, int n_db, uint32_t max_batch_size, 
+        uint32_t max_batch_num, const kt_ctx_t *kc, char *tmpdir, int stream, char *cache_dir, char *pf_ref, int pf_min);
 
-int pathfinder(char *asg_file, char *mito_annot, char *pltd_annot, int min_len, int ext_p, int ext_m,
+int pathfinder(char *asg_file, asg_t *asg_in, char *mito_annot, char *pltd_annot, int min_len, int ext_p, int ext_m,
         int max_copy, double max_eval, double min_score, double min_cf, double seq_cf, int no_trn, int no_rrn,
-        int do_graph_clean, int bubble_size, int tip_size, double weak_cross, int out_opt, char *out_pref, int VERBOSE);
+        int do_graph_clean, int bubble_size, int tip_size, double weak_cross, int out_opt, char *out_pref, const kt_ctx_t *kc, int VERBOSE);
 
-int pathfinder_minicircle(char *asg_file, char *mini_annot, scg_meta_t *scg_meta, int min_len,
+int pathfinder_minicircle(char *asg_file, asg_t *asg_in, char *mini_annot, scg_meta_t *scg_meta, int min_len,
         int min_ex_g, int max_copy, double max_eval, double min_score, double min_cf, double seq_cf,
         int no_trn, int no_rrn, int do_graph_clean, int bubble_size, int tip_size, double weak_cross,
-        int out_opt, char *out_pref, int n_threads, int VERBOSE);
+        int out_opt, char *out_pref, const kt_ctx_t *kc, int VERBOSE);
 
 static int make_dir(char *dir)
 {
     struct stat st = {0};
     if (stat(dir, &st) == -1) {
         int ret = mkdir(dir, 0700);
-        if (ret) {
+        if (ret && errno != EEXIST) { // EEXIST: another sample of the batch got there first
             fprintf(stderr, "[W::%s] create output directory '%s' failed: %s\n", __func__, dir, strerror(errno));
-            exit(EXIT_FAILURE);
+            return -1;
         }
-        return 1;
+        return ret == 0;
     }
     return 0;
 }
 
+typedef struct {
+    // syncasm
+    int k, s, bubble_size, tip_size, min_k_cov, *sweep_c, n_sweep;
+    int do_ec, do_unzip, out_bin, resume, min_bait, n_recruit;
+    double min_a_cov_f, weak_cross;
+    size_t m_data;
+    char *bait_file;
+    // hmm annotation
+    char *nhmmscan, *mito_db, *pltd_db, *tmpdir, *cache_dir, *pf_ref;
+    int batch_size, stream, pf_min;
+    // pathfinder
+    int out_s, max_copy, min_len, ext_p, ext_m, no_trn, no_rrn, do_graph_clean;
+    double max_eval, min_score, min_cf, seq_cf;
+    // public
+    int mini_circle, input_asg, gfa_tag, batch, n_threads;
+} oatk_opt_t;
+
+typedef struct {
+    int64_t budget, used; // bytes; budget 0 for unlimited
+    pthread_mutex_t mutex;
+    pthread_cond_t cv;
+} oatk_mem_t;
+
+// rough peak memory of syncasm on the input files: twice the uncompressed input
+// size (capped by the data limit), with gzip files assumed to compress 4:1
+static int64_t oatk_mem_estimate(char **file_in, int n_file, size_t m_data)
+{
+    struct stat st;
+    int64_t size = 0, l;
+    int i, n;
+    for (i = 0; i < n_file; ++i) {
+        if (stat(file_in[i], &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        n = strlen(file_in[i]);
+        l = st.st_size;
+        if (n > 3 && strcmp(file_in[i] + n - 3, ".gz") == 0) l *= 4;
+        size += l;
+    }
+    if (m_data > 0 && size > (int64_t) m_data) size = m_data;
+    return size * 2;
+}
+
+// block until need bytes fit in the budget; a lone sample is always let through
+static int64_t oatk_mem_acquire(oatk_mem_t *mem, int64_t need, char *name)
+{
+    if (mem == 0 || mem->budget == 0) return 0;
+    if (need > mem->budget) need = mem->budget;
+    pthread_mutex_lock(&mem->mutex);
+    if (mem->used > 0 && mem->used + need > mem->budget)
+        fprintf(stderr, "[M::%s] sample %s waits for %.3f GB of memory budget\n", __func__, name, need / 1073741824.0);
+    while (mem->used > 0 && mem->used + need > mem->budget)
+        pthread_cond_wait(&mem->cv, &mem->mutex);
+    mem->used += need;
+    pthread_mutex_unlock(&mem->mutex);
+    return need;
+}
+
+static void oatk_mem_release(oatk_mem_t *mem, int64_t *held)
+{
+    if (mem == 0 || *held == 0) return;
+    pthread_mutex_lock(&mem->mutex);
+    mem->used -= *held;
+    pthread_cond_broadcast(&mem->cv);
+    pthread_mutex_unlock(&mem->mutex);
+    *held = 0;
+}
+
 static ko_longopt_t long_options[] = {
     { "max-bubble",     ko_required_argument, 301 },
     { "max-tip",        ko_required_argument, 302 },
@@ -93,6 +164,20 @@ static ko_longopt_t long_options[] = {
     { "edge-c-tag",     ko_required_argument, 313 },
     { "kmer-c-tag",     ko_required_argument, 314 },
     { "seq-c-tag",      ko_required_argument, 315 },
+    { "stream",         ko_no_argument,       316 },
+    { "annot-cache",    ko_required_argument, 317 },
+    { "prefilter-min",  ko_required_argument, 318 },
+    { "prefilter-ref",  ko_required_argument, 319 },
+    { "oagb",           ko_no_argument,       320 },
+    { "sweep-c",        ko_required_argument, 321 },
+    { "checkpoint-dir", ko_required_argument, 322 },
+    { "resume",         ko_no_argument,       323 },
+    { "manifest",       ko_required_argument, 324 },
+    { "jobs",           ko_required_argument, 325 },
+    { "mem-budget",     ko_required_argument, 326 },
+    { "bait",           ko_required_argument, 327 },
+    { "min-bait",       ko_required_argument, 328 },
+    { "recruit-round",  ko_required_argument, 329 },
     { "mini-circle",    ko_no_argument,       'M' },
     { "mito-db",        ko_required_argument, 'm' },
     { "pltd-db",        ko_required_argument, 'p' },
@@ -109,18 +194,361 @@ static ko_longopt_t long_options[] = {
     { 0, 0, 0 }
 };
 
+// run the whole pipeline for one sample writing files with prefix out
+static int oatk_sample(const oatk_opt_t *o, const kt_ctx_t *kc, char **file_in, int n_file, char *out, char *ckpt_dir, oatk_mem_t *mem)
+{
+    int ret = 0;
+    /*** parse output dirname and basename ***/
+    char *outdir, *outname;
+    int free_outdir, free_outname;
+    parse_pathname(out, &outdir, &outname);
+    free_outdir = free_outname = 0;
+    if (!outdir) {
+        outdir = ".";
+        fprintf(stderr, "[W::%s] invalid output directory - using '%s' instead\n", __func__, outdir);
+    } else {
+        free_outdir = 1;
+        if (make_dir(outdir) < 0) {
+            free(outdir);
+            free(outname);
+            return 1;
+        }
+    }
+    if (!outname) {
+        outname = "oatk.asm";
+        fprintf(stderr, "[W::%s] invalid output name prefix - using '%s' instead\n", __func__, outname);
+    } else {
+        free_outname = 1;
+    }
+
+    int outlen = strlen(outdir) + strlen(outname) + 4;
+    char *outpref;
+    MYMALLOC(outpref, outlen);
+    sprintf(outpref, "%s/%s", outdir, outname);
+
+    /*** syncasm assembly ***/
+    scg_meta_t *scg_meta;
+    char *asg_file;
+    asg_t *asg;
+    int64_t mem_held;
+    MYCALLOC(scg_meta, 1);
+    asg = 0;
+    mem_held = 0;
+    if (o->input_asg) {
+        MYMALLOC(asg_file, strlen(file_in[0]) + 1);
+        sprintf(asg_file, "%s", file_in[0]);
+        fprintf(stderr, "[M::%s] using user input assembly graph file: %s\n", __func__, asg_file);
+    } else {
+        // in a batch, hold back until the reads of this sample fit in the memory budget
+        mem_held = oatk_mem_acquire(mem, oatk_mem_estimate(file_in, n_file, o->m_data), outname);
+        ret = syncasm(file_in, n_file, o->m_data, o->k, o->s, o->bubble_size, o->tip_size, o->min_k_cov, o->sweep_c, o->n_sweep,
+                o->min_a_cov_f, o->weak_cross, o->do_ec, o->do_unzip, kc, outpref, o->out_bin,
+                ckpt_dir, o->resume, o->bait_file, o->min_bait, o->n_recruit, scg_meta, VERBOSE);
+        if (ret) {
+            fprintf(stderr, "[E::%s] syncasm assembly program failed\n", __func__);
+            oatk_mem_release(mem, &mem_held);
+            scg_meta_destroy(scg_meta);
+            if (free_outdir) free(outdir);
+            if (free_outname) free(outname);
+            free(outpref);
+            return 1;
+        }
+        MYMALLOC(asg_file, outlen + 32);
+        sprintf(asg_file, "%s.utg.final.gfa", outpref);
+        // hand the graph over to pathfinder in memory instead of parsing the GFA file again
+        // custom coverage tags only make sense for a GFA file
+        if (scg_meta->scg && !o->gfa_tag)
+            asg = asg_from_asmg(scg_meta->scg->utg_asmg);
+        // only the mini-circle mode looks at the syncmer graph again
+        if (!o->mini_circle) {
+            scg_meta_destroy(scg_meta);
+            MYCALLOC(scg_meta, 1);
+            oatk_mem_release(mem, &mem_held);
+        }
+    }
+
+    /*** hmm annotation ***/
+    char *mito_annot, *pltd_annot, *tmpdir;
+    mito_annot = pltd_annot = 0;
+    tmpdir = o->tmpdir;
+    int rm_tmpdir, free_tmpdir; // make temp dir if not provided or existed
+    rm_tmpdir = free_tmpdir = 0;
+    if (tmpdir && !o->batch) {
+        rm_tmpdir = make_dir(tmpdir);
+        if (rm_tmpdir < 0) rm_tmpdir = 0, ret = 1;
+    } else {
+        // samples of a batch each get a private directory under -T
+        char *file_template;
+        MYMALLOC(file_template, strlen(tmpdir? tmpdir : outdir) + 16);
+        sprintf(file_template, "%s/%s", tmpdir? tmpdir : outdir, "tmp_XXXXXXXXXX");
+        tmpdir = mkdtemp(file_template);
+        if (tmpdir == 0) {
+            fprintf(stderr, "[E::%s] failed to create temporary directory: %s\n", __func__, strerror(errno));
+            free(file_template);
+            ret = 1;
+        } else {
+            rm_tmpdir = 1;
+            free_tmpdir = 1;
+        }
+    }
+    // annotate against both databases in one pass sharing the batches
+    // with --sweep-c each assembly is annotated and resolved in turn under its own prefix
+    char *annot_db[2], *runpref;
+    FILE *annot_fo[2];
+    int i, j, n_annot, n_run;
+    n_run = o->n_sweep > 0? o->n_sweep : 1;
+    MYMALLOC(runpref, outlen + 16);
+    if (o->mito_db) MYMALLOC(mito_annot, outlen + 32);
+    if (o->pltd_db) MYMALLOC(pltd_annot, outlen + 32);
+    for (j = 0; j < n_run && ret == 0; ++j) {
+        if (o->n_sweep > 0) {
+            sprintf(runpref, "%s.c%d", outpref, o->sweep_c[j]);
+            sprintf(asg_file, "%s.utg.final.gfa", runpref);
+            fprintf(stderr, "[M::%s] organelle assembly with minimum kmer coverage %d: %s\n", __func__, o->sweep_c[j], runpref);
+        } else {
+            sprintf(runpref, "%s", outpref);
+        }
+
+        n_annot = 0;
+        if (o->mito_db) {
+            sprintf(mito_annot, "%s.annot_mito.txt", runpref);
+            annot_db[n_annot] = o->mito_db;
+            annot_fo[n_annot++] = fopen(mito_annot, "w");
+        }
+        if (o->pltd_db) {
+            sprintf(pltd_annot, "%s.annot_pltd.txt", runpref);
+            annot_db[n_annot] = o->pltd_db;
+            annot_fo[n_annot++] = fopen(pltd_annot, "w");
+        }
+        ret = hmm_annotate(&asg_file, 1, o->nhmmscan, annot_db, annot_fo, n_annot, o->batch_size, kc->n_threads * 5, kc,
+                tmpdir, o->stream, o->cache_dir, o->pf_ref, o->pf_min);
+        for (i = 0; i < n_annot; ++i)
+            fclose(annot_fo[i]);
+        if (ret) {
+            fprintf(stderr, "[E::%s] annotation program failed\n", __func__);
+            break;
+        }
+
+        /*** pathfinder ***/
+        if (o->mini_circle) // pathfinder in mini-circle mode
+            ret = pathfinder_minicircle(asg_file, asg, o->mito_db? mito_annot : pltd_annot, scg_meta, o->min_len, o->ext_p, o->max_copy, 
+                    o->max_eval, o->min_score, o->min_cf, o->seq_cf, o->no_trn, o->no_rrn, o->do_graph_clean, o->bubble_size, 
+                    o->tip_size, o->weak_cross, o->out_s, runpref, kc, VERBOSE);
+        else // pathfinder in normal mode
+            ret = pathfinder(asg_file, asg, mito_annot, pltd_annot, o->min_len, o->ext_p, o->ext_m, o->max_copy, 
+                    o->max_eval, o->min_score, o->min_cf, o->seq_cf, o->no_trn, o->no_rrn, o->do_graph_clean, o->bubble_size, 
+                    o->tip_size, o->weak_cross, o->out_s, runpref, kc, VERBOSE);
+        if (ret) fprintf(stderr, "[E::%s] pathfinder program failed\n", __func__);
+    }
+
+    /*** final clean ***/
+    oatk_mem_release(mem, &mem_held);
+    if (rm_tmpdir) rmdir(tmpdir); // should be empty
+    if (free_tmpdir) free(tmpdir);
+    if (free_outdir) free(outdir);
+    if (free_outname) free(outname);
+    free(mito_annot);
+    free(pltd_annot);
+    free(asg_file);
+    free(runpref);
+    free(outpref);
+    scg_meta_destroy(scg_meta);
+
+    return ret;
+}
+
+typedef struct {
+    char *name, **file_in;
+    int n_file;
+} oatk_sample_t;
+
+typedef struct {
+    const oatk_opt_t *o;
+    oatk_sample_t *a;
+    int n, next, n_failed, n_jobs, n_workers;
+    char *out, *ckpt_dir;
+    oatk_mem_t mem;
+    pthread_mutex_t mutex;
+} oatk_batch_t;
+
+static void oatk_sample_destroy(oatk_sample_t *a, int n)
+{
+    int i, j;
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < a[i].n_file; ++j)
+            free(a[i].file_in[j]);
+        free(a[i].file_in);
+        free(a[i].name);
+    }
+    free(a);
+}
+
+// manifest lines: <sample> <file> [file ...]; blank lines and '#' comments are skipped
+static oatk_sample_t *oatk_manifest_read(char *fn, int *_n)
+{
+    FILE *fp;
+    char *line, *p, *q, *save;
+    size_t ln, m;
+    int i, n, lno;
+    oatk_sample_t *a, *r;
+    
+    *_n = 0;
+    fp = fopen(fn, "r");
+    if (fp == 0) {
+        fprintf(stderr, "[E::%s] failed to open file %s to read: %s\n", __func__, fn, strerror(errno));
+        return 0;
+    }
+    line = 0;
+    ln = 0;
+    a = 0;
+    n = m = lno = 0;
+    while (getline(&line, &ln, fp) != -1) {
+        ++lno;
+        if ((p = strchr(line, '#')) != 0) *p = 0;
+        p = strtok_r(line, " \t\r\n", &save);
+        if (p == 0) continue;
+        for (i = 0; i < n; ++i) {
+            if (strcmp(a[i].name, p) == 0) {
+                fprintf(stderr, "[E::%s] duplicate sample name '%s' at line %d of %s\n", __func__, p, lno, fn);
+                goto fail;
+            }
+        }
+        if (strchr(p, '/')) {
+            fprintf(stderr, "[E::%s] sample name '%s' at line %d of %s contains '/'\n", __func__, p, lno, fn);
+            goto fail;
+        }
+        if (n == m) {
+            MYEXPAND(a, m);
+            MYBZERO(a + n, m - n);
+        }
+        r = &a[n++];
+        r->name = strdup(p);
+        size_t m_file = 0;
+        while ((q = strtok_r(0, " \t\r\n", &save)) != 0) {
+            // check up front; a missing file would otherwise stop the batch halfway
+            if (!is_file(q)) {
+                fprintf(stderr, "[E::%s] input file of sample '%s' does not exist: %s\n", __func__, r->name, q);
+                goto fail;
+            }
+            if (r->n_file == m_file) MYEXPAND(r->file_in, m_file);
+            r->file_in[r->n_file++] = strdup(q);
+        }
+        if (r->n_file == 0) {
+            fprintf(stderr, "[E::%s] no input file for sample '%s' at line %d of %s\n", __func__, p, lno, fn);
+            goto fail;
+        }
+    }
+    free(line);
+    fclose(fp);
+    if (n == 0) {
+        fprintf(stderr, "[E::%s] no sample found in %s\n", __func__, fn);
+        free(a);
+        return 0;
+    }
+    *_n = n;
+    return a;
+
+fail:
+    free(line);
+    fclose(fp);
+    oatk_sample_destroy(a, n);
+    return 0;
+}
+
+static void *oatk_batch_worker(void *data)
+{
+    oatk_batch_t *b = (oatk_batch_t *) data;
+    oatk_sample_t *a;
+    char *out, *ckpt_dir;
+    kt_ctx_t kc;
+    double rt;
+    int i, ret, n_threads;
+
+    // each job runs on its own share of the -t threads
+    pthread_mutex_lock(&b->mutex);
+    i = b->n_workers++;
+    pthread_mutex_unlock(&b->mutex);
+    n_threads = b->o->n_threads / b->n_jobs + (i < b->o->n_threads % b->n_jobs);
+    kt_ctx_init(&kc, n_threads);
+
+    for (;;) {
+        pthread_mutex_lock(&b->mutex);
+        i = b->next < b->n? b->next++ : -1;
+        pthread_mutex_unlock(&b->mutex);
+        if (i < 0) break;
+        a = &b->a[i];
+        MYMALLOC(out, strlen(b->out) + strlen(a->name) + 2);
+        sprintf(out, "%s.%s", b->out, a->name);
+        ckpt_dir = 0;
+        if (b->ckpt_dir) {
+            MYMALLOC(ckpt_dir, strlen(b->ckpt_dir) + strlen(a->name) + 2);
+            sprintf(ckpt_dir, "%s/%s", b->ckpt_dir, a->name);
+        }
+        rt = realtime();
+        fprintf(stderr, "[M::%s] sample %s (%d/%d) started: %s\n", __func__, a->name, i + 1, b->n, out);
+        ret = oatk_sample(b->o, &kc, a->file_in, a->n_file, out, ckpt_dir, &b->mem);
+        if (ret) {
+            fprintf(stderr, "[E::%s] sample %s failed after %.3f sec\n", __func__, a->name, realtime() - rt);
+            pthread_mutex_lock(&b->mutex);
+            ++b->n_failed;
+            pthread_mutex_unlock(&b->mutex);
+        } else {
+            fprintf(stderr, "[M::%s] sample %s finished in %.3f sec\n", __func__, a->name, realtime() - rt);
+        }
+        free(out);
+        free(ckpt_dir);
+    }
+    kt_ctx_destroy(&kc);
+    return 0;
+}
+
+// run the samples jobs at a time; the -t threads are split between the jobs
+static int oatk_batch(const oatk_opt_t *o, oatk_sample_t *a, int n, int n_jobs, int64_t mem_budget, char *out, char *ckpt_dir)
+{
+    oatk_batch_t b;
+    pthread_t *tid;
+    int i;
+
+    memset(&b, 0, sizeof(b));
+    b.o = o;
+    b.a = a;
+    b.n = n;
+    b.out = out;
+    b.ckpt_dir = ckpt_dir;
+    b.mem.budget = mem_budget;
+    pthread_mutex_init(&b.mutex, 0);
+    pthread_mutex_init(&b.mem.mutex, 0);
+    pthread_cond_init(&b.mem.cv, 0);
+    if (n_jobs > n) n_jobs = n;
+    b.n_jobs = n_jobs;
+    fprintf(stderr, "[M::%s] %d samples, %d at a time sharing %d threads\n", __func__, n, n_jobs, o->n_threads);
+
+    MYMALLOC(tid, n_jobs);
+    for (i = 0; i < n_jobs; ++i) pthread_create(&tid[i], 0, oatk_batch_worker, &b);
+    for (i = 0; i < n_jobs; ++i) pthread_join(tid[i], 0);
+    free(tid);
+
+    pthread_cond_destroy(&b.mem.cv);
+    pthread_mutex_destroy(&b.mem.mutex);
+    pthread_mutex_destroy(&b.mutex);
+    if (b.n_failed)
+        fprintf(stderr, "[E::%s] %d of %d samples failed\n", __func__, b.n_failed, n);
+    return b.n_failed > 0;
+}
+
 int main(int argc, char *argv[])
 {
     const char *opt_str = "a:b:c:C:D:e:f:g:Ghk:l:m:Mo:p:q:s:S:t:T:v:V";
     ketopt_t opt = KETOPT_INIT;
     int k, s, bubble_size, tip_size, min_k_cov, batch_size;
     int out_s, out_c, n_db, max_copy, min_len, ext_p, ext_m;
-    int mini_circle, n_threads;
+    int mini_circle, n_threads, *sweep_c, n_sweep, resume, n_jobs, min_bait, n_recruit;
     double min_a_cov_f, weak_cross, max_eval, min_score, min_cf, seq_cf;
-    int do_ec, do_unzip, input_asg, do_graph_clean, no_trn, no_rrn;
+    int do_ec, do_unzip, out_bin, input_asg, do_graph_clean, no_trn, no_rrn, stream, pf_min;
     size_t m_data;
+    int64_t mem_budget;
     FILE *fp_help;
-    char *out, *nhmmscan, *mito_db, *pltd_db, *tmpdir, *ec_tag, *kc_tag, *sc_tag;
+    char *manifest, *out, *ckpt_dir, *bait_file, *nhmmscan, *mito_db, *pltd_db, *tmpdir, *cache_dir, *pf_ref, *ec_tag, *kc_tag, *sc_tag;
     int c, ret = 0;
 
     sys_init();
@@ -131,6 +559,9 @@ int main(int argc, char *argv[])
     input_asg = 0;
     out = "./oatk.asm";
     fp_help = stderr;
+    manifest = 0;
+    n_jobs = 2;
+    mem_budget = 0;
     // syncasm parameters
     k = 1001;
     s = 31;
@@ -139,6 +570,14 @@ int main(int argc, char *argv[])
     m_data = 0;
     do_ec = 1;
     do_unzip = 3;
+    out_bin = 0;
+    sweep_c = 0;
+    n_sweep = 0;
+    ckpt_dir = 0;
+    resume = 0;
+    bait_file = 0;
+    min_bait = 3;
+    n_recruit = 0;
     bubble_size = 100000;
     tip_size = 10000;
     weak_cross = 0.3;
@@ -149,6 +588,9 @@ int main(int argc, char *argv[])
     batch_size = 100000;
     nhmmscan = "nhmmscan";
     tmpdir = 0;
+    cache_dir = 0;
+    pf_ref = 0;
+    pf_min = 0;
     // pathfinder parameters
     out_s = -1;
     out_c = 0;
@@ -156,6 +598,7 @@ int main(int argc, char *argv[])
     no_trn = 1;
     no_rrn = 1;
     do_graph_clean = 1;
+    stream = 0;
     max_eval = 1e-6;
     min_len = -1;
     min_score = 100;
@@ -216,6 +659,33 @@ int main(int argc, char *argv[])
         else if (c == 313) ec_tag = opt.arg;
         else if (c == 314) kc_tag = opt.arg;
         else if (c == 315) sc_tag = opt.arg;
+        else if (c == 316) stream = 1;
+        else if (c == 317) cache_dir = opt.arg;
+        else if (c == 318) pf_min = atoi(opt.arg);
+        else if (c == 319) pf_ref = opt.arg;
+        else if (c == 320) out_bin = 1;
+        else if (c == 321) {
+            free(sweep_c);
+            n_sweep = parse_int_list(opt.arg, &sweep_c);
+            if (n_sweep < 0) {
+                fprintf(stderr, "[E::%s] invalid kmer coverage list: \"%s\"\n", __func__, opt.arg);
+                return 1;
+            }
+        }
+        else if (c == 322) ckpt_dir = opt.arg;
+        else if (c == 323) resume = 1;
+        else if (c == 327) bait_file = opt.arg;
+        else if (c == 328) min_bait = atoi(opt.arg);
+        else if (c == 329) n_recruit = atoi(opt.arg);
+        else if (c == 324) manifest = opt.arg;
+        else if (c == 325) n_jobs = atoi(opt.arg);
+        else if (c == 326) {
+            char *q;
+            mem_budget = strtol(opt.arg, &q, 0);
+            if (*q == 'k' || *q == 'K') mem_budget <<= 10;
+            else if (*q == 'm' || *q == 'M') mem_budget <<= 20;
+            else if (*q == 'g' || *q == 'G') mem_budget <<= 30;
+        }
         else if (c == 'v') VERBOSE = atoi(opt.arg);
         else if (c == 'h') fp_help = stdout;
         else if (c == 'V') {
@@ -232,9 +702,10 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (argc == opt.ind || fp_help == stdout) {
+    if ((argc == opt.ind && !manifest) || fp_help == stdout) {
         fprintf(fp_help, "\n");
         fprintf(fp_help, "Usage: oatk [options] <target.fa[stq][.gz]> [...]\n");
+        fprintf(fp_help, "       oatk [options] --manifest FILE\n");
         fprintf(fp_help, "Options:\n");
         fprintf(fp_help, "  Input/Output:\n");
         fprintf(fp_help, "    -o FILE              prefix of output files [%s]\n", out);
@@ -243,23 +714,42 @@ int main(int argc, char *argv[])
         fprintf(fp_help, "    -M                   run minicircle mode for small animal mitochondria or plasmid\n");
         fprintf(fp_help, "    -v INT               verbose level [%d]\n", VERBOSE);
         fprintf(fp_help, "    --version            show version number\n");
+        fprintf(fp_help, "    --manifest FILE      assemble many samples listed as '<sample> <file> [file...]' per line;\n");
+        fprintf(fp_help, "                         writes PREFIX.<sample>.* for each sample [NULL]\n");
+        fprintf(fp_help, "    --jobs INT           samples in flight with --manifest; they split the -t threads [%d]\n", n_jobs);
+        fprintf(fp_help, "    --mem-budget NUM     hold back new samples while their estimated assembly memory would\n");
+        fprintf(fp_help, "                         exceed NUM; suffix K/M/G recognized; 0 for unlimited [%ld]\n", (long) mem_budget);
         fprintf(fp_help, "  Syncasm:\n");
         fprintf(fp_help, "    -k INT               kmer size [%d]\n", k);
         fprintf(fp_help, "    -s INT               smer size (no larger than 31) [%d]\n", s);
         fprintf(fp_help, "    -c INT               minimum kmer coverage [%d]\n", min_k_cov);
         fprintf(fp_help, "    -a FLOAT             minimum arc coverage [%.2f]\n", min_a_cov_f);
-        fprintf(fp_help, "    -D INT               maximum amount of data to use; suffix K/M/G recognized [%lu]\n", m_data);
+        fprintf(fp_help, "    -D INT               maximum amount of data to use, counting recruited reads only with --bait; suffix K/M/G recognized [%lu]\n", m_data);
         fprintf(fp_help, "    --max-bubble  INT    maximum bubble size for assembly graph clean [%d]\n", bubble_size);
         fprintf(fp_help, "    --max-tip     INT    maximum tip size for assembly graph clean [%d]\n", tip_size);
         fprintf(fp_help, "    --weak-cross  FLOAT  maximum relative edge coverage for weak crosslink clean [%.2f]\n", weak_cross);
         fprintf(fp_help, "    --unzip-round INT    maximum round of assembly graph unzipping [%d]\n", do_unzip);
         fprintf(fp_help, "    --no-read-ec         do not do read error correction\n");
+        fprintf(fp_help, "    --oagb               also write the final graph in the binary graph format (.oagb)\n");
+        fprintf(fp_help, "    --sweep-c     STR    comma separated minimum kmer coverages to assemble in one run;\n");
+        fprintf(fp_help, "                         overrides -c and writes PREFIX.cINT.* for each value []\n");
+        fprintf(fp_help, "    --checkpoint-dir DIR save the assembly state after each expensive stage to DIR [NULL]\n");
+        fprintf(fp_help, "    --resume             continue the assembly from the last usable checkpoint in DIR\n");
+        fprintf(fp_help, "    --bait FILE          assemble only reads sharing syncmers with the related organelle\n");
+        fprintf(fp_help, "                         genome(s) in FILE [NULL]\n");
+        fprintf(fp_help, "    --min-bait INT       minimum number of shared syncmers to keep a read [%d]\n", min_bait);
+        fprintf(fp_help, "    --recruit-round INT  rounds of extending the baits with the assembled unitigs\n");
+        fprintf(fp_help, "                         and reassembling [%d]\n", n_recruit);
         fprintf(fp_help, "  Annotation:\n");
         fprintf(fp_help, "    -m FILE              mitochondria gene annotation HMM profile database [NULL]\n");
         fprintf(fp_help, "    -p FILE              plastid gene annotation HMM profile database [NULL]\n");
         fprintf(fp_help, "    -b INT               batch size [%d]\n", batch_size);
         fprintf(fp_help, "    -T DIR               temporary directory [NULL]\n");
-        fprintf(fp_help, "    --nhmmscan STR       nhmmscan executable path [nhmmscan]\n");
+        fprintf(fp_help, "    --nhmmscan STR       nhmmscan command, may start with a wrapper [nhmmscan]\n");
+        fprintf(fp_help, "    --stream             pipe sequences and results through nhmmscan instead of temp files\n");
+        fprintf(fp_help, "    --annot-cache DIR    reuse annotations of unchanged sequences cached in DIR [NULL]\n");
+        fprintf(fp_help, "    --prefilter-min INT  skip nhmmscan for sequences with < INT seed hits to the HMM consensus; 0 to disable [%d]\n", pf_min);
+        fprintf(fp_help, "    --prefilter-ref FILE build the prefilter seeds from the sequences in FILE instead [NULL]\n");
         fprintf(fp_help, "  Pathfinder:\n");
         fprintf(fp_help, "    -f FLOAT             prefer circular path to longest if >= FLOAT sequence covered [%.2f]\n", seq_cf);
         fprintf(fp_help, "    -S FLOAT             minimum total annotation score of a subgraph [%.1f]\n", min_score);
@@ -339,123 +829,101 @@ int main(int argc, char *argv[])
         // exit(EXIT_FAILURE);
     }
 
-    if (mini_circle && n_db > 1) {
-        fprintf(stderr, "[E::%s] only one HMM profile database (-m or -p) allowed for mini-circle mode\n", __func__);
+    if (resume && !ckpt_dir) {
+        fprintf(stderr, "[E::%s] '--resume' option requires '--checkpoint-dir'\n", __func__);
         exit(EXIT_FAILURE);
     }
 
-    if (input_asg && is_fifo(argv[opt.ind])) {
-        fprintf(stderr, "[E::%s] STDIN input is not compatible with '-G' option\n", __func__);
+    if (ckpt_dir && n_sweep > 0) {
+        fprintf(stderr, "[E::%s] '--checkpoint-dir' option is not compatible with '--sweep-c'\n", __func__);
         exit(EXIT_FAILURE);
     }
 
-    if (min_len < 0) min_len = mini_circle? 5000 : 10000;
+    if (n_recruit > 0 && (!bait_file || ckpt_dir || n_sweep > 0)) {
+        fprintf(stderr, "[E::%s] '--recruit-round' option requires '--bait' and is not compatible with '--checkpoint-dir' or '--sweep-c'\n", __func__);
+        exit(EXIT_FAILURE);
+    }
 
-    /*** parse output dirname and basename ***/
-    char *outdir, *outname;
-    int free_outdir, free_outname;
-    parse_pathname(out, &outdir, &outname);
-    free_outdir = free_outname = 0;
-    if (!outdir) {
-        outdir = ".";
-        fprintf(stderr, "[W::%s] invalid output directory - using '%s' instead\n", __func__, outdir);
-    } else {
-        make_dir(outdir);
-        free_outdir = 1;
+    if (bait_file && !is_file(bait_file)) {
+        fprintf(stderr, "[E::%s] bait file does not exist: %s\n", __func__, bait_file);
+        exit(EXIT_FAILURE);
     }
-    if (!outname) {
-        outname = "oatk.asm";
-        fprintf(stderr, "[W::%s] invalid output name prefix - using '%s' instead\n", __func__, outname);
-    } else {
-        free_outname = 1;
+
+    if (n_sweep > 0 && (mini_circle || input_asg)) {
+        fprintf(stderr, "[E::%s] '--sweep-c' option is not compatible with '-M' or '-G' option\n", __func__);
+        exit(EXIT_FAILURE);
     }
 
-    int outlen = strlen(outdir) + strlen(outname) + 4;
-    char *outpref;
-    MYMALLOC(outpref, outlen);
-    sprintf(outpref, "%s/%s", outdir, outname);
+    if (mini_circle && n_db > 1) {
+        fprintf(stderr, "[E::%s] only one HMM profile database (-m or -p) allowed for mini-circle mode\n", __func__);
+        exit(EXIT_FAILURE);
+    }
 
-    /*** syncasm assembly ***/
-    scg_meta_t *scg_meta;
-    char *asg_file;
-    MYCALLOC(scg_meta, 1);
-    if (input_asg) {
-        MYMALLOC(asg_file, strlen(argv[opt.ind]) + 1);
-        sprintf(asg_file, "%s", argv[opt.ind]);
-        fprintf(stderr, "[M::%s] using user input assembly graph file: %s\n", __func__, asg_file);
-    } else {
-        ret = syncasm(argv + opt.ind, argc - opt.ind, m_data, k, s, bubble_size, tip_size, min_k_cov, min_a_cov_f, weak_cross, do_ec, do_unzip, n_threads, outpref, scg_meta, VERBOSE);
-        if (ret) {
-            fprintf(stderr, "[E::%s] syncasm assembly program failed\n", __func__);
-            exit(EXIT_FAILURE);
-        }
-        MYMALLOC(asg_file, outlen + 16);
-        sprintf(asg_file, "%s.utg.final.gfa", outpref);
+    if (manifest && argc > opt.ind) {
+        fprintf(stderr, "[E::%s] input files are given in the manifest with '--manifest' option\n", __func__);
+        exit(EXIT_FAILURE);
     }
 
-    /*** hmm annotation ***/
-    char *mito_annot, *pltd_annot;
-    mito_annot = pltd_annot = 0;
-    check_executable(nhmmscan); // check if nhmmscan executable is available
-    int rm_tmpdir, free_tmpdir; // make temp dir if not provided or existed
-    rm_tmpdir = free_tmpdir = 0;
-    if (tmpdir) {
-        rm_tmpdir = make_dir(tmpdir);
-    } else {
-        char *file_template;
-        MYMALLOC(file_template, outlen + 16);
-        sprintf(file_template, "%s/%s", outdir, "tmp_XXXXXXXXXX");
-        tmpdir = mkdtemp(file_template);
-        rm_tmpdir = 1;
-        free_tmpdir = 1;
-    }
-    if (mito_db) {    
-        FILE *fo;
-        MYMALLOC(mito_annot, outlen + 16);
-        sprintf(mito_annot, "%s.annot_mito.txt", outpref);
-        fo = fopen(mito_annot, "w");
-        ret  = hmm_annotate(&asg_file, 1, nhmmscan, mito_db, fo, batch_size, n_threads * 5, n_threads, tmpdir);
-        fclose(fo);
-    }
-    if (pltd_db) {
-        FILE *fo;
-        MYMALLOC(pltd_annot, outlen + 16);
-        sprintf(pltd_annot, "%s.annot_pltd.txt", outpref);
-        fo = fopen(pltd_annot, "w");
-        ret |= hmm_annotate(&asg_file, 1, nhmmscan, pltd_db, fo, batch_size, n_threads * 5, n_threads, tmpdir);
-        fclose(fo);
+    if (manifest && input_asg) {
+        fprintf(stderr, "[E::%s] '--manifest' option is not compatible with '-G' option\n", __func__);
+        exit(EXIT_FAILURE);
     }
-    if (ret) {
-        fprintf(stderr, "[E::%s] annotation program failed\n", __func__);
+
+    if (n_jobs < 1 || mem_budget < 0) {
+        fprintf(stderr, "[E::%s] invalid '--jobs' or '--mem-budget' value\n", __func__);
         exit(EXIT_FAILURE);
     }
-    
-    /*** pathfinder ***/
-    if (mini_circle) // pathfinder in mini-circle mode
-        ret = pathfinder_minicircle(asg_file, mito_db? mito_annot : pltd_annot, scg_meta, min_len, ext_p, max_copy, 
-                max_eval, min_score, min_cf, seq_cf, no_trn, no_rrn, do_graph_clean, bubble_size, 
-                tip_size, weak_cross, out_s, outpref, n_threads, VERBOSE);
-    else // pathfinder in normal mode
-        ret = pathfinder(asg_file, mito_annot, pltd_annot, min_len, ext_p, ext_m, max_copy, 
-                max_eval, min_score, min_cf, seq_cf, no_trn, no_rrn, do_graph_clean, bubble_size, 
-                tip_size, weak_cross, out_s, outpref, VERBOSE);
 
-    /*** final clean ***/
-    if (rm_tmpdir) rmdir(tmpdir); // should be empty
-    if (free_tmpdir) free(tmpdir);
-    if (free_outdir) free(outdir);
-    if (free_outname) free(outname);
-    free(mito_annot);
-    free(pltd_annot);
-    free(asg_file);
-    free(outpref);
-    scg_meta_destroy(scg_meta);
+    if (min_bait < 1 || n_recruit < 0) {
+        fprintf(stderr, "[E::%s] invalid '--min-bait' or '--recruit-round' value\n", __func__);
+        exit(EXIT_FAILURE);
+    }
 
-    if (ret) {
-        fprintf(stderr, "[E::%s] pathfinder program failed\n", __func__);
+    if (!manifest && input_asg && is_fifo(argv[opt.ind])) {
+        fprintf(stderr, "[E::%s] STDIN input is not compatible with '-G' option\n", __func__);
         exit(EXIT_FAILURE);
     }
 
+    if (min_len < 0) min_len = mini_circle? 5000 : 10000;
+
+    check_executable(nhmmscan); // check if nhmmscan executable is available
+
+    oatk_opt_t o;
+    memset(&o, 0, sizeof(o));
+    o.k = k, o.s = s, o.bubble_size = bubble_size, o.tip_size = tip_size, o.min_k_cov = min_k_cov;
+    o.sweep_c = sweep_c, o.n_sweep = n_sweep, o.do_ec = do_ec, o.do_unzip = do_unzip, o.out_bin = out_bin;
+    o.bait_file = bait_file, o.min_bait = min_bait, o.n_recruit = n_recruit;
+    o.resume = resume, o.min_a_cov_f = min_a_cov_f, o.weak_cross = weak_cross, o.m_data = m_data;
+    o.nhmmscan = nhmmscan, o.mito_db = mito_db, o.pltd_db = pltd_db, o.tmpdir = tmpdir, o.cache_dir = cache_dir;
+    o.pf_ref = pf_ref, o.batch_size = batch_size, o.stream = stream, o.pf_min = pf_min;
+    o.out_s = out_s, o.max_copy = max_copy, o.min_len = min_len, o.ext_p = ext_p, o.ext_m = ext_m;
+    o.no_trn = no_trn, o.no_rrn = no_rrn, o.do_graph_clean = do_graph_clean;
+    o.max_eval = max_eval, o.min_score = min_score, o.min_cf = min_cf, o.seq_cf = seq_cf;
+    o.mini_circle = mini_circle, o.input_asg = input_asg, o.gfa_tag = ec_tag || kc_tag || sc_tag;
+    o.n_threads = n_threads;
+
+    if (manifest) {
+        oatk_sample_t *samples;
+        int n_sample, rm_tmpdir;
+        samples = oatk_manifest_read(manifest, &n_sample);
+        if (samples == 0) exit(EXIT_FAILURE);
+        rm_tmpdir = 0;
+        if ((tmpdir && (rm_tmpdir = make_dir(tmpdir)) < 0) || (ckpt_dir && make_dir(ckpt_dir) < 0)) {
+            oatk_sample_destroy(samples, n_sample);
+            exit(EXIT_FAILURE);
+        }
+        o.batch = 1;
+        ret = oatk_batch(&o, samples, n_sample, n_jobs, mem_budget, out, ckpt_dir);
+        if (rm_tmpdir > 0) rmdir(tmpdir);
+        oatk_sample_destroy(samples, n_sample);
+    } else {
+        kt_ctx_t kc;
+        kt_ctx_init(&kc, n_threads);
+        ret = oatk_sample(&o, &kc, argv + opt.ind, argc - opt.ind, out, ckpt_dir, 0);
+        kt_ctx_destroy(&kc);
+    }
+    free(sweep_c);
+
     if (ret) {
         fprintf(stderr, "[E::%s] oatk program halted\n", __func__);
         exit(EXIT_FAILURE);
@@ -34,14 +34,21 @@
 #include <math.h>
 #include <float.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "khashl.h"
 #include "kstring.h"
 #include "kseq.h"
 #include "kvec.h"
 #include "kdq.h"
+#include "kthread.h"
 
 #include "path.h"
+#include "oagb.h"
+#include "gfai.h"
 #include "graph.h"
 #include "hmmannot.h"
 #include "misc.h"
@@ -52,47 +59,10 @@
 #undef DEBUG_SEG_COPY_EST
 #undef DEBUG_SEG_COV_BOUND
 #undef DEBUG_SEG_COV_ADJUST
-#undef DEBUG_BRUTE_FORCE_OPTIM
+#undef DEBUG_BNB_OPTIM
 #undef DEBUG_SIM_ANNEAL_OPTIM
 #undef DEBUG_PATH_FINDER
 
-typedef struct list_node {
-    uint32_t v; // sid << 31 | oriv
-    struct list_node *prev;
-    size_t n_m, n_n;
-    struct list_node **next;
-} llnode;
-
-typedef llnode* llnodep;
-
-static llnode *new_node(int v) {
-    llnode *node;
-    MYMALLOC(node, 1);
-    node->v = v;
-    node->n_m = 4;
-    node->n_n = 0;
-    node->prev = NULL;
-    MYMALLOC(node->next, node->n_m);
-    return node;
-}
-
-static void add_next(llnode *node, struct list_node *next)
-{
-    if (node->n_m == node->n_n)
-        MYEXPAND(node->next, node->n_m);
-    node->next[node->n_n] = next;
-    node->n_n++;
-}
-
-static void llnode_destroy(llnode *node)
-{
-    size_t i;
-    for (i = 0; i < node->n_n; ++i)
-        llnode_destroy(node->next[i]);
-    free(node->next);
-    free(node);
-}
-
 void path_destroy(path_t *path)
 {
     if (path->sid)
@@ -442,179 +412,458 @@ double graph_sequence_coverage_precise(asg_t *asg, double min_cf, int min_copy,
     return avg_cov;
 }
 
-#define DVAL(var) ((var)->D)
 // with BALANCE_IN_OUT defined
 // the objective function considers balanced indegree and outdegree
 #define BALANCE_IN_OUT
 #ifdef BALANCE_IN_OUT
-#define FVAL(fun) do { \
-    int __i, __n = (fun)->N; \
-    double __val[2] = {.0, .0}; \
-    for (__i = 0; __i < __n; ++__i) \
-        __val[(fun)->V[__i]&1] += DVAL((fun)->VAR[(fun)->V[__i]>>1]); \
-    (fun)->VAL = (fun)->weight * (fabs((fun)->v_exp - __val[0]) / 2 + \
-            fabs((fun)->v_exp - __val[1]) / 2 + \
-            fabs(__val[0] - __val[1])); \
-} while (0)
+#define FVAR(v) ((v)>>1) // the var of an element of V
+#define FSIDE(v) ((v)&1) // incoming or outgoing of an element of V
 #else
-#define FVAL(fun) do { \
-    int __i, __n = (fun)->N; \
-    double __val = (fun)->v_exp; \
-    for (__i = 0; __i < __n; ++__i) \
-        __val -= DVAL((fun)->VAR[(fun)->V[__i]]); \
-    (fun)->VAL = (fun)->weight * __val * __val; \
-} while (0)
+#define FVAR(v) (v)
+#define FSIDE(v) 0
 #endif
 
-typedef struct var {
-    int B, D;
-    struct var *prev, *next;
-} var_t;
-
 typedef struct {
     double weight; // weight
     double v_exp; // expected value
-    var_t **VAR;
     int N, *V;
-    double VAL;
 } func_t;
 
-#define BRUTE_FORCE_N_LIM 100000000
+#define BRUTE_FORCE_N_LIM 100000000 // solution space size below which the exact search runs without a node limit
+#define BNB_NODE_LIM      10000000  // maximum number of search nodes for larger solution spaces
 
-static inline double fvals(func_t *funcs, int n_func)
+// objective function value with the variable values in x
+static inline double fval_x(func_t *fun, const int *x)
+{
+    int i, n = fun->N;
+#ifdef BALANCE_IN_OUT
+    double val[2] = {.0, .0};
+    for (i = 0; i < n; ++i)
+        val[fun->V[i]&1] += x[fun->V[i]>>1];
+    return fun->weight * (fabs(fun->v_exp - val[0]) / 2 + fabs(fun->v_exp - val[1]) / 2 + fabs(val[0] - val[1]));
+#else
+    double val = fun->v_exp;
+    for (i = 0; i < n; ++i)
+        val -= x[fun->V[i]];
+    return fun->weight * val * val;
+#endif
+}
+
+static inline double fvals_x(func_t *funcs, int n_func, const int *x)
 {
     int i;
     double fval = 0.;
-    for (i = 0; i < n_func; ++i) {
-        FVAL(&funcs[i]);
-        fval += funcs[i].VAL;
-    }
+    for (i = 0; i < n_func; ++i)
+        fval += fval_x(&funcs[i], x);
     return fval;
 }
 
-static inline void copy_results(var_t **vars, int n_var, int *res)
+// lower bound of an objective function
+// given the sum of each side is in the range [lo, hi]
+static inline double fval_lb(func_t *fun, const double *lo, const double *hi)
 {
-    int i;
-    for (i = 0; i < n_var; ++i)
-        res[i] = vars[i]->D;
+#ifdef BALANCE_IN_OUT
+    // the function is convex and piecewise linear in the two sums
+    // so the minimum over the box is at one of the breakpoints
+    double c[5], a, b, v, m;
+    int i, j;
+    c[0] = lo[0], c[1] = hi[0], c[2] = lo[1], c[3] = hi[1], c[4] = fun->v_exp;
+    m = DBL_MAX;
+    for (i = 0; i < 5; ++i) {
+        a = c[i];
+        if (a < lo[0] || a > hi[0]) continue;
+        for (j = 0; j < 5; ++j) {
+            b = c[j];
+            if (b < lo[1] || b > hi[1]) continue;
+            v = fabs(fun->v_exp - a) / 2 + fabs(fun->v_exp - b) / 2 + fabs(a - b);
+            if (v < m) m = v;
+        }
+    }
+    return fun->weight * m;
+#else
+    double d;
+    d = fun->v_exp < lo[0]? lo[0] - fun->v_exp : fun->v_exp > hi[0]? fun->v_exp - hi[0] : 0.;
+    return fun->weight * d * d;
+#endif
+}
+
+typedef struct {
+    func_t *funcs;
+    int n_func;
+    uint32_t *o_idx, *o_a; // occurrences (function index << 1 | side) of each var: o_a[o_idx[i]..o_idx[i+1]-1]
+    double *lo, *hi; // range of the sum of each function side: [f<<1|s]
+    double *fb; // lower bound of each function
+    double cur; // sum of fb
+} bnb_t;
+
+// move the range of the var i from [lo0, hi0] to [lo1, hi1] and update the bounds
+static inline void bnb_update(bnb_t *b, int i, int lo0, int hi0, int lo1, int hi1)
+{
+    uint32_t k, f;
+    double nb;
+    for (k = b->o_idx[i]; k < b->o_idx[i+1]; ++k) {
+        f = b->o_a[k];
+        b->lo[f] += lo1 - lo0;
+        b->hi[f] += hi1 - hi0;
+    }
+    for (k = b->o_idx[i]; k < b->o_idx[i+1]; ++k) {
+        f = b->o_a[k] >> 1;
+        nb = fval_lb(&b->funcs[f], &b->lo[f<<1], &b->hi[f<<1]);
+        b->cur += nb - b->fb[f];
+        b->fb[f] = nb;
+    }
 }
 
-// brute force optimization
-static void estimate_arc_copy_number_brute_force_impl(func_t *funcs, int n_func, var_t **vars, int n_var, int *res, int64_t sol_space_size)
+// vars in the breadth-first order of the var-function graph
+// so that functions are fully fixed early in the search
+static void bnb_locality_order(bnb_t *b, int n_var, int *order)
 {
-    double fval, m_fval;
-    int64_t sol;
-    int a, v;
-    fval = fvals(funcs, n_func);
-    m_fval = fval;
-    copy_results(vars, n_var, res);
-    sol = 0;
-    while (++sol < sol_space_size) {
-        a = 1, v = 0;
-        while (a) {
-            vars[v] = vars[v]->next;
-            a = !vars[v]->B;
-            ++v;
+    int i, j, n, s, v, w, f, *seen, *fseen;
+    uint32_t k;
+    MYCALLOC(seen, n_var);
+    MYCALLOC(fseen, b->n_func);
+    n = 0;
+    for (s = 0; s < n_var; ++s) {
+        if (seen[s]) continue;
+        seen[s] = 1;
+        order[n++] = s;
+        for (i = n - 1; i < n; ++i) {
+            v = order[i];
+            for (k = b->o_idx[v]; k < b->o_idx[v+1]; ++k) {
+                f = b->o_a[k] >> 1;
+                if (fseen[f]) continue;
+                fseen[f] = 1;
+                for (j = 0; j < b->funcs[f].N; ++j) {
+                    w = FVAR(b->funcs[f].V[j]);
+                    if (seen[w]) continue;
+                    seen[w] = 1;
+                    order[n++] = w;
+                }
+            }
         }
-        fval = fvals(funcs, n_func);
-        if (fval < m_fval) {
-            m_fval = fval;
-            copy_results(vars, n_var, res);
+    }
+    free(seen);
+    free(fseen);
+}
+
+// branch-and-bound optimization
+// by default vars are enumerated in the same order as an odometer with the first var changing fastest
+// and a solution replaces the current best only if it is strictly better
+// so the result is the same as an exhaustive search in that order
+// with reorder set vars are enumerated in the locality order instead
+// if m_fval is given then res holds a solution of this value to improve on
+// return 0 if the search is complete and 1 if it stopped at the node limit
+static int estimate_arc_copy_number_bnb_impl(func_t *funcs, int n_func, const int *lb, const int *ub, int n_var, int *res,
+        double m_fval, int reorder, int64_t node_lim)
+{
+    int i, j, k, v, *x, *order, ret;
+    uint32_t f, *n_a;
+    int64_t n_node;
+    double fval, tol;
+    bnb_t b;
+
+    if (n_var <= 0 || n_func <= 0) return 0;
+    b.funcs = funcs;
+    b.n_func = n_func;
+    // build the var-to-function occurrence index
+    MYCALLOC(b.o_idx, n_var + 1);
+    for (i = 0; i < n_func; ++i)
+        for (j = 0; j < funcs[i].N; ++j)
+            ++b.o_idx[FVAR(funcs[i].V[j]) + 1];
+    for (i = 0; i < n_var; ++i)
+        b.o_idx[i+1] += b.o_idx[i];
+    MYMALLOC(b.o_a, b.o_idx[n_var]);
+    MYCALLOC(n_a, n_var);
+    for (i = 0; i < n_func; ++i) {
+        for (j = 0; j < funcs[i].N; ++j) {
+            v = FVAR(funcs[i].V[j]);
+            b.o_a[b.o_idx[v] + n_a[v]++] = (uint32_t) i << 1 | FSIDE(funcs[i].V[j]);
+        }
+    }
+    free(n_a);
+
+    // all vars are free at the start
+    MYCALLOC(b.lo, (size_t) n_func * 2);
+    MYCALLOC(b.hi, (size_t) n_func * 2);
+    MYMALLOC(b.fb, n_func);
+    for (i = 0; i < n_var; ++i) {
+        for (f = b.o_idx[i]; f < b.o_idx[i+1]; ++f) {
+            b.lo[b.o_a[f]] += lb[i];
+            b.hi[b.o_a[f]] += ub[i];
+        }
+    }
+    b.cur = 0.;
+    for (i = 0; i < n_func; ++i) {
+        b.fb[i] = fval_lb(&funcs[i], &b.lo[i<<1], &b.hi[i<<1]);
+        b.cur += b.fb[i];
+    }
+
+    MYMALLOC(x, n_var);
+    MYMALLOC(order, n_var);
+    // depth k fixes the var order[k]
+    if (reorder) {
+        bnb_locality_order(&b, n_var, order);
+    } else {
+        for (i = 0; i < n_var; ++i)
+            order[i] = n_var - 1 - i;
+    }
+    tol = m_fval < DBL_MAX? m_fval * 1e-9 : 0.;
+    n_node = 0;
+    ret = 0;
+    k = 0;
+    v = order[0];
+    x[v] = lb[v];
+    bnb_update(&b, v, lb[v], ub[v], x[v], x[v]);
+    while (k >= 0) {
+        ++n_node;
+        // a small tolerance absorbs the rounding errors accumulated by the bound updates
+        if (b.cur < m_fval - tol) {
+            if (k < n_var - 1) {
+                // go down
+                ++k;
+                v = order[k];
+                x[v] = lb[v];
+                bnb_update(&b, v, lb[v], ub[v], x[v], x[v]);
+                continue;
+            }
+            fval = fvals_x(funcs, n_func, x);
+            if (fval < m_fval) {
+                m_fval = fval;
+                tol = m_fval * 1e-9;
+                memcpy(res, x, sizeof(int) * n_var);
+                if (fabs(m_fval) < FLT_EPSILON)
+                    break;
+            }
         }
-        if (fabs(m_fval) < FLT_EPSILON)
+        if (node_lim > 0 && n_node >= node_lim) {
+            ret = 1;
             break;
+        }
+        // go to the next value or go up
+        while (k >= 0) {
+            v = order[k];
+            if (x[v] < ub[v]) {
+                bnb_update(&b, v, x[v], x[v], x[v] + 1, x[v] + 1);
+                ++x[v];
+                break;
+            }
+            bnb_update(&b, v, x[v], x[v], lb[v], ub[v]);
+            --k;
+        }
     }
-#ifdef DEBUG_BRUTE_FORCE_OPTIM
-    fprintf(stderr, "[DEBUG_BRUTE_FORCE_OPTIM::%s] brute force search finished after %ld/%ld attempts with a minimum fval: %.6f\n",
-            __func__, sol, sol_space_size, m_fval);
+
+    if (m_fval == DBL_MAX) // no leaf reached within the node limit
+        memcpy(res, lb, sizeof(int) * n_var);
+#ifdef DEBUG_BNB_OPTIM
+    fprintf(stderr, "[DEBUG_BNB_OPTIM::%s] branch-and-bound search %s after %ld nodes with a minimum fval: %.6f\n",
+            __func__, ret? "stopped" : "finished", n_node, m_fval);
 #endif
+
+    free(x);
+    free(order);
+    free(b.o_idx);
+    free(b.o_a);
+    free(b.lo);
+    free(b.hi);
+    free(b.fb);
+
+    return ret;
 }
 
 #define SA_TEMPERATURE  1000
 #define SA_COOLING_RATE .999
 #define SA_MAX_ATTEMPTS 100
 #define SA_RESTART_TEMP .99
+#define SA_N_START      8 // number of independent starts; fixed so that the result does not depend on the thread number
 
-static inline void random_walk_to_neighbour(var_t **var)
+// splitmix64; each start has its own state
+static inline uint64_t sa_rand(uint64_t *s)
 {
-    if (rand() < RAND_MAX>>1) {
-        // move to prev
-        *var = (*var)->B == 0? (*var)->next : (*var)->prev;
-    } else {
-        // move to next
-        *var = (*var)->next->B == 0? (*var)->prev : (*var)->next;
-    }
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline double sa_drand(uint64_t *s)
+{
+    return (sa_rand(s) >> 11) * (1. / 9007199254740992.);
 }
 
-static void set_vars(var_t **vars, int n_var, int *res)
+typedef struct {
+    func_t *funcs;
+    int n_func, n_var;
+    const int *lb, *ub; // domain of each variable
+    uint32_t *f_idx, *f_a; // functions involving each variable: f_a[f_idx[i]..f_idx[i+1]-1]
+    uint32_t max_deg;
+    int *res; // solution of each start
+    double *cost; // cost of each start
+} sa_shared_t;
+
+static inline double sa_fvals(sa_shared_t *sa, const int *x, double *fv)
 {
     int i;
-    for (i = 0; i < n_var; ++i) {
-        while (vars[i]->D != res[i])
-            vars[i] = vars[i]->next;
+    double fval = 0.;
+    for (i = 0; i < sa->n_func; ++i) {
+        fv[i] = fval_x(&sa->funcs[i], x);
+        fval += fv[i];
     }
+    return fval;
 }
 
-// simulated annealing optimization
-static void estimate_arc_copy_number_siman_impl(func_t *funcs, int n_func, var_t **vars, int n_var, int *res)
+static void siman_worker_for(void *_data, long r, int tid) // kt_for() callback
 {
-    int i, iter, n_iter;
-    double optim_cost, current_cost, new_cost, temp0, temp, p;
-    var_t *var;
+    sa_shared_t *sa = (sa_shared_t *) _data;
+    int i, j, n_var, old, d, *x, *res;
+    uint32_t k, f;
+    double optim_cost, current_cost, delta, temp0, temp, *fv, *nv;
+    uint64_t seed;
+#ifdef DEBUG_SIM_ANNEAL_OPTIM
+    int n_iter = 0;
+#endif
 
-    current_cost = fvals(funcs, n_func);
+    n_var = sa->n_var;
+    res = &sa->res[r * n_var];
+    MYMALLOC(x, n_var);
+    MYMALLOC(fv, sa->n_func);
+    MYMALLOC(nv, sa->max_deg + 1);
+
+    seed = 1234 + r;
+    // the first start is from the lower bounds and the others from random points
+    for (i = 0; i < n_var; ++i)
+        x[i] = r == 0? sa->lb[i] : sa->lb[i] + sa_rand(&seed) % (sa->ub[i] - sa->lb[i] + 1);
+    current_cost = sa_fvals(sa, x, fv);
     optim_cost = current_cost;
-    copy_results(vars, n_var, res);
-    
-    srand(1234);
+    memcpy(res, x, sizeof(int) * n_var);
+
     temp0 = SA_TEMPERATURE;
-    n_iter = 0;
-    for (iter = 0; iter < SA_MAX_ATTEMPTS; ++iter) {
+    for (j = 0; j < SA_MAX_ATTEMPTS; ++j) {
         temp = temp0;
         while (temp > 1e-6) {
-            // random select a var to update 
-            i = rand() % n_var;
-            // record the old var
-            var = vars[i];
-            // take a random walk to either prev or next
-            random_walk_to_neighbour(&vars[i]);
-            // calculate new cost
-            new_cost = fvals(funcs, n_func);
+            // random select a var to update
+            i = sa_rand(&seed) % n_var;
+            old = x[i];
+            // take a random walk to either prev or next, reflected at the domain boundaries
+            d = sa_rand(&seed) >> 63? 1 : -1;
+            x[i] = old + d;
+            if (x[i] < sa->lb[i] || x[i] > sa->ub[i]) x[i] = old - d;
+            if (x[i] < sa->lb[i] || x[i] > sa->ub[i]) x[i] = old;
+            // only the functions involving the var change
+            delta = 0.;
+            for (k = sa->f_idx[i]; k < sa->f_idx[i+1]; ++k) {
+                f = sa->f_a[k];
+                nv[k - sa->f_idx[i]] = fval_x(&sa->funcs[f], x);
+                delta += nv[k - sa->f_idx[i]] - fv[f];
+            }
             // record optim solution
-            if (new_cost < optim_cost) {
-                optim_cost = new_cost;
-                copy_results(vars, n_var, res);
+            if (current_cost + delta < optim_cost) {
+                optim_cost = current_cost + delta;
+                memcpy(res, x, sizeof(int) * n_var);
             }
             // acceptance probability
-            p = exp(-(new_cost - current_cost) / temp);
-            if (new_cost < current_cost || (double) rand() / RAND_MAX < p) {
+            if (delta <= 0 || sa_drand(&seed) < exp(-delta / temp)) {
                 // accept update and update cost
-                current_cost = new_cost;
+                current_cost += delta;
+                for (k = sa->f_idx[i]; k < sa->f_idx[i+1]; ++k)
+                    fv[sa->f_a[k]] = nv[k - sa->f_idx[i]];
             } else {
                 // rollback to reject the update
-                vars[i] = var;
+                x[i] = old;
             }
             // cooling down
             temp *= SA_COOLING_RATE;
+#ifdef DEBUG_SIM_ANNEAL_OPTIM
             ++n_iter;
+#endif
         }
-        if (optim_cost == 0) break;
         // continue searching from the best solution so far
+        // a full evaluation also clears the rounding errors accumulated by the deltas
+        memcpy(x, res, sizeof(int) * n_var);
+        current_cost = optim_cost = sa_fvals(sa, x, fv);
+        if (fabs(optim_cost) < FLT_EPSILON) break;
         temp0 *= SA_RESTART_TEMP;
-        set_vars(vars, n_var, res);
+    }
+    sa->cost[r] = optim_cost;
+
 #ifdef DEBUG_SIM_ANNEAL_OPTIM
-        fprintf(stderr, "[DEBUG_SIM_ANNEAL_OPTIM::%s] optimization after %d iteration [%d attempts] with a minimum fval: %.6f\n",
-                __func__, iter, n_iter, optim_cost);
+    fprintf(stderr, "[DEBUG_SIM_ANNEAL_OPTIM::%s] start %ld finished after %d attempts with a minimum fval: %.6f\n",
+            __func__, r, n_iter, optim_cost);
 #endif
 
+    free(x);
+    free(fv);
+    free(nv);
+}
+
+// simulated annealing optimization
+// independent starts run in parallel and the best solution is kept
+static double estimate_arc_copy_number_siman_impl(func_t *funcs, int n_func, const int *lb, const int *ub, int n_var, int *res, const kt_ctx_t *kc)
+{
+    int i, j, r, b;
+    uint32_t k, v, last;
+    double cost;
+    sa_shared_t sa;
+
+    if (n_var <= 0) return 0.;
+    sa.funcs = funcs;
+    sa.n_func = n_func;
+    sa.n_var = n_var;
+    sa.lb = lb;
+    sa.ub = ub;
+
+    // build the var-to-function incidence index
+    MYCALLOC(sa.f_idx, n_var + 1);
+    for (i = 0; i < n_func; ++i)
+        for (j = 0; j < funcs[i].N; ++j)
+            ++sa.f_idx[FVAR(funcs[i].V[j]) + 1];
+    for (i = 0; i < n_var; ++i)
+        sa.f_idx[i+1] += sa.f_idx[i];
+    MYMALLOC(sa.f_a, sa.f_idx[n_var]);
+    uint32_t *n_a;
+    MYCALLOC(n_a, n_var);
+    for (i = 0; i < n_func; ++i) {
+        for (j = 0; j < funcs[i].N; ++j) {
+            v = FVAR(funcs[i].V[j]);
+            last = sa.f_idx[v] + n_a[v];
+            // a function may involve a var more than once
+            if (n_a[v] == 0 || sa.f_a[last - 1] != (uint32_t) i)
+                sa.f_a[sa.f_idx[v] + n_a[v]++] = i;
+        }
     }
+    // compact the index
+    for (i = 0, k = 0; i < n_var; ++i) {
+        memmove(&sa.f_a[k], &sa.f_a[sa.f_idx[i]], sizeof(uint32_t) * n_a[i]);
+        sa.f_idx[i] = k;
+        k += n_a[i];
+    }
+    sa.f_idx[n_var] = k;
+    sa.max_deg = 0;
+    for (i = 0; i < n_var; ++i)
+        sa.max_deg = MAX(sa.max_deg, n_a[i]);
+    free(n_a);
+
+    MYMALLOC(sa.res, (size_t) SA_N_START * n_var);
+    MYMALLOC(sa.cost, SA_N_START);
+    kt_ctx_for(kc, siman_worker_for, &sa, SA_N_START);
+
+    for (r = 1, b = 0; r < SA_N_START; ++r)
+        if (sa.cost[r] < sa.cost[b]) b = r;
+    memcpy(res, &sa.res[b * n_var], sizeof(int) * n_var);
 #ifdef DEBUG_SIM_ANNEAL_OPTIM
-    fprintf(stderr, "[DEBUG_SIM_ANNEAL_OPTIM::%s] simulated annealing search finished after %d attempts with a minimum fval: %.6f\n",
-            __func__, n_iter, optim_cost);
+    fprintf(stderr, "[DEBUG_SIM_ANNEAL_OPTIM::%s] simulated annealing search finished with a minimum fval: %.6f\n",
+            __func__, sa.cost[b]);
 #endif
+
+    cost = sa.cost[b];
+    free(sa.f_idx);
+    free(sa.f_a);
+    free(sa.res);
+    free(sa.cost);
+
+    return cost;
 }
 
-int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage, double *_adjusted_cov, int *copy_number, int max_copy, int max_round)
+int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage, double *_adjusted_cov, int *copy_number, int max_copy, int max_round, const kt_ctx_t *kc)
 {
     uint32_t i, j, n_seg, n_group, a_g, *arc_group;
     uint64_t link_id;
@@ -660,7 +909,8 @@ int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage,
     }
 #endif
 
-    uint32_t *arc_copy_lb, *arc_copy_ub, vlb, wlb, lb, ub;
+    int *arc_copy_lb, *arc_copy_ub;
+    uint32_t vlb, wlb, lb, ub;
     MYCALLOC(arc_copy_lb, n_group); // arc copy number lower bound
     MYCALLOC(arc_copy_ub, n_group); // arc copy number upper bound
 
@@ -682,32 +932,8 @@ int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage,
         lb = (uint32_t) ((double) lb * 2 / 3);
         ub = (uint32_t) ((double) ub * 4 / 3) + 1;
         ub = MIN(ub, (uint32_t) max_copy);
-        arc_copy_lb[a_g] = MIN(lb, arc_copy_lb[a_g]);
-        arc_copy_ub[a_g] = MAX(ub, arc_copy_ub[a_g]);
-    }
-
-    // make variable list
-    var_t **VAR;
-    MYCALLOC(VAR, n_group);
-    for (i = 0; i < n_group; ++i) {
-        var_t *var0;
-        MYCALLOC(var0, 1);
-        lb = arc_copy_lb[i];
-        ub = arc_copy_ub[i];
-        var0->B = 0;
-        var0->D = lb;
-        VAR[i] = var0;
-        for (j = 1; j <= ub - lb; ++j) {
-            var_t *var1;
-            MYCALLOC(var1, 1);
-            var1->B = j;
-            var1->D = lb + j;
-            var0->next = var1;
-            var1->prev = var0;
-            var0 = var1;
-        }
-        var0->next = VAR[i];
-        VAR[i]->prev = var0;
+        arc_copy_lb[a_g] = MIN((int) lb, arc_copy_lb[a_g]);
+        arc_copy_ub[a_g] = MAX((int) ub, arc_copy_ub[a_g]);
     }
 
     // make objective function list
@@ -747,10 +973,8 @@ int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage,
             kv_pushp(func_t, funcs, &FUN);
             FUN->weight = log10(g->vtx[i].len);
             FUN->v_exp = g->vtx[i].cov / seq_coverage; // copy_number[i];
-            FUN->VAR = VAR;
             FUN->N = V.n;
             FUN->V = V.a;
-            FUN->VAL = 0.;
         }
 #else
         for (k = 0; k < 2; ++k) {
@@ -772,10 +996,8 @@ int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage,
                 kv_pushp(func_t, funcs, &FUN);
                 FUN->weight = log10(g->vtx[i].len);
                 FUN->v_exp = g->vtx[i].cov / seq_coverage; // copy_number[i];
-                FUN->VAR = VAR;
                 FUN->N = V.n;
                 FUN->V = V.a;
-                FUN->VAL = 0.;
             }
         }
 #endif
@@ -783,7 +1005,7 @@ int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage,
 
     // do optimization
     int *arc_copy;
-    double adjusted_cov, min_avg_cov;
+    double fval, adjusted_cov, min_avg_cov;
     int64_t sol_space_size;
     
     min_avg_cov = graph_sequence_coverage_lower_bound(asg, 0.3);
@@ -800,24 +1022,28 @@ int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage,
         fprintf(stderr, "[DEBUG_SEG_COV_ADJUST::%s] adjusting copy number round %d of %d\n", __func__, round, max_round);
 #endif
         if (sol_space_size <= BRUTE_FORCE_N_LIM) {
-            // do brute force optimization
+            // do branch-and-bound optimization
+            // exact and the same solution as an exhaustive search
 #ifdef DEBUG_SEG_COV_ADJUST
-            fprintf(stderr, "[DEBUG_SEG_COV_ADJUST::%s] run brute force searching: %ld\n",
+            fprintf(stderr, "[DEBUG_SEG_COV_ADJUST::%s] run branch-and-bound searching: %ld\n",
                     __func__, sol_space_size);
 #endif
-            estimate_arc_copy_number_brute_force_impl(funcs.a, funcs.n, VAR, n_group, arc_copy, sol_space_size);
+            estimate_arc_copy_number_bnb_impl(funcs.a, funcs.n, arc_copy_lb, arc_copy_ub, n_group, arc_copy, DBL_MAX, 0, 0);
         } else {
             // do simulated annealing optimization
+            // then improve on it by branch-and-bound with a node limit
+            // the solution is exact if the search completes
 #ifdef DEBUG_SEG_COV_ADJUST
             fprintf(stderr, "[DEBUG_SEG_COV_ADJUST::%s] run simulated annealing optimization: %ld\n",
                     __func__, sol_space_size);
 #endif
-            estimate_arc_copy_number_siman_impl(funcs.a, funcs.n, VAR, n_group, arc_copy);
+            fval = estimate_arc_copy_number_siman_impl(funcs.a, funcs.n, arc_copy_lb, arc_copy_ub, n_group, arc_copy, kc);
+            estimate_arc_copy_number_bnb_impl(funcs.a, funcs.n, arc_copy_lb, arc_copy_ub, n_group, arc_copy, fval, 1, BNB_NODE_LIM);
         }
 
 #ifdef DEBUG_SEG_COV_ADJUST
         for (i = 0; i < n_group; ++i)
-            fprintf(stderr, "[DEBUG_SEG_COV_ADJUST::%s] arc group %u optimum copy number %d [%u %u]\n",
+            fprintf(stderr, "[DEBUG_SEG_COV_ADJUST::%s] arc group %u optimum copy number %d [%d %d]\n",
                     __func__, i, arc_copy[i], arc_copy_lb[i], arc_copy_ub[i]);
 #endif
         // update average sequence coverage
@@ -872,13 +1098,6 @@ int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage,
             if (funcmap[i] == -1)
                 continue;
             funcs.a[funcmap[i]].v_exp = g->vtx[i].cov / adjusted_cov;
-            funcs.a[funcmap[i]].VAL = 0.;
-        }
-        // reset VARs
-        for (i = 0; i < n_group; ++i) {
-            var_t *var = VAR[i];
-            while (var->B) var = var->next;
-            VAR[i] = var;
         }
 
 #ifdef DEBUG_SEG_COV_ADJUST
@@ -946,21 +1165,6 @@ int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage,
         *_adjusted_cov = adjusted_cov;
 
 do_clean:
-    for (i = 0; i < n_group; ++i) {
-        var_t *var0, *var1;
-        var0 = VAR[i];
-        while (var0->B != 0)
-            var0 = var0->next;
-        var0 = var0->next;
-        v = 0;
-        while (!v) {
-            var1 = var0->next;
-            v = var0->B == 0;
-            free(var0);
-            var0 = var1;
-        }
-    }
-    free(VAR);
     for (i = 0; i < funcs.n; ++i)
         free(funcs.a[i].V);
     free(funcs.a);
@@ -1012,104 +1216,138 @@ kh_u32_t *sequence_duplication_by_copy_number(asg_t *asg, int *copy_number, int
     return seg_dups;
 }
 
-KDQ_INIT(llnodep)
+#define PATH_N_LIM 1000000
 
-static int path_contain_vertex(llnode *node, uint32_t v)
-{
-    int contained = 0;
-    while (node != NULL) {
-        if ((node->v >> 1) == (v >> 1)) {
-            contained = 1;
-            break;
-        }
-        node = node->prev;
-    }
+typedef struct {
+    uint32_t v; // vertex
+    uint32_t c_beg, c_end; // extensions not tried yet: ext[c_beg..c_end-1]
+} pe_frame_t;
 
-    return contained;
-}
+typedef struct {
+    kvec_t(uint32_t) v; // vertices of all paths concatenated
+    kvec_t(uint64_t) a; // offset << 32 | number of vertices of each path
+} pe_paths_t;
 
-#define PATH_N_LIM 1000000
+typedef struct {
+    kvec_t(pe_frame_t) stk; // the path being extended
+    kvec_t(uint32_t) ext; // accepted extensions of the frames in stk
+    kvec_t(uint32_t) dups;
+} pe_stack_t;
 
-static llnode **graph_path_extension(asmg_t *g, llnode *root, kh_u32_t *seg_dups, uint64_t *n_leaf, int *exceed_limit_)
+// add vertex w to the end of the path and collect its extensions
+// with the path fixed siblings never affect each other
+// so extensions can be collected when the vertex is added
+// return 1 if w is a leaf
+static int pe_push(asmg_t *g, pe_stack_t *s, uint32_t w, kh_u32_t *seg_dups, uint8_t *vis)
 {
-    uint64_t i, j, v, w, nv;
-    int skip, exceed_limit;
-    llnode *next_node, *node;
-    kdq_llnodep_t *node_q;
-    void *km;
+    uint64_t i, j, nv;
+    uint32_t v, c_beg;
+    int skip;
     asmg_arc_t *av;
     khint32_t k32;
+    pe_frame_t *f;
 
-    kvec_t(llnodep) leaf_node;
-    kvec_t(uint32_t) dups;
+    vis[w>>1] = 1;
+    c_beg = s->ext.n;
+    nv = asmg_arc_n(g, w);
+    av = asmg_arc_a(g, w);
+    s->dups.n = 0;
+    for (i = 0; i < nv; ++i) {
+        if (av[i].del) continue;
+        v = av[i].w;
+        if (vis[v>>1]) continue;
+        skip = 0;
+        k32 = kh_u32_get(seg_dups, v >> 1);
+        if (k32 < kh_end(seg_dups)) {
+            // dup seg
+            // check if already processed
+            for (j = 0; j < s->dups.n; ++j) {
+                if (s->dups.a[j] == kh_val(seg_dups, k32)) {
+                    skip = 1;
+                    break;
+                }
+            }
+            if (!skip)
+                kv_push(uint32_t, s->dups, kh_val(seg_dups, k32));
+        }
+        if (!skip)
+            kv_push(uint32_t, s->ext, v);
+    }
+    kv_pushp(pe_frame_t, s->stk, &f);
+    f->v = w;
+    f->c_beg = c_beg;
+    f->c_end = s->ext.n;
+    return c_beg == s->ext.n;
+}
 
-    kv_init(leaf_node);
-    kv_init(dups);
-    km = km_init();
-    node_q = kdq_init_llnodep(km);
+// depth-first enumeration of the maximal simple paths starting with the vertices in prefix
+// vis marks the segments in the current path so the containment check is O(1)
+// paths are appended to pp as compact vertex arrays
+// in the order of the leaves in a breadth-first search
+// return 1 if the number of paths exceeds n_lim and 0 otherwise
+static int graph_path_extension(asmg_t *g, uint32_t *prefix, uint32_t n_prefix, kh_u32_t *seg_dups, uint8_t *vis,
+        pe_paths_t *pp, uint64_t n_lim)
+{
+    uint64_t i, n0, n, *key, *a;
+    int exceed_limit, leaf;
+    pe_stack_t s;
+    pe_frame_t *f;
 
+    memset(&s, 0, sizeof(pe_stack_t));
     exceed_limit = 0;
-    *kdq_pushp_llnodep(node_q) = root;
-
-    while (kdq_size(node_q) > 0) {
-        node = *kdq_shift_llnodep(node_q);
-        v = node->v;
-        nv = asmg_arc_n(g, v);
-        av = asmg_arc_a(g, v);
-        dups.n = 0;
-        for (i = 0; i < nv; ++i) {
-            if (av[i].del) continue;
-
-            w = av[i].w;
-            skip = 0;
-            k32 = kh_u32_get(seg_dups, w >> 1);
-            if (k32 < kh_end(seg_dups)) {
-                // dup seg
-                // check if already processed
-                for (j = 0; j < dups.n; ++j) {
-                    if (dups.a[j] == kh_val(seg_dups, k32)) {
-                        skip = 1;
-                        break;
-                    }
-                }
-            }
+    n0 = pp->a.n;
+    for (i = 0; i + 1 < n_prefix; ++i) {
+        vis[prefix[i]>>1] = 1;
+        kv_pushp(pe_frame_t, s.stk, &f);
+        f->v = prefix[i];
+        f->c_beg = f->c_end = 0;
+    }
 
-            if (!skip && !path_contain_vertex(node, w)) {
-                next_node = new_node(w);
-                next_node->prev = node;
-                add_next(node, next_node);
-                *kdq_pushp_llnodep(node_q) = next_node;
-                
-                if (k32 < kh_end(seg_dups))
-                    kv_push(uint32_t, dups, kh_val(seg_dups, k32));
+    leaf = pe_push(g, &s, prefix[n_prefix-1], seg_dups, vis);
+    while (1) {
+        if (leaf) {
+            kv_push(uint64_t, pp->a, (uint64_t) pp->v.n << 32 | s.stk.n);
+            for (i = 0; i < s.stk.n; ++i)
+                kv_push(uint32_t, pp->v, s.stk.a[i].v);
+            if (pp->a.n > n_lim) {
+                exceed_limit = 1;
+                break;
             }
         }
-
-        if (node->n_n == 0) {
-            // leaf node
-            kv_push(llnodep, leaf_node, node);
-        }
-        
-        if (kdq_size(node_q) + leaf_node.n > PATH_N_LIM) {
-            exceed_limit = 1;
-            break;
+        // backtrack to the last frame with extensions left
+        while (s.stk.n >= n_prefix && s.stk.a[s.stk.n-1].c_beg == s.stk.a[s.stk.n-1].c_end) {
+            vis[s.stk.a[s.stk.n-1].v>>1] = 0;
+            --s.stk.n;
+            s.ext.n = s.stk.n > 0? s.stk.a[s.stk.n-1].c_end : 0;
         }
+        if (s.stk.n < n_prefix) break;
+        f = &s.stk.a[s.stk.n-1];
+        leaf = pe_push(g, &s, s.ext.a[f->c_beg++], seg_dups, vis);
     }
 
-    kdq_destroy_llnodep(node_q);
-    km_destroy(km);
-    kv_destroy(dups);
+    for (i = 0; i < s.stk.n; ++i)
+        vis[s.stk.a[i].v>>1] = 0;
 
-    if (exceed_limit) {
-        *n_leaf = 0;
-        *exceed_limit_ = 1;
-        kv_destroy(leaf_node);
-        return 0;
-    } else {
-        *n_leaf = leaf_node.n;
-        *exceed_limit_ = 0;
-        return leaf_node.a;
+    if (!exceed_limit && (n = pp->a.n - n0) > 1) {
+        // the depth-first order restricted to the same depth is the breadth-first order
+        // so a stable sort by the path size recovers the breadth-first order
+        MYMALLOC(key, n);
+        MYMALLOC(a, n);
+        for (i = 0; i < n; ++i)
+            key[i] = (uint64_t) (uint32_t) pp->a.a[n0 + i] << 32 | i;
+        qsort(key, n, sizeof(uint64_t), u64_cmpfunc);
+        for (i = 0; i < n; ++i)
+            a[i] = pp->a.a[n0 + (uint32_t) key[i]];
+        memcpy(&pp->a.a[n0], a, sizeof(uint64_t) * n);
+        free(key);
+        free(a);
     }
+
+    kv_destroy(s.stk);
+    kv_destroy(s.ext);
+    kv_destroy(s.dups);
+
+    return exceed_limit;
 }
 
 static inline void rev_array(uint32_t *arr, uint32_t n)
@@ -1195,11 +1433,12 @@ static uint64_t find_source_vtx(asmg_t *g, int use_max_scc)
 
 void graph_path_finder(asg_t *asg, kh_u32_t *seg_dups, path_v *paths, double sub_circ_minf, int is_pltd)
 {
-    uint64_t i, j, s, n_leaf;
+    uint64_t i, j, s, n1;
+    uint32_t *prefix;
+    uint8_t *vis;
     int circ, exceed_limit;
     asmg_t *g;
-    llnode *root, *next_node, *node, **leaves;
-    kvec_t(llnodep) leaf_node, root_node;
+    pe_paths_t pp1, pp;
 
     g = asg->asmg;
     
@@ -1208,70 +1447,45 @@ void graph_path_finder(asg_t *asg, kh_u32_t *seg_dups, path_v *paths, double sub
 
     if (s == UINT64_MAX) return;
 
-    kv_init(root_node);
-    kv_init(leaf_node);
+    memset(&pp1, 0, sizeof(pe_paths_t));
+    memset(&pp, 0, sizeof(pe_paths_t));
+    MYCALLOC(vis, g->n_vtx);
 
-    root = new_node(s << 1);
-    kv_push(llnodep, root_node, root);
-
-    n_leaf = 0;
-    exceed_limit = 0;
-    leaves = graph_path_extension(g, root, seg_dups, &n_leaf, &exceed_limit);
+    // a simple path contains each seg at most once
+    MYMALLOC(prefix, g->n_vtx);
+    prefix[0] = s << 1;
+    exceed_limit = graph_path_extension(g, prefix, 1, seg_dups, vis, &pp1, PATH_N_LIM);
     // for linear paths do extension from the other direction of root node
     // no - should do this even if the path is circular
-    // n_leaf will be zero if path number exceeds limit
-    for (i = 0; i < n_leaf; ++i) {
-        node = leaves[i];
-        // circ = asmg_arc1(g, node->v, s << 1) != 0;
-        // if (circ) {
-        //     kv_push(llnodep, leaf_node, node);
-        //     continue;
-        // }
-        
+    n1 = exceed_limit? 0 : pp1.a.n;
+    for (i = 0; i < n1; ++i) {
         // make a new path tracing back from leaf to root
-        root = new_node(node->v^1);
-        kv_push(llnodep, root_node, root);
-        while (node->prev != NULL) {
-            next_node = new_node(node->prev->v^1);
-            next_node->prev = root;
-            add_next(root, next_node);
-            root = next_node;
-            node = node->prev;
-        }
-
-        assert(root->v == (s<<1 | 1)); // should be always ended with seq s
-        uint64_t n = 0;
-        exceed_limit = 0;
-        llnode **tmp_nodes = graph_path_extension(g, root, seg_dups, &n, &exceed_limit);
-        
-        for (j = 0; j < n; ++j)
-            kv_push(llnodep, leaf_node, tmp_nodes[j]);
-        free(tmp_nodes);
-
-        if (exceed_limit || leaf_node.n > PATH_N_LIM) {
+        uint32_t *v = &pp1.v.a[pp1.a.a[i]>>32], nv = (uint32_t) pp1.a.a[i];
+        for (j = 0; j < nv; ++j)
+            prefix[j] = v[nv - 1 - j] ^ 1;
+        assert(prefix[nv-1] == (s<<1 | 1)); // should be always ended with seq s
+        if (graph_path_extension(g, prefix, nv, seg_dups, vis, &pp, PATH_N_LIM)) {
             exceed_limit = 1;
             break;
         }
     }
-    free(leaves);
+    free(prefix);
+    free(vis);
+    kv_destroy(pp1.v);
+    kv_destroy(pp1.a);
 
     if (exceed_limit)
         goto final_clean;
 
 #ifdef DEBUG_PATH_FINDER
-    fprintf(stderr, "[DEBUG_PATH_FINDER::%s] number leaf nodes: %lu\n", __func__, leaf_node.n);
+    fprintf(stderr, "[DEBUG_PATH_FINDER::%s] number leaf nodes: %lu\n", __func__, pp.a.n);
 #endif
 
-    for (i = 0; i < leaf_node.n; ++i) {
+    for (i = 0; i < pp.a.n; ++i) {
         kvec_t(uint32_t) path;
-        kv_init(path);
-        node = leaf_node.a[i];
-        path.n = 0;
-        while (node != NULL) {
-            kv_push(uint32_t, path, node->v);
-            node = node->prev;
-        }
-        rev_array(path.a, path.n);
+        path.n = path.m = (uint32_t) pp.a.a[i];
+        MYMALLOC(path.a, path.n);
+        memcpy(path.a, &pp.v.a[pp.a.a[i]>>32], sizeof(uint32_t) * path.n);
 
         circ = asmg_arc1(g, path.a[path.n-1], path.a[0]) != 0;
 
@@ -1390,11 +1604,8 @@ void graph_path_finder(asg_t *asg, kh_u32_t *seg_dups, path_v *paths, double sub
     }
 
 final_clean:
-    for (i = 0; i < root_node.n; ++i)
-        llnode_destroy(root_node.a[i]);
-
-    kv_destroy(root_node);
-    kv_destroy(leaf_node);
+    kv_destroy(pp.v);
+    kv_destroy(pp.a);
 
     return;
 }
@@ -1427,42 +1638,54 @@ static char *strdup1(char *src, uint32_t n)
     return dst;
 }
 
+// read the next oriented segment of a path string "seg1+,seg2-,..." at *p
+// sets *name/*l to the segment name and *rev to its orientation
+// returns 1 for a segment, 0 at the end of the path and -1 for a malformed segment
+// a blank or the end of the string closes the path
+int path_str_next(char **p, char **name, int *l, int *rev)
+{
+    char *s, *ptr;
+    s = *p;
+    if (s == 0) return 0;
+    while (isspace(*s) && *s != '\0')
+        ++s;
+    if (*s == '\0') return 0;
+    ptr = s;
+    while (!isspace(*ptr) && *ptr != ',' && *ptr !='\0')
+        ++ptr;
+    if (ptr - s < 2 || (*(ptr-1) != '+' && *(ptr-1) != '-'))
+        return -1;
+    *name = s, *l = ptr - s - 1, *rev = *(ptr-1) == '-';
+    *p = *ptr == ','? ptr + 1 : 0;
+    return 1;
+}
+
 path_t make_path_from_str(asg_t *asg, char *path_str, char *sid)
 {
-    int circ;
+    int circ, l, rev, ret;
     uint32_t v, cov;
     uint64_t len, len1;
     double wlen;
     kvec_t(uint32_t) vt;
-    char *ptr, *s;
+    char *p, *name, *s;
 
     kv_init(vt);
 
-    while (isspace(*path_str) && *path_str != '\0')
-        ++path_str;
-
-    while (*path_str != '\0') {
-        ptr = path_str;
-        while (!isspace(*ptr) && *ptr != ',' && *ptr !='\0')
-            ++ptr;
-
-        if (*(ptr-1) == '+' || *(ptr-1) == '-') {
-            s = strdup1(path_str, ptr - path_str - 1);
-            v = asg_name2id(asg, s);
-            if (v == UINT32_MAX) {
-                fprintf(stderr, "[E::%s] sequence does not exist: %s\n", __func__, s);
-                exit(EXIT_FAILURE);
-            }
-            v = (v<<1) | (*(ptr-1)=='-');
-            kv_push(uint32_t, vt , v);
-            free(s);
-        } else {
-            fprintf(stderr, "[E::%s] invalid path string: %s\n", __func__, path_str);
+    p = path_str;
+    while ((ret = path_str_next(&p, &name, &l, &rev)) > 0) {
+        s = strdup1(name, l);
+        v = asg_name2id(asg, s);
+        if (v == UINT32_MAX) {
+            fprintf(stderr, "[E::%s] sequence does not exist: %s\n", __func__, s);
             exit(EXIT_FAILURE);
         }
-
-        if (isspace(*ptr) || *ptr == '\0') break;
-        path_str = ptr + 1;
+        v = (v<<1) | rev;
+        kv_push(uint32_t, vt , v);
+        free(s);
+    }
+    if (ret < 0) {
+        fprintf(stderr, "[E::%s] invalid path string: %s\n", __func__, p);
+        exit(EXIT_FAILURE);
     }
     
     if (vt.n == 0) {
@@ -2017,10 +2240,16 @@ asg_t *asg_init()
     return g;
 }
 
-static void asg_seg_destroy(asg_seg_t *seg)
+// sequences of a memory-mapped GFA point into the mapping and are never freed
+static inline int asg_seq_is_mapped(asg_t *g, char *seq)
+{
+    return g->mm && seq >= g->mm && seq < g->mm + g->l_mm;
+}
+
+static void asg_seg_destroy(asg_t *g, asg_seg_t *seg)
 {
     if (seg->name) free(seg->name);
-    if (seg->seq) free(seg->seq);
+    if (seg->seq && !asg_seq_is_mapped(g, seg->seq)) free(seg->seq);
 }
 
 void asg_destroy(asg_t *g)
@@ -2028,11 +2257,12 @@ void asg_destroy(asg_t *g)
     if (!g) return;
     uint64_t i;
     for (i = 0; i < g->n_seg; ++i)
-        asg_seg_destroy(&g->seg[i]);
+        asg_seg_destroy(g, &g->seg[i]);
     free(g->seg);
     // key has been freed by asg_seg_destroy
     if (g->h_seg) kh_sdict_destroy(g->h_seg);
     if (g->asmg) asmg_destroy(g->asmg);
+    if (g->mm) munmap(g->mm, g->l_mm);
     free(g);
 }
 
@@ -2079,9 +2309,9 @@ uint32_t asg_name2id(asg_t *g, char *name)
     return k == kh_end(h)? UINT32_MAX : kh_val(h, k);
 }
 
-static void asg_update_seg_seq(asg_seg_t *seg, uint32_t l, char *s)
+static void asg_update_seg_seq(asg_t *g, asg_seg_t *seg, uint32_t l, char *s)
 {
-    if (seg->seq) free(seg->seq);
+    if (seg->seq && !asg_seq_is_mapped(g, seg->seq)) free(seg->seq);
     MYMALLOC(seg->seq, l+1);
     memcpy(seg->seq, s, l);
     seg->seq[l] = 0;
@@ -2354,23 +2584,36 @@ static int asg_parse_fa_hdr(asg_t *g, char *s, asg_seg_t **seg)
     return 0;
 }
 
-static inline int gfa_parse_S(asg_t *g, char *s)
+// a parsed S or L line
+// parsing does not touch the graph so lines can be parsed in parallel
+typedef struct {
+    char *seg, *segw; // S: seg name; L: v and w seg names
+    char *seq; // S: sequence or NULL
+    uint64_t ov; // L: overlap length
+    uint32_t len, LN; // S: sequence length and LN:i tag
+    uint32_t cov; // S: seq coverage; L: arc coverage
+    uint32_t type:8, oriv:1, oriw:1, no_tag:1; // 'S' or 'L'; L: orientations; coverage tag absent
+} gfa_rec_t;
+
+// seq is strdup'ed if dup_seq is set, otherwise the record points into s
+static inline int gfa_parse_S(char *s, gfa_rec_t *r, uint8_t **aux, int *m_aux, int dup_seq)
 {
     if (*s != 'S') return PARSE_S_ERR;
 
     int i, c, is_ok;
-    char *p, *q, *seg, *seq, *rest;
-    uint32_t sid, len;
+    char *p, *q, *rest;
     
-    seg = seq = rest = 0;
-    len = 0;
+    memset(r, 0, sizeof(gfa_rec_t));
+    r->type = 'S';
+    rest = 0;
+    is_ok = 0;
     for (i = 0, p = q = s + 2;; ++p) {
         if (*p == 0 || *p == '\t') {
             c = *p;
             *p = 0;
-            if (i == 0) seg = q;
+            if (i == 0) r->seg = q;
             else if (i == 1) {
-                seq = q[0] == '*'? 0 : strdup(q);
+                r->seq = q[0] == '*'? 0 : (dup_seq? strdup(q) : q);
                 is_ok = 1, rest = c? p + 1 : 0;
                 break;
             }
@@ -2381,69 +2624,76 @@ static inline int gfa_parse_S(asg_t *g, char *s)
 
     if (is_ok) { // all mandatory fields read
         // parse sequence coverage if presented
-        int l_aux, m_aux = 0;
-        uint32_t LN = 0;
-        uint8_t *aux = 0, *s_LN = 0;
-        asg_seg_t *s;
-        l_aux = gfa_aux_parse(rest, &aux, &m_aux); // parse optional tags
-        s_LN = l_aux? gfa_aux_get(l_aux, aux, "LN") : 0;
+        int l_aux;
+        uint8_t *s_LN = 0;
+        l_aux = gfa_aux_parse(rest, aux, m_aux); // parse optional tags
+        s_LN = l_aux? gfa_aux_get(l_aux, *aux, "LN") : 0;
         if (s_LN && s_LN[0] == 'i')
-            LN = *(int64_t*)(s_LN + 1);
-        if (seq == 0) {
-            if (LN > 0) len = LN;
+            r->LN = *(int64_t*)(s_LN + 1);
+        if (r->seq == 0) {
+            if (r->LN > 0) r->len = r->LN;
         } else {
-            len = strlen(seq);
+            r->len = p - q; // p is at the end of the sequence field
         }
-        if (LN > 0 && len != LN)
-            fprintf(stderr, "[W::%s] for segment '%s', LN:i:%u tag is different from sequence length %d\n", __func__, seg, LN, len);
-        sid = asg_add_seg(g, seg, 0);
-        s = &g->seg[sid];
-        s->len = len, s->seq = seq;
         if (l_aux > 0) {
             uint8_t *s_SBP_COV = 0, *s_SEQ_COV = 0;
             double dv = 0;
             char tag[2];
             if (TAG_SBP_COV[0] != 0) {
                 memcpy(tag, TAG_SBP_COV, 2);
-                s_SBP_COV = gfa_aux_get(l_aux, aux, tag);
+                s_SBP_COV = gfa_aux_get(l_aux, *aux, tag);
                 if (s_SBP_COV && *s_SBP_COV == TAG_SBP_COV[3]) {
                     dv = gfa_aux_decimal_value(s_SBP_COV);
-                    s->cov = len > 0? dv/len : dv;
+                    r->cov = r->len > 0? dv/r->len : dv;
                 } else {
-                    fprintf(stderr, "[W::%s] for segment '%s', %s tag is absent\n", __func__, seg, tag);
+                    r->no_tag = 1;
                 }
             } else if (TAG_SEQ_COV[0] != 0) {
                 memcpy(tag, TAG_SEQ_COV, 2);
-                s_SEQ_COV = gfa_aux_get(l_aux, aux, tag);
+                s_SEQ_COV = gfa_aux_get(l_aux, *aux, tag);
                 if (s_SEQ_COV && *s_SEQ_COV == TAG_SEQ_COV[3]) {
-                    s->cov = gfa_aux_decimal_value(s_SEQ_COV);
+                    r->cov = gfa_aux_decimal_value(s_SEQ_COV);
                 } else {
-                    fprintf(stderr, "[W::%s] for segment '%s', %s tag is absent\n", __func__, seg, tag);
+                    r->no_tag = 1;
                 }
             } else {
                 // check KC and FC
-                s_SBP_COV = gfa_aux_get(l_aux, aux, "KC");
+                s_SBP_COV = gfa_aux_get(l_aux, *aux, "KC");
                 if (s_SBP_COV && *s_SBP_COV == 'i') {
                     dv = *(int64_t*)(s_SBP_COV + 1);
                 } else {
-                    s_SBP_COV = gfa_aux_get(l_aux, aux, "FC");
+                    s_SBP_COV = gfa_aux_get(l_aux, *aux, "FC");
                     if (s_SBP_COV && *s_SBP_COV == 'i')
                         dv = *(int64_t*)(s_SBP_COV + 1);
                 }
-                s->cov = len > 0? dv/len : dv;
+                r->cov = r->len > 0? dv/r->len : dv;
             }
         }
-        if (s->cov == 0) {
-            fprintf(stderr, "[W::%s] the coverage of segment '%s' is zero\n", __func__, seg);
-            s->cov = 1;
-        }
-        free(aux);
     } else return PARSE_S_ERR;
 
     return 0;
 }
 
-static int gfa_parse_L(asg_t *g, char *s)
+static void gfa_add_S(asg_t *g, gfa_rec_t *r)
+{
+    uint32_t sid;
+    asg_seg_t *s;
+    if (r->LN > 0 && r->len != r->LN)
+        fprintf(stderr, "[W::%s] for segment '%s', LN:i:%u tag is different from sequence length %d\n", __func__, r->seg, r->LN, r->len);
+    sid = asg_add_seg(g, r->seg, 0);
+    s = &g->seg[sid];
+    s->len = r->len, s->seq = r->seq;
+    s->cov = r->cov;
+    if (r->no_tag)
+        fprintf(stderr, "[W::%s] for segment '%s', %.2s tag is absent\n", __func__, r->seg,
+                TAG_SBP_COV[0] != 0? TAG_SBP_COV : TAG_SEQ_COV);
+    if (s->cov == 0) {
+        fprintf(stderr, "[W::%s] the coverage of segment '%s' is zero\n", __func__, r->seg);
+        s->cov = 1;
+    }
+}
+
+static int gfa_parse_L(char *s, gfa_rec_t *r, uint8_t **aux, int *m_aux)
 {
     if (*s != 'L') return PARSE_L_ERR;
 
@@ -2498,40 +2748,53 @@ static int gfa_parse_L(asg_t *g, char *s)
     }
     if (i == 4 && is_ok == 0) ov = ow = 0, is_ok = 1; // no overlap field
     if (is_ok) {
-        uint64_t v, w;
-        int l_aux, m_aux = 0;
-        uint8_t *aux = 0;
-        asmg_arc_t *arc;
-        v = asg_add_seg(g, segv, 1) << 1 | oriv;
-        w = asg_add_seg(g, segw, 1) << 1 | oriw;
-        arc = asmg_arc_add(g->asmg, v, w, 0, ov, UINT64_MAX, 0, 0);
-        l_aux = gfa_aux_parse(rest, &aux, &m_aux); // parse optional tags
+        int l_aux;
+        memset(r, 0, sizeof(gfa_rec_t));
+        r->type = 'L';
+        r->seg = segv, r->segw = segw;
+        r->oriv = oriv, r->oriw = oriw;
+        r->ov = ov;
+        l_aux = gfa_aux_parse(rest, aux, m_aux); // parse optional tags
         if (l_aux) {
             uint8_t *s_ARC_COV = 0;
             char tag[2];
             if (TAG_ARC_COV[0] != 0) {
                 memcpy(tag, TAG_ARC_COV, 2);
-                s_ARC_COV = gfa_aux_get(l_aux, aux, tag);
+                s_ARC_COV = gfa_aux_get(l_aux, *aux, tag);
                 if (s_ARC_COV && *s_ARC_COV == TAG_ARC_COV[3])
-                    arc->cov = gfa_aux_decimal_value(s_ARC_COV);
+                    r->cov = gfa_aux_decimal_value(s_ARC_COV);
                 else
-                    fprintf(stderr, "[W::%s] for arc '%s%c' -> '%s%c', %s tag is absent\n", __func__, segv, "+-"[oriv], segw, "+-"[oriw], tag);
+                    r->no_tag = 1;
             } else {
                 // check EC
-                s_ARC_COV = gfa_aux_get(l_aux, aux, "EC");
+                s_ARC_COV = gfa_aux_get(l_aux, *aux, "EC");
                 if (s_ARC_COV && *s_ARC_COV == 'i')
-                    arc->cov = *(int64_t*)(s_ARC_COV + 1);
+                    r->cov = *(int64_t*)(s_ARC_COV + 1);
             }
         }
-        if (arc->cov == 0) {
-            fprintf(stderr, "[W::%s] the coverage of arc '%s%c' -> '%s%c' is zero\n", __func__, segv, "+-"[oriv], segw, "+-"[oriw]);
-            arc->cov = 1;
-        }
-        free(aux);
     } else return PARSE_L_ERR;
     return 0;
 }
 
+static void gfa_add_L(asg_t *g, gfa_rec_t *r)
+{
+    uint64_t v, w;
+    asmg_arc_t *arc;
+    v = asg_add_seg(g, r->seg, 1) << 1 | r->oriv;
+    w = asg_add_seg(g, r->segw, 1) << 1 | r->oriw;
+    arc = asmg_arc_add(g->asmg, v, w, 0, r->ov, UINT64_MAX, 0, 0);
+    arc->cov = r->cov;
+    if (r->no_tag)
+        fprintf(stderr, "[W::%s] for arc '%s%c' -> '%s%c', %.2s tag is absent\n", __func__,
+                r->seg, "+-"[r->oriv], r->segw, "+-"[r->oriw], TAG_ARC_COV);
+    if (arc->cov == 0) {
+        fprintf(stderr, "[W::%s] the coverage of arc '%s%c' -> '%s%c' is zero\n", __func__,
+                r->seg, "+-"[r->oriv], r->segw, "+-"[r->oriw]);
+        arc->cov = 1;
+    }
+}
+
+
 static void asg_finalize_asmg(asg_t *g)
 {
     if (g->asmg == 0)
@@ -2554,22 +2817,262 @@ static void asg_finalize_asmg(asg_t *g)
     asmg_finalize(asmg, 0);
 }
 
-asg_t *asg_read(const char *fn)
+// value of a tag kept in the binary graph
+// return 0 if the tag is absent or of a different type
+static int oagb_seg_tag(const oagb_seg_t *s, const char *tag, double *val)
+{
+    if (!memcmp(tag, "KC:i", 4) && (s->flag & OAGB_F_KC)) *val = s->kc;
+    else if (!memcmp(tag, "SC:f", 4) && (s->flag & OAGB_F_SC)) *val = s->sc;
+    else if (!memcmp(tag, "LN:i", 4) && (s->flag & OAGB_F_LN)) *val = s->ln;
+    else return 0;
+    return 1;
+}
+
+// fill a record as gfa_parse_S() would for the S-line printed from the binary record
+static void oagb_rec_S(const oagb_seg_t *s, char *name, char *seq, gfa_rec_t *r)
+{
+    double dv;
+    memset(r, 0, sizeof(gfa_rec_t));
+    r->type = 'S';
+    r->seg = name;
+    r->seq = seq;
+    if (s->flag & OAGB_F_LN) r->LN = s->ln;
+    r->len = seq? s->len : r->LN;
+    if (!(s->flag & (OAGB_F_LN | OAGB_F_KC | OAGB_F_SC)))
+        return; // no tags
+    dv = 0;
+    if (TAG_SBP_COV[0] != 0) {
+        if (oagb_seg_tag(s, TAG_SBP_COV, &dv))
+            r->cov = r->len > 0? dv/r->len : dv;
+        else
+            r->no_tag = 1;
+    } else if (TAG_SEQ_COV[0] != 0) {
+        if (oagb_seg_tag(s, TAG_SEQ_COV, &dv))
+            r->cov = dv;
+        else
+            r->no_tag = 1;
+    } else {
+        if (s->flag & OAGB_F_KC) dv = s->kc;
+        r->cov = r->len > 0? dv/r->len : dv;
+    }
+}
+
+typedef struct {
+    char *mm;
+    const oagb_hdr_t *h;
+    const oagb_seg_t *s;
+    char **seq;
+} oagb_seq_aux_t;
+
+static void oagb_unpack_worker(void *_data, long i, int tid) // kt_for() callback
+{
+    oagb_seq_aux_t *aux = (oagb_seq_aux_t *) _data;
+    const oagb_seg_t *s = &aux->s[i];
+    char *p;
+    if (!(s->flag & OAGB_F_SEQ)) return;
+    p = aux->mm + aux->h->off_seq + s->seq;
+    if (s->flag & OAGB_F_RAW) {
+        aux->seq[i] = p;
+    } else {
+        MYMALLOC(aux->seq[i], (uint64_t) s->len + 1);
+        oagb_unpack_seq((uint8_t *) p, s->len, aux->seq[i]);
+    }
+}
+
+// build the graph from a memory-mapped binary graph
+// text sequences point into the mapping; packed ones are unpacked in parallel
+// records go through gfa_add_S() and gfa_add_L() so the graph and the warnings
+// are the same as from the GFA the binary graph was written for
+static asg_t *asg_read_oagb(char *mm, uint64_t l_mm, const kt_ctx_t *kc)
+{
+    uint64_t i;
+    asg_t *g;
+    gfa_rec_t r;
+    const oagb_hdr_t *h;
+    const oagb_arc_t *a;
+    char *names;
+    oagb_seq_aux_t aux;
+
+    h = (const oagb_hdr_t *) mm;
+    names = mm + h->off_name;
+    aux.mm = mm;
+    aux.h = h;
+    aux.s = (const oagb_seg_t *) (mm + h->off_seg);
+    MYCALLOC(aux.seq, h->n_seg);
+    kt_ctx_for(kc, oagb_unpack_worker, &aux, h->n_seg);
+
+    g = asg_init();
+    g->mm = mm;
+    g->l_mm = l_mm;
+    for (i = 0; i < h->n_seg; ++i) {
+        oagb_rec_S(&aux.s[i], names + aux.s[i].name, aux.seq[i], &r);
+        gfa_add_S(g, &r);
+    }
+    a = (const oagb_arc_t *) (mm + h->off_arc);
+    for (i = 0; i < h->n_arc; ++i) {
+        memset(&r, 0, sizeof(gfa_rec_t));
+        r.type = 'L';
+        r.seg = names + aux.s[a[i].v>>1].name;
+        r.segw = names + aux.s[a[i].w>>1].name;
+        r.oriv = a[i].v&1, r.oriw = a[i].w&1;
+        r.ov = a[i].ov;
+        if (a[i].flag & OAGB_F_EC) {
+            if (TAG_ARC_COV[0] == 0 || !memcmp(TAG_ARC_COV, "EC:i", 4)) r.cov = a[i].ec;
+            else r.no_tag = 1;
+        }
+        gfa_add_L(g, &r);
+    }
+    free(aux.seq);
+
+    asg_finalize_asmg(g);
+
+    return g;
+}
+
+#define GFA_MM_CHUNK 0x1000000 // size of the chunks parsed in parallel
+
+typedef struct {
+    char *beg, *end; // [beg, end) ending with a newline
+    uint64_t n_line; // number of lines parsed
+    kvec_t(gfa_rec_t) a; // S and L records in the order of lines
+    int ret; // parse error code if any
+    char err_c; // type of the line with the parse error
+} gfa_chunk_t;
+
+static void gfa_mm_parse_worker(void *_data, long i, int tid) // kt_for() callback
+{
+    gfa_chunk_t *c = &((gfa_chunk_t *) _data)[i];
+    char *p, *e;
+    uint8_t *aux = 0;
+    int ret, m_aux = 0;
+    gfa_rec_t r;
+
+    for (p = c->beg; p < c->end; p = e + 1) {
+        e = memchr(p, '\n', c->end - p);
+        ++c->n_line;
+        *e = 0;
+        if (e - p > 1 && e[-1] == '\r') e[-1] = 0; // as ks_getuntil() does
+        if (*p == 'S')
+            ret = gfa_parse_S(p, &r, &aux, &m_aux, 0);
+        else if (*p == 'L')
+            ret = gfa_parse_L(p, &r, &aux, &m_aux);
+        else continue;
+        if (ret < 0) {
+            c->ret = ret;
+            c->err_c = *p;
+            break;
+        }
+        kv_push(gfa_rec_t, c->a, r);
+    }
+    free(aux);
+}
+
+// read an uncompressed GFA file by memory mapping
+// the file is privately mapped so parsing writes into the mapping are never written back
+// and the seg sequences point into the mapping instead of being copied
+// lines are parsed in parallel in chunks and added to the graph in the order of lines
+// so the graph is identical to the one from the stream parser
+// a binary graph (.oagb) is recognised by its magic and loaded without parsing
+// return 0 if the file is not suitable (compressed, FASTA/FASTQ, not a regular file, etc)
+static asg_t *asg_read_gfa_mm(const char *fn, const kt_ctx_t *kc)
+{
+    int fd, ret;
+    struct stat st;
+    char *mm, *p, *e, *end;
+    uint64_t i, j, lineno;
+    asg_t *g;
+    kvec_t(gfa_chunk_t) chunks;
+    gfa_chunk_t *c;
+    gfa_rec_t *r;
+
+    fd = open(fn, O_RDONLY);
+    if (fd < 0) return 0;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    mm = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mm == MAP_FAILED) return 0;
+    ret = oagb_check(mm, st.st_size);
+    if (ret < 0) {
+        fprintf(stderr, "[E::%s] truncated or corrupted binary graph file: %s\n", __func__, fn);
+        exit(EXIT_FAILURE);
+    }
+    if (ret > 0) return asg_read_oagb(mm, st.st_size, kc);
+    end = mm + st.st_size;
+    // the stream parser handles compressed files, FASTA/FASTQ
+    // and files without a final newline that could not be terminated in place
+    for (p = mm; p < end && *p == '\n'; ++p) {}
+    if ((st.st_size >= 2 && (uint8_t) mm[0] == 0x1f && (uint8_t) mm[1] == 0x8b) ||
+            p == end || *p == '>' || *p == '@' || end[-1] != '\n') {
+        munmap(mm, st.st_size);
+        return 0;
+    }
+    madvise(mm, st.st_size, MADV_SEQUENTIAL);
+
+    // split at line boundaries
+    kv_init(chunks);
+    for (p = mm; p < end; p = e) {
+        e = p + GFA_MM_CHUNK;
+        if (e >= end) e = end;
+        else e = (char *) memchr(e - 1, '\n', end - e + 1) + 1;
+        kv_pushp(gfa_chunk_t, chunks, &c);
+        memset(c, 0, sizeof(gfa_chunk_t));
+        c->beg = p, c->end = e;
+    }
+
+    kt_ctx_for(kc, gfa_mm_parse_worker, chunks.a, chunks.n);
+
+    g = asg_init();
+    g->mm = mm;
+    g->l_mm = st.st_size;
+    lineno = 0;
+    for (i = 0; i < chunks.n; ++i) {
+        c = &chunks.a[i];
+        for (j = 0; j < c->a.n; ++j) {
+            r = &c->a.a[j];
+            if (r->type == 'S') gfa_add_S(g, r);
+            else gfa_add_L(g, r);
+        }
+        lineno += c->n_line;
+        if (c->ret < 0) {
+            fprintf(stderr, "[E::%s] failed to parse GFA file: %c-line at line %lu (error code %d)\n",
+                    __func__, c->err_c, lineno, c->ret);
+            exit(EXIT_FAILURE);
+        }
+        kv_destroy(c->a);
+    }
+    kv_destroy(chunks);
+
+    // add vtx, fix symmetric arcs, sort and index etc
+    asg_finalize_asmg(g);
+
+    return g;
+}
+
+asg_t *asg_read(const char *fn, const kt_ctx_t *kc)
 {
-    int dret, ret, is_fa, is_fq, is_gfa;
+    int dret, ret, is_fa, is_fq, is_gfa, m_aux;
     gzFile fp;
     kstream_t *ks;
     asg_seg_t *fa_seg;
     uint64_t lineno;
     asg_t *g;
+    gfa_rec_t r;
+    uint8_t *aux;
     kstring_t s = {0, 0, 0}, fa_seq = {0, 0, 0};
 
+    if (fn && strcmp(fn, "-") && (g = asg_read_gfa_mm(fn, kc)) != 0)
+        return g;
+
     fp = fn && strcmp(fn, "-")? gzopen(fn, "r") : gzdopen(0, "r");
     if (fp == 0) return 0;
     ks = ks_init(fp);
     g = asg_init();
     lineno = 0;
     fa_seg = 0;
+    aux = 0, m_aux = 0;
     is_fa = is_fq = is_gfa = 0;
     
     while (ks_getuntil(ks, KS_SEP_LINE, &s, &dret) >= 0) {
@@ -2580,7 +3083,7 @@ asg_t *asg_read(const char *fn)
         ret = 0;
         if (!is_gfa && s.s[0] == '>') { // FASTA header
             is_fa = 1;
-            if (fa_seg) asg_update_seg_seq(fa_seg, fa_seq.l, fa_seq.s);
+            if (fa_seg) asg_update_seg_seq(g, fa_seg, fa_seq.l, fa_seq.s);
             // parse header
             asg_parse_fa_hdr(g, s.s, &fa_seg);
             fa_seq.l = 0;
@@ -2592,7 +3095,7 @@ asg_t *asg_read(const char *fn)
             if(ks_getuntil(ks, KS_SEP_LINE, &s, &dret) < 0)
                 ret = PARSE_Q_ERR;
             else
-                asg_update_seg_seq(fa_seg, s.l, s.s);
+                asg_update_seg_seq(g, fa_seg, s.l, s.s);
             ++lineno;
             // skip quality score lines
             if (ks_getuntil(ks, KS_SEP_LINE, &s, &dret) < 0 ||
@@ -2604,10 +3107,13 @@ asg_t *asg_read(const char *fn)
             kputsn(s.s, s.l, &fa_seq);
         } else {
             is_gfa = 1;
-            if (s.s[0] == 'S')
-                ret = gfa_parse_S(g, s.s);
-            else if (s.s[0] == 'L')
-                ret = gfa_parse_L(g, s.s);
+            if (s.s[0] == 'S') {
+                ret = gfa_parse_S(s.s, &r, &aux, &m_aux, 1);
+                if (ret == 0) gfa_add_S(g, &r);
+            } else if (s.s[0] == 'L') {
+                ret = gfa_parse_L(s.s, &r, &aux, &m_aux);
+                if (ret == 0) gfa_add_L(g, &r);
+            }
         }
 
         if (ret < 0) {
@@ -2616,8 +3122,9 @@ asg_t *asg_read(const char *fn)
             exit(EXIT_FAILURE);
         }
     }
-    if (is_fa && fa_seg) asg_update_seg_seq(fa_seg, fa_seq.l, fa_seq.s);
+    if (is_fa && fa_seg) asg_update_seg_seq(g, fa_seg, fa_seq.l, fa_seq.s);
 
+    free(aux);
     free(fa_seq.s);
     free(s.s);
     ks_destroy(ks);
@@ -2629,6 +3136,130 @@ asg_t *asg_read(const char *fn)
     return g;
 }
 
+// build the subgraph of the named segs from a plain or bgzip-compressed GFA file
+// using the sidecar index <fn>.gfai, which is built in a streaming pass if missing or out of date
+// only the S-lines of the segs and the L-lines between them are read
+// return 0 if the file is not suitable for random access or the index is not available
+asg_t *asg_read_gfai(const char *fn, char **names, uint64_t n_names)
+{
+    int ret, m_aux, absent;
+    uint64_t i, n_voff, *voffs, voff;
+    char *fn_idx;
+    gfai_rdr_t *rdr;
+    sdhash_t *h;
+    asg_t *g;
+    gfa_rec_t r;
+    uint8_t *aux;
+    kstring_t s = {0, 0, 0};
+
+    rdr = gfai_rdr_open(fn);
+    if (rdr == 0) return 0;
+    MYMALLOC(fn_idx, strlen(fn) + 6);
+    sprintf(fn_idx, "%s.gfai", fn);
+    voffs = gfai_query(fn, fn_idx, names, n_names, &n_voff);
+    if (voffs == 0) {
+        fprintf(stderr, "[M::%s] building GFA index %s\n", __func__, fn_idx);
+        if (gfai_build(rdr, fn, fn_idx) == 0)
+            voffs = gfai_query(fn, fn_idx, names, n_names, &n_voff);
+    }
+    free(fn_idx);
+    if (voffs == 0) {
+        gfai_rdr_close(rdr);
+        return 0;
+    }
+
+    h = kh_sdict_init();
+    for (i = 0; i < n_names; ++i)
+        kh_sdict_put(h, names[i], &absent);
+    g = asg_init();
+    aux = 0, m_aux = 0;
+    // in the order of lines as the stream parser
+    for (i = 0; i < n_voff; ++i) {
+        voff = voffs[i];
+        if (gfai_rdr_seek(rdr, voff) < 0 || gfai_rdr_getline(rdr, &s, 0) < 0) {
+            fprintf(stderr, "[E::%s] failed to read GFA file at virtual offset %lu\n", __func__, voff);
+            exit(EXIT_FAILURE);
+        }
+        ret = 0;
+        if (s.s[0] == 'S') {
+            ret = gfa_parse_S(s.s, &r, &aux, &m_aux, 1);
+            if (ret == 0) gfa_add_S(g, &r);
+        } else if (s.s[0] == 'L') {
+            ret = gfa_parse_L(s.s, &r, &aux, &m_aux);
+            if (ret == 0 && kh_sdict_get(h, r.seg) != kh_end(h) && kh_sdict_get(h, r.segw) != kh_end(h))
+                gfa_add_L(g, &r);
+        }
+        if (ret < 0) {
+            fprintf(stderr, "[E::%s] failed to parse GFA file: %c-line at virtual offset %lu (error code %d)\n",
+                    __func__, s.s[0], voff, ret);
+            exit(EXIT_FAILURE);
+        }
+    }
+    kh_sdict_destroy(h);
+    free(aux);
+    free(s.s);
+    free(voffs);
+    gfai_rdr_close(rdr);
+
+    // add vtx, fix symmetric arcs, sort and index etc
+    asg_finalize_asmg(g);
+
+    return g;
+}
+
+// build the graph from an in-memory syncasm unitig graph
+// consensus sequences must have been saved with scg_consensus()
+// the result is identical to asg_read() on the GFA written by scg_consensus()
+// with the default KC:i tag: segment coverage is rounded through the integer
+// KC value (len*cov) exactly as the GFA route does
+asg_t *asg_from_asmg(asmg_t *asmg)
+{
+    uint64_t i, n, v, w, *sid;
+    char name[32];
+    asg_t *g;
+    asg_seg_t *s;
+    asmg_vtx_t *vtx;
+    asmg_arc_t *a, *arc;
+
+    g = asg_init();
+    MYMALLOC(sid, asmg->n_vtx);
+    for (i = 0, n = asmg->n_vtx; i < n; ++i) {
+        sid[i] = UINT64_MAX;
+        vtx = &asmg->vtx[i];
+        if (vtx->del) continue;
+        sprintf(name, "u%lu", i);
+        sid[i] = asg_add_seg(g, name, 0);
+        s = &g->seg[sid[i]];
+        s->seq = vtx->seq? strdup(vtx->seq) : 0;
+        s->len = vtx->len;
+        s->cov = vtx->len > 0? (double) (int64_t) (vtx->len * vtx->cov) / vtx->len : 0;
+        if (s->cov == 0) {
+            fprintf(stderr, "[W::%s] the coverage of segment '%s' is zero\n", __func__, name);
+            s->cov = 1;
+        }
+    }
+
+    for (i = 0, n = asmg->n_arc; i < n; ++i) {
+        a = &asmg->arc[i];
+        if (a->del || a->comp) continue;
+        v = sid[a->v>>1] << 1 | (a->v&1);
+        w = sid[a->w>>1] << 1 | (a->w&1);
+        if (a->cov == 0)
+            fprintf(stderr, "[W::%s] the coverage of arc 'u%lu%c' -> 'u%lu%c' is zero\n", __func__,
+                    a->v>>1, "+-"[a->v&1], a->w>>1, "+-"[a->w&1]);
+        // both links of the pair in the order they are written to the GFA
+        arc = asmg_arc_add(g->asmg, v, w, 0, a->ls, UINT64_MAX, 0, 0);
+        arc->cov = a->cov? a->cov : 1;
+        arc = asmg_arc_add(g->asmg, w^1, v^1, 0, a->ls, UINT64_MAX, 0, 0);
+        arc->cov = a->cov? a->cov : 1;
+    }
+    free(sid);
+
+    asg_finalize_asmg(g);
+
+    return g;
+}
+
 void asg_stat(asg_t *asg, FILE *fo)
 {
     uint64_t i, nv, n_vtx, n_seg, max_deg, tot_seg_len, n_link, n_arc, tot_deg;
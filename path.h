@@ -38,6 +38,7 @@
 #include "khashl.h"
 
 #include "graph.h"
+#include "kthread.h"
 #include "hmmannot.h"
 
 KHASHL_MAP_INIT(KH_LOCAL, kh_u32_t, kh_u32, khint32_t, uint32_t, kh_hash_uint32, kh_eq_generic)
@@ -71,6 +72,8 @@ typedef struct {
     asg_seg_t *seg; // sequence dictionary
     void *h_seg; // sequence hash map: name -> index
     asmg_t *asmg;
+    char *mm; // memory-mapped GFA file if any; seg sequences may point into it
+    size_t l_mm;
 } asg_t;
 
 typedef struct {
@@ -107,7 +110,9 @@ extern "C" {
 asg_t *asg_init();
 void asg_destroy(asg_t *g);
 uint32_t asg_name2id(asg_t *g, char *name);
-asg_t *asg_read(const char *fn);
+asg_t *asg_read(const char *fn, const kt_ctx_t *kc);
+asg_t *asg_read_gfai(const char *fn, char **names, uint64_t n_names);
+asg_t *asg_from_asmg(asmg_t *asmg);
 asg_t *asg_make_copy(asg_t *g);
 asmg_t *asg_make_asmg_copy(asmg_t *g, asmg_t *_g);
 uint32_t asg_add_seg(asg_t *g, char *name, int allow_dups);
@@ -121,9 +126,10 @@ void asg_print_fa(asg_t *g, FILE *fo, int line_wd);
 void path_destroy(path_t *path);
 void path_v_destroy(path_v *path);
 double graph_sequence_coverage_precise(asg_t *asg, double min_cf, int min_copy, int max_copy, int **copy_number);
-int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage, double *_adjusted_cov, int *copy_number, int max_copy, int max_round);
+int adjust_sequence_copy_number_by_graph_layout(asg_t *asg, double seq_coverage, double *_adjusted_cov, int *copy_number, int max_copy, int max_round, const kt_ctx_t *kc);
 kh_u32_t *sequence_duplication_by_copy_number(asg_t *asg, int *copy_number, int allow_del);
 void graph_path_finder(asg_t *asg, kh_u32_t *seg_dups, path_v *paths, double sub_circ_minf, int is_pltd);
+int path_str_next(char **p, char **name, int *l, int *rev);
 path_t make_path_from_str(asg_t *asg, char *path_str, char *sid);
 void path_sort(path_v *paths);
 void path_rotate(asg_t *g, path_t *path, hmm_annot_db_t *annots, OG_TYPE_t og_type);
@@ -95,7 +95,7 @@ FILE *fopen1(char *fn)
 
 static void parse_organelle_component(asg_t *asg, hmm_annot_db_t *annot_db, og_component_v *og_components,
         int min_s_len, int max_copy, int min_ex_g, double seq_cf, int do_clean, double min_cf, double max_eval,
-        int bubble_size, int tip_size, double weak_cross, char *out_pref, int out_opt, OG_TYPE_t og_type, int VERBOSE)
+        int bubble_size, int tip_size, double weak_cross, char *out_pref, int out_opt, OG_TYPE_t og_type, const kt_ctx_t *kc, int VERBOSE)
 {
     assert(og_type == OG_MITO || og_type == OG_PLTD || og_type == OG_MINI);
 
@@ -295,7 +295,7 @@ static void parse_organelle_component(asg_t *asg, hmm_annot_db_t *annot_db, og_c
                 // adjust the sequence copy number and redo path finding
                 asg_copy = asg_make_copy(asg);
                 double adjusted_avg_coverage;
-                int updated = adjust_sequence_copy_number_by_graph_layout(asg_copy, avg_coverage, &adjusted_avg_coverage, copy_number, max_copy, 10);
+                int updated = adjust_sequence_copy_number_by_graph_layout(asg_copy, avg_coverage, &adjusted_avg_coverage, copy_number, max_copy, 10, kc);
                 if (updated) {
                     if (VERBOSE > 0)
                         fprintf(stderr, "[M::%s] adjusted per-copy sequence coverage: %.3f\n", __func__, adjusted_avg_coverage);
@@ -598,14 +598,14 @@ static int path_cmpfunc(const void *a, const void *b)
     return 0;
 }
 
-static int extract_minicircles_with_anchor(scg_ra_v *ra, scg_t *scg, uint64_t anchor_sid, int n_threads, path_v *paths)
+static int extract_minicircles_with_anchor(scg_ra_v *ra, scg_t *scg, uint64_t anchor_sid, const kt_ctx_t *kc, path_v *paths)
 {
     uint64_t i, j, k, nr, *mcs;
     
     nr = ra->n;
     MYMALLOC(mcs, nr);
     mc_shared_t mc_shared = {ra, anchor_sid, mcs};
-    kt_for(n_threads, minicircle_analysis_thread, &mc_shared, nr);
+    kt_ctx_for(kc, minicircle_analysis_thread, &mc_shared, nr);
 
     for (i = 0; i < nr; ++i) {
         if (mcs[i] == UINT64_MAX) continue;
@@ -691,7 +691,7 @@ static int extract_minicircles_with_anchor(scg_ra_v *ra, scg_t *scg, uint64_t an
 }
 
 static int parse_organelle_minicircle(asg_t *asg, hmm_annot_db_t *annot_db, og_component_v *og_components,
-        double *seg_annot_score, scg_meta_t *scg_meta, int n_threads, char *out_pref, int out_opt, 
+        double *seg_annot_score, scg_meta_t *scg_meta, const kt_ctx_t *kc, char *out_pref, int out_opt, 
         double max_eval, double seq_cf, int VERBOSE)
 {
     if (og_components->n == 0) {
@@ -770,14 +770,14 @@ static int parse_organelle_minicircle(asg_t *asg, hmm_annot_db_t *annot_db, og_c
     if (path_exists) {
         // align reads and find minicircles
         asmg_clean_consensus(scg_meta->scg->utg_asmg);
-        scg_read_alignment(scg_meta->sr_db, scg_meta->ra_db, scg_meta->scg, n_threads, 0);
+        scg_read_alignment(scg_meta->sr_db, scg_meta->ra_db, scg_meta->scg, kc, 0);
 
 #ifdef DEBUG_MINICIRCLE_REPEAT_UNIT
         scg_rv_print(scg_meta->ra_db, stderr);
 #endif
 
-        scg_consensus(scg_meta->sr_db, scg_meta->scg, 0, 0, 0);
-        extract_minicircles_with_anchor(scg_meta->ra_db, scg_meta->scg, anchor_sid, n_threads, &paths);
+        scg_consensus(scg_meta->sr_db, scg_meta->scg, 0, 0, 0, 0);
+        extract_minicircles_with_anchor(scg_meta->ra_db, scg_meta->scg, anchor_sid, kc, &paths);
     }
 
     // prepare assembly subgraph for output
@@ -838,10 +838,10 @@ static int parse_organelle_minicircle(asg_t *asg, hmm_annot_db_t *annot_db, og_c
     return 0;
 }
 
-int pathfinder_minicircle(char *asg_file, char *mini_annot, scg_meta_t *scg_meta, int min_len,
+int pathfinder_minicircle(char *asg_file, asg_t *asg_in, char *mini_annot, scg_meta_t *scg_meta, int min_len,
         int min_ex_g, int max_copy, double max_eval, double min_score, double min_cf, double seq_cf,
         int no_trn, int no_rrn, int do_graph_clean, int bubble_size, int tip_size, double weak_cross,
-        int out_opt, char *out_pref, int n_threads, int VERBOSE)
+        int out_opt, char *out_pref, const kt_ctx_t *kc, int VERBOSE)
 {
     asg_t *asg;
     hmm_annot_db_t *annot_db;
@@ -854,7 +854,8 @@ int pathfinder_minicircle(char *asg_file, char *mini_annot, scg_meta_t *scg_meta
     og_components = 0;
     seg_annot_score = 0;
 
-    asg = asg_read(asg_file);
+    // use the in-memory graph if provided, the graph is taken over and destroyed at the end
+    asg = asg_in? asg_in : asg_read(asg_file, kc);
     if (asg == 0) {
         fprintf(stderr, "[E::%s] failed to read the graph: %s\n", __func__, asg_file);
         ret = 1;
@@ -879,7 +880,7 @@ int pathfinder_minicircle(char *asg_file, char *mini_annot, scg_meta_t *scg_meta
     }
     if (VERBOSE > 1) print_og_classification_summary(asg, annot_db, og_components, stderr);
 
-    parse_organelle_minicircle(asg, annot_db, og_components, seg_annot_score, scg_meta, n_threads, out_pref, out_opt, max_eval, seq_cf, VERBOSE);
+    parse_organelle_minicircle(asg, annot_db, og_components, seg_annot_score, scg_meta, kc, out_pref, out_opt, max_eval, seq_cf, VERBOSE);
 
 do_clean:
     asg_destroy(asg);
@@ -890,10 +891,10 @@ do_clean:
     return ret;
 }
 
-int pathfinder(char *asg_file, char *mito_annot, char *pltd_annot, int min_len, int ext_p, int ext_m,
+int pathfinder(char *asg_file, asg_t *asg_in, char *mito_annot, char *pltd_annot, int min_len, int ext_p, int ext_m,
         int max_copy, double max_eval, double min_score, double min_cf, double seq_cf,
         int no_trn, int no_rrn, int do_graph_clean, int bubble_size, int tip_size, double weak_cross,
-        int out_opt, char *out_pref, int VERBOSE)
+        int out_opt, char *out_pref, const kt_ctx_t *kc, int VERBOSE)
 {
     asg_t *asg;
     hmm_annot_db_t *annot_db;
@@ -904,7 +905,8 @@ int pathfinder(char *asg_file, char *mito_annot, char *pltd_annot, int min_len,
     annot_db = 0;
     og_components = 0;
 
-    asg = asg_read(asg_file);
+    // use the in-memory graph if provided, the graph is taken over and destroyed at the end
+    asg = asg_in? asg_in : asg_read(asg_file, kc);
     if (asg == 0) {
         fprintf(stderr, "[E::%s] failed to read the graph: %s\n", __func__, asg_file);
         ret = 1;
@@ -940,10 +942,10 @@ int pathfinder(char *asg_file, char *mito_annot, char *pltd_annot, int min_len,
     // graph will be changed with extra copies of sequences added
     if (mito_annot)
         parse_organelle_component(asg, annot_db, og_components, min_len, max_copy, ext_m, seq_cf, do_graph_clean, 
-                min_cf, max_eval, bubble_size, tip_size, weak_cross, out_pref, out_opt, OG_MITO, VERBOSE);
+                min_cf, max_eval, bubble_size, tip_size, weak_cross, out_pref, out_opt, OG_MITO, kc, VERBOSE);
     if (pltd_annot)
         parse_organelle_component(asg, annot_db, og_components, min_len, max_copy, ext_p, seq_cf, do_graph_clean, 
-                min_cf, max_eval, bubble_size, tip_size, weak_cross, out_pref, out_opt, OG_PLTD, VERBOSE);
+                min_cf, max_eval, bubble_size, tip_size, weak_cross, out_pref, out_opt, OG_PLTD, kc, VERBOSE);
 
 do_clean:
     asg_destroy(asg);
@@ -979,6 +981,7 @@ static ko_longopt_t long_options[] = {
     { "max-copy",       ko_required_argument, 'c' },
     { "max-eval",       ko_required_argument, 'e' },
     { "min-s-len",      ko_required_argument, 'l' },
+    { "threads",        ko_required_argument, 't' },
     { "verbose",        ko_required_argument, 'v' },
     { "version",        ko_no_argument,       'V' },
     { "help",           ko_no_argument,       'h' },
@@ -987,9 +990,9 @@ static ko_longopt_t long_options[] = {
 
 int main(int argc, char *argv[])
 {
-    const char *opt_str = "c:e:f:g:hl:m:o:p:q:s:v:V";
+    const char *opt_str = "c:e:f:g:hl:m:o:p:q:s:t:v:V";
     ketopt_t opt = KETOPT_INIT;
-    int c, out_s, out_c, max_copy, ret = 0;
+    int c, out_s, out_c, max_copy, n_threads, ret = 0;
     FILE *fp_help;
     char *out_pref, *mito_annot, *pltd_annot, *ec_tag, *kc_tag, *sc_tag;
     int no_trn, no_rrn, min_len, ext_p, ext_m, bubble_size, tip_size, do_graph_clean;
@@ -1001,6 +1004,7 @@ int main(int argc, char *argv[])
     out_c = 0;
     out_pref = "oatk.asm";
     max_copy = 10;
+    n_threads = 1;
     fp_help = stderr;
     mito_annot = 0;
     pltd_annot = 0;
@@ -1036,6 +1040,7 @@ int main(int argc, char *argv[])
         else if (c == 'e') max_eval = atof(opt.arg);
         else if (c == 'l') min_len = atoi(opt.arg);
         else if (c == 'o') out_pref = opt.arg;
+        else if (c == 't') n_threads = atoi(opt.arg);
         else if (c == 301) out_s = 0, ++out_c;
         else if (c == 302) out_s = 1, ++out_c;
         else if (c == 303) out_s = 2, ++out_c;
@@ -1066,7 +1071,7 @@ int main(int argc, char *argv[])
 
     if (argc == opt.ind || fp_help == stdout) {
         fprintf(fp_help, "\n");
-        fprintf(fp_help, "Usage: pathfinder [options] <file>[.gfa[.gz]]\n");
+        fprintf(fp_help, "Usage: pathfinder [options] <file>[.gfa[.gz]|.oagb]\n");
         fprintf(fp_help, "Options:\n");
         fprintf(fp_help, "  Input/Output:\n");
         fprintf(fp_help, "    -m FILE              mitochondria core gene annotation file [NULL]\n");
@@ -1079,6 +1084,7 @@ int main(int argc, char *argv[])
         fprintf(fp_help, "    --edge-c-tag STR     edge coverage tag in the GFA file [EC:i] \n");
         fprintf(fp_help, "    --kmer-c-tag STR     kmer coverage tag in the GFA file [KC:i] \n");
         fprintf(fp_help, "    --seq-c-tag  STR     sequence coverage tag in the GFA file [SC:f]\n");
+        fprintf(fp_help, "    -t INT               number of threads [%d]\n", n_threads);
         fprintf(fp_help, "    -v INT               verbose level [%d]\n", VERBOSE);
         fprintf(fp_help, "    --version            show version number\n");
         fprintf(fp_help, "  Classification:\n");
@@ -1138,10 +1144,16 @@ int main(int argc, char *argv[])
     }
 
     if (out_s < 0) out_s = 0;
+
+    // one thread pool for the whole run, handed down to every parallel stage
+    kt_ctx_t kc;
+    kt_ctx_init(&kc, n_threads);
     
-    ret = pathfinder(argv[opt.ind], mito_annot, pltd_annot, min_len, ext_p, ext_m, max_copy, 
+    ret = pathfinder(argv[opt.ind], 0, mito_annot, pltd_annot, min_len, ext_p, ext_m, max_copy, 
             max_eval, min_score, min_cf, seq_cf, no_trn, no_rrn, do_graph_clean, bubble_size, tip_size, weak_cross,
-            out_s, out_pref, VERBOSE);
+            out_s, out_pref, &kc, VERBOSE);
+
+    kt_ctx_destroy(&kc);
     
     if (ret) {
         fprintf(stderr, "[E::%s] failed to analysis the GFA file\n", __func__);
@@ -40,21 +40,39 @@
 
 KSTREAM_INIT(gzFile, gzread, 65536)
 
+typedef kvec_t(char *) kvec_t_char_p;
+
 int VERBOSE = 0;
 
 static ko_longopt_t long_options[] = {
     { "linear",  ko_no_argument,       301 },
+    { "no-index",ko_no_argument,       302 },
     { "verbose", ko_required_argument, 'v' },
     { "version", ko_no_argument,       'V' },
     { "help",    ko_no_argument,       'h' },
     { 0, 0, 0 }
 };
 
+// add the seg names in a path string as make_path_from_str() reads them
+// a malformed path is left for make_path_from_str() to report
+static void path_str_names(char *path_str, kvec_t_char_p *names)
+{
+    int l, rev;
+    char *p, *name, *s;
+    p = path_str;
+    while (path_str_next(&p, &name, &l, &rev) > 0) {
+        MYMALLOC(s, l + 1);
+        memcpy(s, name, l);
+        s[l] = '\0';
+        kv_push(char *, *names, s);
+    }
+}
+
 int main(int argc, char *argv[])
 {
     const char *opt_str = "p:s:l:n:o:Vv:h";
     ketopt_t opt = KETOPT_INIT;
-    int c, force_linear, line_width, gap_size, ret = 0;
+    int c, force_linear, line_width, gap_size, use_index, ret = 0;
     asg_t *g;
     FILE *fp_help, *out_seqs;
     char *out, *seq_id, *path_file, *path_str;
@@ -66,6 +84,7 @@ int main(int argc, char *argv[])
     force_linear = 0;
     line_width = 60;
     gap_size = 100;
+    use_index = 1;
     out = seq_id = path_file = path_str = 0;
 
     while ((c = ketopt(&opt, argc, argv, 1, opt_str, long_options)) >=0 ) {
@@ -74,6 +93,7 @@ int main(int argc, char *argv[])
         else if (c == 'l') line_width = atoi(opt.arg);
         else if (c == 'n') gap_size = atoi(opt.arg);
         else if (c == 301) force_linear = 1;
+        else if (c == 302) use_index = 0;
         else if (c == 'v') VERBOSE = atoi(opt.arg);
         else if (c == 'h') fp_help = stdout;
         else if (c == 'o') {
@@ -97,7 +117,7 @@ int main(int argc, char *argv[])
     
     if (argc == opt.ind || fp_help == stdout) {
         fprintf(fp_help, "\n");
-        fprintf(fp_help, "Usage: path_to_fasta [options] <file>[.gfa[.gz]] [path_str]\n");
+        fprintf(fp_help, "Usage: path_to_fasta [options] <file>[.gfa[.gz]|.oagb] [path_str]\n");
         fprintf(fp_help, "Options:\n");
         fprintf(fp_help, "    -p STR        two-column path file\n");
         fprintf(fp_help, "    -s STR        output sequence id\n");
@@ -106,6 +126,7 @@ int main(int argc, char *argv[])
         fprintf(fp_help, "    -o FILE       output results to FILE [stdout]\n");
         fprintf(fp_help, "    -v INT        verbose level [%d]\n", VERBOSE);
         fprintf(fp_help, "    --linear      force linear output\n");
+        fprintf(fp_help, "    --no-index    load the whole graph instead of the path segments via the index <file>.gfai\n");
         fprintf(fp_help, "    --version     show version number\n");
         fprintf(fp_help, "\n");
         fprintf(fp_help, "Example: ./path_to_fasta asm.gfa u1+,u2-,u3-,u2+\n\n");
@@ -140,16 +161,14 @@ int main(int argc, char *argv[])
         }
     }
 
-    g = asg_read(argv[opt.ind]);
-    if (g == 0) {
-        fprintf(stderr, "[E::%s] failed to read the graph: %s\n", __func__, argv[opt.ind]);
-        return 1;
-    }
-
-    path_v paths;
-    kv_init(paths);
+    // path strings are collected first so that only their segs need to be read
+    kvec_t_char_p sids, pstrs, names;
+    kv_init(sids);
+    kv_init(pstrs);
+    kv_init(names);
     if (path_str) {
-        kv_push(path_t, paths, make_path_from_str(g, path_str, seq_id? seq_id : 0));
+        kv_push(char *, sids, seq_id? strdup(seq_id) : 0);
+        kv_push(char *, pstrs, strdup(path_str));
     } else {
         gzFile fp;
         kstring_t s = {0,0,0};
@@ -185,15 +204,36 @@ int main(int argc, char *argv[])
                 return 1;
             }
             
-            kv_push(path_t, paths, make_path_from_str(g, p, sid));
-            free(sid);
+            kv_push(char *, sids, sid);
+            kv_push(char *, pstrs, strdup(p));
         }
-
+        free(s.s);
         ks_destroy(ks);
         gzclose(fp);
     }
 
     size_t i;
+    for (i = 0; i < pstrs.n; ++i)
+        path_str_names(pstrs.a[i], &names);
+    g = use_index? asg_read_gfai(argv[opt.ind], names.a, names.n) : 0;
+    if (g == 0) g = asg_read(argv[opt.ind], 0);
+    if (g == 0) {
+        fprintf(stderr, "[E::%s] failed to read the graph: %s\n", __func__, argv[opt.ind]);
+        return 1;
+    }
+
+    path_v paths;
+    kv_init(paths);
+    for (i = 0; i < pstrs.n; ++i)
+        kv_push(path_t, paths, make_path_from_str(g, pstrs.a[i], sids.a[i]));
+    for (i = 0; i < pstrs.n; ++i)
+        free(sids.a[i]), free(pstrs.a[i]);
+    for (i = 0; i < names.n; ++i)
+        free(names.a[i]);
+    kv_destroy(sids);
+    kv_destroy(pstrs);
+    kv_destroy(names);
+
     for (i = 0; i < paths.n; ++i)
         print_seq(g, &paths.a[i], out_seqs? out_seqs : stdout, i+1, force_linear, line_width, gap_size);
     
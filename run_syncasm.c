@@ -33,15 +33,18 @@
 #include <math.h>
 #include <errno.h>
 #include <limits.h>
+#include <sys/stat.h>
 
 #include "kvec.h"
 #include "kstring.h"
 
+#include "kthread.h"
 #include "misc.h"
 #include "sstream.h"
 #include "syncmer.h"
 #include "syncasm.h"
 #include "graph.h"
+#include "checkpoint.h"
 #include "version.h"
 
 #undef DEBUG_SYNCMER_SEQ
@@ -52,85 +55,62 @@
 #undef DEBUG_GRAPH_ERROR_CORRECTION
 
 void read_error_correction(sr_db_t *sr_db, scg_t *g, double max_edist, uint32_t err_mer_c, uint32_t max_err_c,
-        uint32_t err_arc_c, double max_arc_f, int threads, FILE *fo, int verbose);
-
-int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_size, int tip_size, int min_k_cov, double min_a_cov_f,
-        double weak_cross, int do_ec, int do_unzip, int n_threads, char *out, scg_meta_t *meta, int VERBOSE)
+        uint32_t err_arc_c, double max_arc_f, const kt_ctx_t *kc, FILE *fo, int verbose);
+
+// error correction, graph construction, unitigging, unzipping and output for one kmer coverage threshold
+// the graph and read alignments are returned for the in-memory hand-off
+// with checkpoints the stages already done are skipped and their state taken from 'ck'
+static int syncasm_graph(sr_db_t *sr_db, syncmer_db_t *scm_db, int k, int bubble_size, int tip_size, int min_k_cov,
+        double min_a_cov_f, double weak_cross, int do_ec, int do_unzip, const kt_ctx_t *kc, char *out, int out_bin,
+        int save_seq, ckpt_t *ck, scg_t **_scg, scg_ra_v **_ra_db, int VERBOSE)
 {
     FILE *fo;
-    sstream_t *sr_rdr;
     scg_t *scg;
-    sr_db_t *sr_db;
-    syncmer_db_t *scm_db;
     scg_ra_v *ra_db;
-    int ret = 0;
+    uint64_t cleaned;
+    int stage, ret = 0;
 
     scg = 0;
-    sr_db = 0;
-    scm_db = 0;
     ra_db = 0;
+    stage = ckpt_stage(ck);
 
-    sr_rdr = sstream_open(file_in, n_file);
-    if (sr_rdr == 0) {
-        fprintf(stderr, "[E::%s] failed to open files: %s\n", __func__, strerror(errno));
-        ret = 1;
-        goto do_clean;
-    }
-
-    MYMALLOC(sr_db, 1);
-    sr_db_init(sr_db, k, s);
-    sr_read(sr_rdr, sr_db, m_data, n_threads);
-    fprintf(stderr, "[M::%s] collected syncmers from %lu target sequence(s)\n", __func__, sr_rdr->n_seq);
-    sstream_close(sr_rdr);
-    if (sr_db_validate(sr_db)) {
-        ret = 1;
-        goto do_clean;
-    }
-    sr_db_stat(sr_db, stderr, VERBOSE);
-
-    if (min_k_cov == 0) {
-        min_k_cov = sr_db->stats->kmer_peak_het > 0? (sr_db->stats->kmer_peak_het * 10) : (sr_db->stats->kmer_peak_hom * 10);
-        fprintf(stderr, "[M::%s] set minimum kmer coverage as %d\n", __func__, min_k_cov);
+    if (stage >= CKPT_CLEAN) {
+        scg = ck->scg;
+        ck->scg = 0;
+        fprintf(stderr, "[M::%s] syncmer graph stats after cleanup\n", __func__);
+        scg_stat(scg, stderr, 0);
+        goto do_unzip;
     }
 
-#ifdef DEBUG_SYNCMER_SEQ
-    uint32_t i;
-    fo = open_outstream(out, "_syncmer_debug.fa");
-    for (i = 0; i < sr_db->n; ++i) print_all_syncmers_on_seq(&sr_db->a[i], s, k, fo);
-    fclose(fo);
-#endif
-
-    // make syncmer database
-    scm_db = collect_syncmer_from_reads(sr_db);
-    
     // syncmer_link_coverage_analysis(sr_db, scm_db, min_k_cov, 30, 30, .7, 0, 0, 0, VERBOSE);
     
-    if (do_ec) {
+    if (do_ec && stage < CKPT_EC) {
         // make syncmer graph with all syncmers for error correction
         scg = make_syncmer_graph(sr_db, scm_db, 0, 0.);
 #ifdef DEBUG_GRAPH_ERROR_CORRECTION
         // save sequence in graph
         fo = open_outstream(out, "_syncmer_hoco.gfa");
-        scg_consensus(sr_db, scg, 1, 1, fo);
+        scg_consensus(sr_db, scg, 1, 1, fo, 0);
         fclose(fo);
 #endif
         // do consensus in hoco space
-        scg_consensus(sr_db, scg, 1, 1, 0);
+        scg_consensus(sr_db, scg, 1, 1, 0, 0);
         // naive error finding without checking arc coverage
 #ifdef DEBUG_GRAPH_ERROR_CORRECTION
         fo = open_outstream(out, ".ec.fa");
 #else
         fo = 0;
 #endif
-        read_error_correction(sr_db, scg, 0.02, min_k_cov, min_k_cov * 10, min_k_cov, min_a_cov_f, n_threads, fo, VERBOSE);
+        read_error_correction(sr_db, scg, 0.02, min_k_cov, min_k_cov * 10, min_k_cov, min_a_cov_f, kc, fo, VERBOSE);
 #ifdef DEBUG_GRAPH_ERROR_CORRECTION
         fclose(fo);
         fo = open_outstream(out, "_syncmer_hoco.noerr.gfa");
         scg_print(scg, fo, 0);
         fclose(fo);
 #endif
-        sr_db_stat(sr_db, stderr, VERBOSE);
+        sr_db_stat(sr_db, scm_db, stderr, VERBOSE);
         scg_destroy(scg); scg = 0;
+        ckpt_save(ck, CKPT_EC, sr_db, scm_db, 0, 0, min_k_cov, 0);
         // goto do_clean;
     }
 
@@ -148,10 +128,10 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
 
 #ifdef DEBUG_SYNCMER_GRAPH
     fo = open_outstream(out, "_syncmer.gfa");
-    scg_consensus(sr_db, scg, 0, 0, fo);
+    scg_consensus(sr_db, scg, 0, 0, fo, 0);
     fclose(fo);
     MYCALLOC(ra_db, 1);
-    scg_read_alignment(sr_db, ra_db, scg, n_threads, 0);
+    scg_read_alignment(sr_db, ra_db, scg, kc, 0);
     fprintf(stderr, "[DEBUG_SYNCMER_GRAPH::%s] read alignment\n", __func__);
     scg_rv_print(ra_db, stderr);
     scg_ra_v_destroy(ra_db);
@@ -163,7 +143,7 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
     fprintf(stderr, "[M::%s] syncmer graph stats after unitigging\n", __func__);
     scg_stat(scg, stderr, 0);
     fo = open_outstream(out, ".utg.gfa");
-    scg_consensus(sr_db, scg, 0, 0, fo);
+    scg_consensus(sr_db, scg, 0, 0, fo, 0);
     fclose(fo);
 
     if (VERBOSE > 1) scg_subgraph_stat(scg, stderr);
@@ -171,7 +151,7 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
 #ifdef DEBUG_GRAPH_UNITIG
     scg_print_unitig_syncmer_list(scg, stderr);
     MYCALLOC(ra_db, 1);
-    scg_read_alignment(sr_db, ra_db, scg, n_threads, 0);
+    scg_read_alignment(sr_db, ra_db, scg, kc, 0);
     fprintf(stderr, "[DEBUG_GRAPH_UNITIG::%s] read alignment\n", __func__);
     scg_rv_print(ra_db, stderr);
     scg_ra_v_destroy(ra_db);
@@ -180,7 +160,7 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
     // do basic cleanup
     // already have consensus information
     fprintf(stderr, "[M::%s] syncmer graph cleanup\n", __func__);
-    uint64_t cleaned = 1;
+    cleaned = 1;
     while (cleaned) {
         // do not do bubble popping before unzipping to avoid removing haplotypes
         cleaned = 0;
@@ -191,12 +171,13 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
         cleaned += asmg_drop_tip(scg->utg_asmg, INT_MAX, tip_size, 1, 0, VERBOSE);
     }
     process_mergeable_unitigs(scg);
+    ckpt_save(ck, CKPT_CLEAN, sr_db, scm_db, scg, 0, min_k_cov, 0);
     
 #ifdef DEBUG_GRAPH_MULTIPLEX
     fprintf(stderr, "[M::%s] syncmer graph stats after cleanup\n", __func__);
     scg_stat(scg, stderr, 0);
     fo = open_outstream(out, ".utg.clean.gfa");
-    scg_consensus(sr_db, scg, 0, 0, fo);
+    scg_consensus(sr_db, scg, 0, 0, fo, 0);
     fclose(fo);
 #endif
 
@@ -204,7 +185,13 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
     scg_print_unitig_syncmer_list(scg, stderr);
 #endif
 
-    MYCALLOC(ra_db, 1);
+do_unzip:
+    if (stage > CKPT_CLEAN) {
+        ra_db = ck->ra_db;
+        ck->ra_db = 0;
+    } else {
+        MYCALLOC(ra_db, 1);
+    }
     // do read threading
     if (do_unzip > 0) {
         fprintf(stderr, "[M::%s] assembly graph unzipping\n", __func__);
@@ -217,9 +204,13 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
         // do multiplexing
         round = 0;
         updated = 1;
+        if (stage > CKPT_CLEAN) {
+            round = stage - CKPT_UNZIP;
+            updated = ck->aux;
+        }
         while (updated != 0 && round < do_unzip) {
             ++round;
-            scg_read_alignment(sr_db, ra_db, scg, n_threads, 1);
+            scg_read_alignment(sr_db, ra_db, scg, kc, 1);
             // scg_rv_print(ra_db, stderr);
             scg_update_utg_cov(scg);
             updated = scg_multiplex(scg, ra_db, max_n_scm, 10, .3);
@@ -227,12 +218,13 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
                 fprintf(stderr, "[M::%s] syncmer graph stats after multiplexing round %d\n", __func__, round);
                 scg_stat(scg, stderr, 0);
             }
+            ckpt_save(ck, CKPT_UNZIP + round, sr_db, scm_db, scg, ra_db, min_k_cov, updated);
 #ifdef DEBUG_GRAPH_MULTIPLEX
             char *out1;
             MYMALLOC(out1, strlen(out) + 36);
             sprintf(out1, "%s.utg.unzip.r%02d.gfa", out, round);
             fo = open_outstream(out1, "");
-            scg_consensus(sr_db, scg, 0, 0, fo);
+            scg_consensus(sr_db, scg, 0, 0, fo, 0);
             fclose(fo);
             free(out1);
             scg_print_unitig_syncmer_list(scg, stderr);
@@ -242,7 +234,7 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
         // arc coverage estimation from aligned reads
         // to remove weak cross arcs
         // only arc coverage is required
-        scg_read_alignment(sr_db, ra_db, scg, n_threads, 1);
+        scg_read_alignment(sr_db, ra_db, scg, kc, 1);
         scg_ra_arc_coverage(scg, sr_db, ra_db, 0, VERBOSE);
         asmg_remove_weak_crosslink(scg->utg_asmg, weak_cross, 10, 0, VERBOSE);
 
@@ -250,14 +242,14 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
         fprintf(stderr, "[M::%s] syncmer graph stats after multiplexing\n", __func__);
         scg_stat(scg, stderr, 0);
         fo = open_outstream(out, ".utg.multiplex.gfa");
-        scg_consensus(sr_db, scg, 0, 0, fo);
+        scg_consensus(sr_db, scg, 0, 0, fo, 0);
         fclose(fo);
 #endif
 
         // do demultiplexing
         scg_demultiplex(scg);
         // the arc coverage is lost
-        scg_read_alignment(sr_db, ra_db, scg, n_threads, 0);
+        scg_read_alignment(sr_db, ra_db, scg, kc, 0);
         scg_ra_utg_coverage(scg, sr_db, ra_db, VERBOSE);
         scg_ra_arc_coverage(scg, sr_db, ra_db, 1, VERBOSE);
         
@@ -265,11 +257,11 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
         fprintf(stderr, "[M::%s] syncmer graph stats after unzipping\n", __func__);
         scg_stat(scg, stderr, 0);
         fo = open_outstream(out, ".utg.unzip.gfa");
-        scg_consensus(sr_db, scg, 0, 0, fo);
+        scg_consensus(sr_db, scg, 0, 0, fo, 0);
         fclose(fo);
 #else
         // consensus infomration is required for basic cleanup
-        scg_consensus(sr_db, scg, 0, 0, 0);
+        scg_consensus(sr_db, scg, 0, 0, 0, 0);
 #endif
 
         // do basic cleanup
@@ -293,18 +285,240 @@ int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_
     }
 
     // unitig and arc coverage estimation
-    scg_read_alignment(sr_db, ra_db, scg, n_threads, 0);
+    scg_read_alignment(sr_db, ra_db, scg, kc, 0);
     scg_ra_utg_coverage(scg, sr_db, ra_db, VERBOSE);
     scg_ra_arc_coverage(scg, sr_db, ra_db, 1, VERBOSE);
 
     fprintf(stderr, "[M::%s] syncmer graph stats after final processing\n", __func__);
     scg_stat(scg, stderr, 0);
     fo = open_outstream(out, ".utg.final.gfa");
-    scg_consensus(sr_db, scg, 0, 0, fo);
+    if (out_bin) {
+        FILE *fb = open_outstream(out, ".utg.final.oagb");
+        oagb_w_t *w = oagb_w_init(fb);
+        // keep consensus sequences for the in-memory graph hand-off
+        scg_consensus(sr_db, scg, 0, save_seq, fo, w);
+        if (oagb_w_close(w)) ret = 1;
+        fclose(fb);
+    } else {
+        scg_consensus(sr_db, scg, 0, save_seq, fo, 0);
+    }
+    fclose(fo);
+
+do_clean:
+    *_scg = scg;
+    *_ra_db = ra_db;
+
+    return ret;
+}
+
+// syncmers of the bait sequences, made with the same k, s and homopolymer compression as the reads
+static sr_bait_t *syncasm_bait_load(char *file, int k, int s, int min_hit, const kt_ctx_t *kc)
+{
+    sstream_t *rdr;
+    sr_db_t *db;
+    sr_bait_t *bait;
+    size_t i, j;
+
+    rdr = sstream_open(&file, 1);
+    if (rdr == 0) {
+        fprintf(stderr, "[E::%s] failed to open file %s to read: %s\n", __func__, file, strerror(errno));
+        return 0;
+    }
+    MYMALLOC(db, 1);
+    sr_db_init(db, k, s);
+    sr_read(rdr, db, 0, 0, kc);
+    sstream_close(rdr);
+
+    bait = sr_bait_init(min_hit);
+    for (i = 0; i < db->n; ++i)
+        for (j = 0; j < db->a[i].n; ++j)
+            sr_bait_add(bait, db->a[i].s_mer[j]);
+    fprintf(stderr, "[M::%s] %lu bait syncmers from %lu sequence(s) in %s\n", __func__, sr_bait_size(bait), db->n, file);
+    sr_db_destroy(db);
+
+    return bait;
+}
+
+// add the syncmers of the assembled unitigs to the baits; return the number new
+static size_t syncasm_bait_extend(sr_bait_t *bait, scg_t *scg)
+{
+    uint64_t i, j;
+    size_t n_new;
+    asmg_vtx_t *vtx;
+    syncmer_t *scm;
+
+    n_new = 0;
+    scm = scg_a_scm(scg);
+    for (i = 0; i < scg_n_vtx(scg); ++i) {
+        vtx = &scg_a_vtx(scg)[i];
+        if (vtx->del) continue;
+        for (j = 0; j < vtx->n; ++j)
+            n_new += sr_bait_add(bait, scm[vtx->a[j]>>1].s);
+    }
+
+    return n_new;
+}
+
+int syncasm(char **file_in, int n_file, size_t m_data, int k, int s, int bubble_size, int tip_size, int min_k_cov, int *sweep_c,
+        int n_sweep, double min_a_cov_f, double weak_cross, int do_ec, int do_unzip, const kt_ctx_t *kc, char *out, int out_bin,
+        char *ckpt_dir, int resume, char *bait_file, int min_bait, int n_recruit, scg_meta_t *meta, int VERBOSE)
+{
+#ifdef DEBUG_SYNCMER_SEQ
+    FILE *fo;
+#endif
+    sstream_t *sr_rdr;
+    scg_t *scg;
+    sr_db_t *sr_db;
+    syncmer_db_t *scm_db;
+    scg_ra_v *ra_db;
+    ckpt_t *ck;
+    sr_bait_t *bait;
+    int round, ret = 0;
+
+    scg = 0;
+    sr_db = 0;
+    scm_db = 0;
+    ra_db = 0;
+    ck = 0;
+    bait = 0;
+    round = 0;
+
+    if (ckpt_dir) {
+        // parameters the assembly depends on; the number of threads is not one of them
+        char param[512];
+        int l = snprintf(param, sizeof(param), "k=%d s=%d D=%lu c=%d a=%.17g bubble=%d tip=%d cross=%.17g ec=%d unzip=%d",
+                k, s, m_data, min_k_cov, min_a_cov_f, bubble_size, tip_size, weak_cross, do_ec, do_unzip);
+        if (bait_file && l < (int) sizeof(param)) {
+            // an edited bait file invalidates the checkpoints as an edited input does
+            struct stat st = {0};
+            stat(bait_file, &st);
+            snprintf(param + l, sizeof(param) - l, " bait=%.200s:%ld:%ld:%d", bait_file,
+                    (long) st.st_size, (long) st.st_mtime, min_bait);
+        }
+        ck = ckpt_init(ckpt_dir, file_in, n_file, param, do_ec, resume);
+        if (ck == 0) {
+            ret = 1;
+            goto do_clean;
+        }
+    }
+
+    if (ckpt_stage(ck) >= CKPT_READ) {
+        sr_db = ck->sr_db;
+        scm_db = ck->scm_db;
+        ck->sr_db = 0;
+        ck->scm_db = 0;
+        if (min_k_cov == 0 && ck->min_k_cov > 0) { // zero if only the reads were saved
+            min_k_cov = ck->min_k_cov;
+            fprintf(stderr, "[M::%s] set minimum kmer coverage as %d\n", __func__, min_k_cov);
+        }
+        goto do_collect;
+    }
+
+    if (bait_file) {
+        int i;
+        for (i = 0; i < n_file && n_recruit > 0; ++i) {
+            if (!is_file(file_in[i])) {
+                fprintf(stderr, "[E::%s] recruitment rounds read the input again and need regular files: %s\n", __func__, file_in[i]);
+                ret = 1;
+                goto do_clean;
+            }
+        }
+        bait = syncasm_bait_load(bait_file, k, s, min_bait, kc);
+        if (bait == 0) {
+            ret = 1;
+            goto do_clean;
+        }
+    }
+
+do_read:
+    sr_rdr = sstream_open(file_in, n_file);
+    if (sr_rdr == 0) {
+        fprintf(stderr, "[E::%s] failed to open files: %s\n", __func__, strerror(errno));
+        ret = 1;
+        goto do_clean;
+    }
+
+    MYMALLOC(sr_db, 1);
+    sr_db_init(sr_db, k, s);
+    sr_read(sr_rdr, sr_db, m_data, bait, kc);
+    fprintf(stderr, "[M::%s] collected syncmers from %lu target sequence(s)\n", __func__, sr_rdr->n_seq);
+    sstream_close(sr_rdr);
+    if (sr_db_validate(sr_db)) {
+        ret = 1;
+        goto do_clean;
+    }
+    ckpt_save(ck, CKPT_READ, sr_db, 0, 0, 0, min_k_cov, 0);
+
+#ifdef DEBUG_SYNCMER_SEQ
+    uint32_t i;
+    fo = open_outstream(out, "_syncmer_debug.fa");
+    for (i = 0; i < sr_db->n; ++i) print_all_syncmers_on_seq(&sr_db->a[i], s, k, fo);
     fclose(fo);
+#endif
+
+do_collect:
+    // make syncmer database
+    if (ckpt_stage(ck) < CKPT_SCM) {
+        scm_db = collect_syncmer_from_reads(sr_db, kc);
+        // kmers are counted by their ids
+        sr_db_stat(sr_db, scm_db, stderr, VERBOSE);
+        if (min_k_cov == 0) {
+            min_k_cov = sr_db->stats->kmer_peak_het > 0? (sr_db->stats->kmer_peak_het * 10) : (sr_db->stats->kmer_peak_hom * 10);
+            fprintf(stderr, "[M::%s] set minimum kmer coverage as %d\n", __func__, min_k_cov);
+        }
+        if (scm_db) ckpt_save(ck, CKPT_SCM, sr_db, scm_db, 0, 0, min_k_cov, 0);
+    }
+
+    if (n_sweep > 0) {
+        // reads and syncmers are collected once for all thresholds
+        // error correction depends on the threshold so each run works on its own copy
+        // the last run takes over the originals
+        int i;
+        char *out1;
+        sr_db_t *sr_db1;
+        syncmer_db_t *scm_db1;
+        MYMALLOC(out1, strlen(out) + 16);
+        for (i = 0; i < n_sweep && ret == 0; ++i) {
+            sr_db1 = i < n_sweep - 1? sr_db_dup(sr_db) : sr_db;
+            scm_db1 = i < n_sweep - 1? syncmer_db_dup(scm_db) : scm_db;
+            sprintf(out1, "%s.c%d", out, sweep_c[i]);
+            fprintf(stderr, "[M::%s] assembly with minimum kmer coverage %d: %s\n", __func__, sweep_c[i], out1);
+            ret = syncasm_graph(sr_db1, scm_db1, k, bubble_size, tip_size, sweep_c[i], min_a_cov_f, weak_cross,
+                    do_ec, do_unzip, kc, out1, out_bin, 0, 0, &scg, &ra_db, VERBOSE);
+            scg_destroy(scg);
+            scg_ra_v_destroy(ra_db);
+            scg = 0, ra_db = 0;
+            if (sr_db1 != sr_db) {
+                syncmer_db_destroy(scm_db1);
+                sr_db_destroy(sr_db1);
+            }
+        }
+        free(out1);
+    } else {
+        ret = syncasm_graph(sr_db, scm_db, k, bubble_size, tip_size, min_k_cov, min_a_cov_f, weak_cross,
+                do_ec, do_unzip, kc, out, out_bin, meta != 0, ck, &scg, &ra_db, VERBOSE);
+        if (ret == 0 && bait && round < n_recruit) {
+            // recruit the reads reaching past the bait sequences through the new unitigs
+            // and assemble again; the output files are replaced each round
+            size_t n_new = syncasm_bait_extend(bait, scg);
+            fprintf(stderr, "[M::%s] recruitment round %d: %lu new bait syncmers from the assembly\n", __func__, ++round, n_new);
+            if (n_new > 0) {
+                scg_destroy(scg);
+                syncmer_db_destroy(scm_db);
+                sr_db_destroy(sr_db);
+                scg_ra_v_destroy(ra_db);
+                scg = 0, scm_db = 0, sr_db = 0, ra_db = 0;
+                goto do_read;
+            }
+        }
+    }
 
 do_clean:
-    if (meta) {
+    // checkpoints still being written refer to the reads
+    ckpt_destroy(ck);
+    sr_bait_destroy(bait);
+
+    if (meta && n_sweep <= 0) {
         scg_meta_clean(meta);
         meta->k = k;
         meta->s = s;
@@ -333,6 +547,13 @@ static ko_longopt_t long_options[] = {
     { "weak-cross", ko_required_argument, 303 },
     { "unzip-round",ko_required_argument, 304 },
     { "no-read-ec", ko_no_argument,       305 },
+    { "oagb",       ko_no_argument,       306 },
+    { "sweep-c",    ko_required_argument, 307 },
+    { "checkpoint-dir", ko_required_argument, 308 },
+    { "resume",     ko_no_argument,       309 },
+    { "bait",       ko_required_argument, 310 },
+    { "min-bait",   ko_required_argument, 311 },
+    { "recruit-round", ko_required_argument, 312 },
     { "threads",    ko_required_argument, 't' },
     { "verbose",    ko_required_argument, 'v' },
     { "version",    ko_no_argument,       'V' },
@@ -348,7 +569,9 @@ int main(int argc, char *argv[])
     size_t m_data;
     double min_a_cov_f, weak_cross;
     char *out;
-    int do_ec, do_unzip;
+    int do_ec, do_unzip, out_bin;
+    int *sweep_c, n_sweep, resume, min_bait, n_recruit;
+    char *ckpt_dir, *bait_file;
     FILE *fp_help = stderr;
     int ret = 0;
 
@@ -365,6 +588,14 @@ int main(int argc, char *argv[])
     m_data = 0;
     do_ec = 1;
     do_unzip = 3;
+    out_bin = 0;
+    sweep_c = 0;
+    n_sweep = 0;
+    ckpt_dir = 0;
+    resume = 0;
+    bait_file = 0;
+    min_bait = 3;
+    n_recruit = 0;
     out = "syncasm.asm";
 
     while ((c = ketopt(&opt, argc, argv, 1, opt_str, long_options)) >= 0) {
@@ -385,6 +616,20 @@ int main(int argc, char *argv[])
         else if (c == 303) weak_cross = atof(opt.arg);
         else if (c == 304) do_unzip = atoi(opt.arg);
         else if (c == 305) do_ec = 0;
+        else if (c == 306) out_bin = 1;
+        else if (c == 307) {
+            free(sweep_c);
+            n_sweep = parse_int_list(opt.arg, &sweep_c);
+            if (n_sweep < 0) {
+                fprintf(stderr, "[E::%s] invalid kmer coverage list: \"%s\"\n", __func__, opt.arg);
+                return 1;
+            }
+        }
+        else if (c == 308) ckpt_dir = opt.arg;
+        else if (c == 309) resume = 1;
+        else if (c == 310) bait_file = opt.arg;
+        else if (c == 311) min_bait = atoi(opt.arg);
+        else if (c == 312) n_recruit = atoi(opt.arg);
         else if (c == 'o') {
             if (strcmp(opt.arg, "-") != 0)
                 out = opt.arg;
@@ -413,9 +658,19 @@ int main(int argc, char *argv[])
         fprintf(fp_help, "    -s INT               smer size (no larger than 31) [%d]\n", s);
         fprintf(fp_help, "    -c INT               minimum kmer coverage [%d]\n", min_k_cov);
         fprintf(fp_help, "    -a FLOAT             minimum arc coverage [%.2f]\n", min_a_cov_f);
-        fprintf(fp_help, "    -D INT               maximum amount of data to use; suffix K/M/G recognized [%lu]\n", m_data);
+        fprintf(fp_help, "    -D INT               maximum amount of data to use, counting recruited reads only with --bait; suffix K/M/G recognized [%lu]\n", m_data);
         fprintf(fp_help, "    -t INT               number of threads [%d]\n", n_threads);
         fprintf(fp_help, "    -o FILE              prefix of output files [%s]\n", out);
+        fprintf(fp_help, "    --oagb               also write the final graph in the binary graph format (.oagb)\n");
+        fprintf(fp_help, "    --sweep-c     STR    comma separated minimum kmer coverages to assemble in one run;\n");
+        fprintf(fp_help, "                         overrides -c and writes PREFIX.cINT.* for each value []\n");
+        fprintf(fp_help, "    --checkpoint-dir DIR save the state after each expensive stage to DIR [NULL]\n");
+        fprintf(fp_help, "    --resume             continue from the last usable checkpoint in DIR\n");
+        fprintf(fp_help, "    --bait FILE          assemble only reads sharing syncmers with the related organelle\n");
+        fprintf(fp_help, "                         genome(s) in FILE [NULL]\n");
+        fprintf(fp_help, "    --min-bait INT       minimum number of shared syncmers to keep a read [%d]\n", min_bait);
+        fprintf(fp_help, "    --recruit-round INT  rounds of extending the baits with the assembled unitigs\n");
+        fprintf(fp_help, "                         and reassembling [%d]\n", n_recruit);
         fprintf(fp_help, "    --max-bubble  INT    maximum bubble size for assembly graph clean [%d]\n", bubble_size);
         fprintf(fp_help, "    --max-tip     INT    maximum tip size for assembly graph clean [%d]\n", tip_size);
         fprintf(fp_help, "    --weak-cross  FLOAT  maximum relative edge coverage for weak crosslink clean [%.2f]\n", weak_cross);
@@ -428,7 +683,36 @@ int main(int argc, char *argv[])
         return fp_help == stdout? 0 : 1;
     }
 
-    ret = syncasm(argv + opt.ind, argc - opt.ind, m_data, k, s, bubble_size, tip_size, min_k_cov, min_a_cov_f, weak_cross, do_ec, do_unzip, n_threads, out, 0, VERBOSE);
+    if (resume && !ckpt_dir) {
+        fprintf(stderr, "[E::%s] '--resume' option requires '--checkpoint-dir'\n", __func__);
+        return 1;
+    }
+
+    if (ckpt_dir && n_sweep > 0) {
+        fprintf(stderr, "[E::%s] '--checkpoint-dir' option is not compatible with '--sweep-c'\n", __func__);
+        return 1;
+    }
+
+    if (min_bait < 1 || n_recruit < 0) {
+        fprintf(stderr, "[E::%s] invalid '--min-bait' or '--recruit-round' value\n", __func__);
+        return 1;
+    }
+
+    if (n_recruit > 0 && (!bait_file || ckpt_dir || n_sweep > 0)) {
+        fprintf(stderr, "[E::%s] '--recruit-round' option requires '--bait' and is not compatible with '--checkpoint-dir' or '--sweep-c'\n", __func__);
+        return 1;
+    }
+
+    // one thread pool for the whole run, handed down to every parallel stage
+    kt_ctx_t kc;
+    kt_ctx_init(&kc, n_threads);
+
+    ret = syncasm(argv + opt.ind, argc - opt.ind, m_data, k, s, bubble_size, tip_size, min_k_cov, sweep_c, n_sweep,
+            min_a_cov_f, weak_cross, do_ec, do_unzip, &kc, out, out_bin, ckpt_dir, resume,
+            bait_file, min_bait, n_recruit, 0, VERBOSE);
+    free(sweep_c);
+
+    kt_ctx_destroy(&kc);
 
     if (ret) {
         fprintf(stderr, "[E::%s] failed to constrcut assembly\n", __func__);
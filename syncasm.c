@@ -713,9 +713,10 @@ static void str_reverse_complement(char *s, int l)
 }
 #endif
 
-void scg_consensus(sr_db_t *sr_db, scg_t *scg, int hoco_seq, int save_seq, FILE *fo)
+void scg_consensus(sr_db_t *sr_db, scg_t *scg, int hoco_seq, int save_seq, FILE *fo, oagb_w_t *fb)
 {
     uint64_t i, v, t, z, n;
+    uint32_t *fid;
     int64_t l;
     double cov;
     int w;
@@ -734,6 +735,8 @@ void scg_consensus(sr_db_t *sr_db, scg_t *scg, int hoco_seq, int save_seq, FILE
     scm = scg_a_scm(scg);
     utg_asmg = scg->utg_asmg;
     asmg_clean_consensus(utg_asmg); // clean consensus sequences
+    fid = 0;
+    if (fb) MYMALLOC(fid, utg_asmg->n_vtx); // binary record index of unitigs
     
     if (fo) fprintf(fo, "H\tVN:Z:1.0\n");
     for (i = 0, n = utg_asmg->n_vtx; i < n; ++i) {
@@ -764,6 +767,11 @@ void scg_consensus(sr_db_t *sr_db, scg_t *scg, int hoco_seq, int save_seq, FILE
             s->seq[l] = 0;
         }
         if (fo) fprintf(fo, "S\tu%lu\t%.*s\tLN:i:%ld\tKC:i:%ld\tSC:f:%.3f\n", i, (int) l, c_seq.s, l, (int64_t) (l*cov), cov);
+        if (fb) {
+            char name[32];
+            sprintf(name, "u%lu", i);
+            fid[i] = oagb_add_seg(fb, name, c_seq.s, l, l, (int64_t) (l*cov), cov, OAGB_F_LN | OAGB_F_KC | OAGB_F_SC);
+        }
 
 #ifdef DEBUG_UTG_COVERAGE
         uint64_t j;
@@ -814,8 +822,13 @@ void scg_consensus(sr_db_t *sr_db, scg_t *scg, int hoco_seq, int save_seq, FILE
             fprintf(fo, "L\tu%lu\t%c\tu%lu\t%c\t%ldM\tEC:i:%u\n", a->v>>1, "+-"[a->v&1], a->w>>1, "+-"[a->w&1], l, a->cov);
             fprintf(fo, "L\tu%lu\t%c\tu%lu\t%c\t%ldM\tEC:i:%u\n", a->w>>1, "-+"[a->w&1], a->v>>1, "-+"[a->v&1], l, a->cov);
         }
+        if (fb) {
+            oagb_add_arc(fb, fid[a->v>>1]<<1 | (a->v&1), fid[a->w>>1]<<1 | (a->w&1), l, a->cov, OAGB_F_EC);
+            oagb_add_arc(fb, fid[a->w>>1]<<1 | !(a->w&1), fid[a->v>>1]<<1 | !(a->v&1), l, a->cov, OAGB_F_EC);
+        }
     }
     
+    free(fid);
     free(c_seq.s);
 #ifdef DEBUG_CONSENSUS
     free(c_seq1.s);
@@ -961,21 +974,28 @@ int64_t scg_syncmer_consensus(sr_db_t *sr_db, syncmer_t *scm, int rev, int64_t b
         ho_rl = s->ho_rl;
         ho_l_rl = s->ho_l_rl;
         k = 0;
-        if (ho_l_rl)
-            for (j = 0; j < p; ++j)
-                if (ho_rl[j] == 255) ++k;
+        if (ho_l_rl) {
+            // binary search the first long run at or after p
+            uint32_t lo = 0, hi = ho_l_rl[0], mid;
+            while (lo < hi) {
+                mid = (lo + hi) >> 1;
+                if (ho_l_rl[mid*2+1] < p) lo = mid + 1;
+                else hi = mid;
+            }
+            k = lo * 2 + 2;
+        }
         if (r) {
             for (j = 0; j < l; ++j) {
-                rl = ho_rl[p+j];
-                if (rl == 255)
-                    rl = ho_l_rl[k++];
+                rl = sr_rl_get(ho_rl, p+j);
+                if (rl == SR_RL_ESC)
+                    rl = ho_l_rl[k], k += 2;
                 tot_rl[l-1-j] += rl;
             }
         } else {
             for (j = 0; j < l; ++j) {
-                rl = ho_rl[p+j];
-                if (rl == 255)
-                    rl = ho_l_rl[k++];
+                rl = sr_rl_get(ho_rl, p+j);
+                if (rl == SR_RL_ESC)
+                    rl = ho_l_rl[k], k += 2;
                 tot_rl[j] += rl;
             }
         }
@@ -1642,19 +1662,6 @@ typedef struct {
 
 typedef struct { size_t n, m; uint64_t *a; } lcs_block_t;
 
-static void lcs_backtrace(int **L, uint64_t *s_scm, int s_n, uint64_t *u_scm, int u_n, int offset, lcs_block_t *t)
-{
-    if (s_n == 0 || u_n == 0)
-        return;
-    if ((s_scm[s_n] >> 1) == (u_scm[u_n] >> 1)) {
-        kv_push(uint64_t, *t, (uint64_t) (s_n - 1 + offset) << 32 | 1);
-        return lcs_backtrace(L, s_scm, s_n - 1, u_scm, u_n - 1, offset, t);
-    }
-    if (L[s_n][u_n - 1] > L[s_n - 1][u_n])
-        return lcs_backtrace(L, s_scm, s_n, u_scm, u_n - 1, offset, t);
-    return lcs_backtrace(L, s_scm, s_n - 1, u_scm, u_n, offset, t);
-}
-
 static void lcs_block_merge(lcs_block_t *blocks)
 {
     // merge blocks
@@ -1670,10 +1677,37 @@ static void lcs_block_merge(lcs_block_t *blocks)
     }
 }
 
-// TODO use max_d for banded LCS
-static uint64_t *find_lcs(uint64_t *s_scm, int s_n, uint64_t *u_scm, int u_n, int offset, int max_d, int *n_block)
+typedef struct { uint64_t s; uint32_t j; } lcs_sym_t;
+
+static int lcs_sym_cmpfunc(const void *a, const void *b)
+{
+    uint64_t x, y;
+    x = ((lcs_sym_t *) a)->s;
+    y = ((lcs_sym_t *) b)->s;
+    if (x != y)
+        return (x > y) - (x < y);
+    return (((lcs_sym_t *) a)->j > ((lcs_sym_t *) b)->j) - (((lcs_sym_t *) a)->j < ((lcs_sym_t *) b)->j);
+}
+
+// row bit vectors of the bit-parallel LCS (Hyyro 2004)
+// a zero bit j-1 in row i means L[i][j] = L[i][j-1] + 1
+#define lcs_bv_inc(v, j) (!((v)[((j)-1)>>6] >> (((j)-1)&63) & 1))
+
+// L[i][j] from the bit vector of row i
+static int lcs_bv_count(uint64_t *v, int j)
 {
-    int i, j, start, s_end, u_end;
+    int k, c;
+    for (k = c = 0; k < j>>6; ++k)
+        c += __builtin_popcountll(~v[k]);
+    if (j & 63)
+        c += __builtin_popcountll(~v[k] & ((1ULL << (j&63)) - 1));
+    return c;
+}
+
+// max_d is not used; the bit-parallel LCS is exact and cheap enough without a band
+static uint64_t *find_lcs(uint32_t *s_scm, int s_n, uint64_t *u_scm, int u_n, int offset, int max_d, int *n_block)
+{
+    int i, j, k, l, w, a, b, start, s_end, u_end;
     lcs_block_t blocks;
 
     kv_init(blocks);
@@ -1695,27 +1729,76 @@ static uint64_t *find_lcs(uint64_t *s_scm, int s_n, uint64_t *u_scm, int u_n, in
     s_end = s_end - start + 1;
     u_end = u_end - start + 1;
 
-    // core LCS
-    int *D, **L;
-    MYCALLOC(D, (s_end + 1) * (u_end + 1));
-    MYMALLOC(L, s_end + 1);
-    L[0] = D;
-    for (i = 1; i <= s_end; ++i) {
-        L[i] = &L[i - 1][u_end + 1];
-        for (j = 1; j <= u_end; ++j) {
-            if ((s_scm[i - 1] >> 1) == (u_scm[j - 1] >> 1))
-                L[i][j] = L[i - 1][j - 1] + 1;
-            else
-                L[i][j] = MAX(L[i - 1][j], L[i][j - 1]);
+    uint32_t n_b = blocks.n;
+    if (s_end > 0 && u_end > 0) {
+        // core LCS
+        // bit-parallel over the unitig syncmers, one bit vector per read syncmer
+        // takes s_end * u_end / 64 words instead of a full DP matrix
+        uint64_t *V, *M, *v, *v1, x, y, t, c;
+        lcs_sym_t *sym;
+        w = (u_end + 63) >> 6;
+        MYMALLOC(V, (size_t) (s_end + 1) * w);
+        MYMALLOC(M, w);
+        MYMALLOC(sym, u_end);
+        for (j = 0; j < u_end; ++j) {
+            sym[j].s = u_scm[j] >> 1;
+            sym[j].j = j;
         }
+        qsort(sym, u_end, sizeof(lcs_sym_t), lcs_sym_cmpfunc);
+
+        memset(V, 0xFF, sizeof(uint64_t) * w);
+        for (i = 1; i <= s_end; ++i) {
+            // match mask of read syncmer i-1 over unitig syncmers
+            MYBZERO(M, w);
+            x = s_scm[i - 1] >> 1;
+            for (k = 0, l = u_end; k < l; ) {
+                j = (k + l) >> 1;
+                if (sym[j].s < x) k = j + 1;
+                else l = j;
+            }
+            for (; k < u_end && sym[k].s == x; ++k)
+                M[sym[k].j >> 6] |= 1ULL << (sym[k].j & 63);
+            // V' = (V + (V & M)) | (V & ~M)
+            v1 = &V[(size_t) (i - 1) * w];
+            v = &V[(size_t) i * w];
+            for (k = 0, c = 0; k < w; ++k) {
+                y = v1[k] & M[k];
+                t = v1[k] + y;
+                x = t + c;
+                c = (t < v1[k]) | (x < t);
+                v[k] = x | (v1[k] & ~M[k]);
+            }
+        }
+        free(M);
+        free(sym);
+
+        // LCS backtrace
+        // a = L[i][j] and b = L[i-1][j]
+        i = s_end;
+        j = u_end;
+        a = lcs_bv_count(&V[(size_t) i * w], j);
+        b = lcs_bv_count(&V[(size_t) (i - 1) * w], j);
+        while (i > 0 && j > 0) {
+            v = &V[(size_t) i * w];
+            v1 = &V[(size_t) (i - 1) * w];
+            if ((s_scm[i - 1] >> 1) == (u_scm[j - 1] >> 1)) {
+                kv_push(uint64_t, blocks, (uint64_t) (i - 1 + offset + start) << 32 | 1);
+                a = b - lcs_bv_inc(v1, j);
+                --i, --j;
+                b = i > 0? lcs_bv_count(&V[(size_t) (i - 1) * w], j) : 0;
+            } else if (a - lcs_bv_inc(v, j) > b) {
+                a -= lcs_bv_inc(v, j);
+                b -= lcs_bv_inc(v1, j);
+                --j;
+            } else {
+                a = b;
+                --i;
+                b = i > 0? lcs_bv_count(&V[(size_t) (i - 1) * w], j) : 0;
+            }
+        }
+        free(V);
     }
 
-    // LCS backtrace
-    uint32_t n_b = blocks.n;
-    lcs_backtrace(L, s_scm - 1, s_end, u_scm - 1, u_end, offset + start, &blocks);
-    free(D);
-    free(L);
-
     // reverse backtrace array
     array_reverse(&blocks.a[n_b], blocks.n - n_b);
 
@@ -1748,8 +1831,8 @@ static uint64_t *find_lcs(uint64_t *s_scm, int s_n, uint64_t *u_scm, int u_n, in
 
 static void make_ma_block(scg_t *g, sr_t *sr, scg_ra_t *ra, uint32_t n, ma_t *ma)
 {
-    uint32_t i, j, n_scm, n_frg;
-    uint64_t uid, *scm, *u_scm, *lcs_b, s_beg, u_n, s_n;
+    uint32_t i, j, n_scm, n_frg, *scm;
+    uint64_t uid, *u_scm, *lcs_b, s_beg, u_n, s_n;
     double score, intpart;
     int max_d, n_b;
     ra_frg_t *frg;
@@ -1860,7 +1943,7 @@ ma_done:
     ma->u = u_match.a;
 
 #ifdef DEBUG_LCS_MALIGN
-    fprintf(stderr, "[DEBUG_LCS_MALIGN::%s] MA BLOCKs of read %lu - %s\n", __func__, sr->sid, sr->sname);
+    fprintf(stderr, "[DEBUG_LCS_MALIGN::%s] MA BLOCKs of read %u - %s\n", __func__, sr->sid, sr->sname);
     for (i = 0; i < ma->a; ++i) {
         fprintf(stderr, "[DEBUG_LCS_MALIGN::%s] MA_RECORD %u -", __func__, i);
         for (j = 0; j < ma->b; ++j)
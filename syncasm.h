@@ -34,6 +34,7 @@
 #include "kstring.h"
 #include "syncmer.h"
 #include "graph.h"
+#include "oagb.h"
 
 #define scg_utg_t asmg_vtx_t
 #define scg_n_scm(g) ((g)->scm_db->n)
@@ -77,7 +78,12 @@ typedef struct {
     double s; // alignment score s.(1/n)
 } scg_ra_t;
 
-typedef struct {size_t n, m; scg_ra_t *a;} scg_ra_v;
+typedef struct {
+    size_t n, m;
+    scg_ra_t *a;
+    int all; // every read was mapped, otherwise only reads selected for unzipping
+    void *ref; // snapshot of the unitig graph the alignments were made against
+} scg_ra_v;
 
 typedef struct {
     int k, s;
@@ -98,7 +104,7 @@ void process_mergeable_unitigs(scg_t *g);
 int scg_is_empty(scg_t *scg);
 void scg_stat(scg_t *scg, FILE *fo, uint64_t *stats);
 void scg_subgraph_stat(scg_t *scg, FILE *fo);
-void scg_consensus(sr_db_t *sr_db, scg_t *scg, int hoco_seq, int save_seq, FILE *fo);
+void scg_consensus(sr_db_t *sr_db, scg_t *scg, int hoco_seq, int save_seq, FILE *fo, oagb_w_t *fb);
 void scg_update_utg_cov(scg_t *scg);
 void scg_print(scg_t *g, FILE *fo, int no_seq);
 void scg_print_unitig_syncmer_list(scg_t *g, FILE *fo);
@@ -107,7 +113,7 @@ int64_t scg_unitig_consensus(sr_db_t *sr_db, uint64_t *v, uint64_t n, syncmer_t
 int scg_multiplex(scg_t *g, scg_ra_v *ra_v, uint32_t max_n_scm, double min_n_r, double min_d_f);
 void scg_demultiplex(scg_t *g);
 void scg_ra_v_destroy(scg_ra_v *ra_v);
-void scg_read_alignment(sr_db_t *sr_db, scg_ra_v *ra_v, scg_t *g, int n_threads, int for_unzip);
+void scg_read_alignment(sr_db_t *sr_db, scg_ra_v *ra_v, scg_t *g, const kt_ctx_t *kc, int for_unzip);
 void scg_ra_utg_coverage(scg_t *g, sr_db_t *sr_db, scg_ra_v *ra_v, int verbose);
 void scg_ra_arc_coverage(scg_t *g, sr_db_t *sr_db, scg_ra_v *ra_v, int refine, int verbose);
 void scg_refine_arc_coverage(scg_t *g, int verbose);
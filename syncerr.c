@@ -38,6 +38,7 @@
 #include "kvec.h"
 #include "kstring.h"
 #include "kthread.h"
+#include "kalloc.h"
 
 #include "syncmer.h"
 #include "syncasm.h"
@@ -66,12 +67,13 @@ typedef struct {
     int status, n_path, edist, s_edist;
     kstring_t c_seq, opt_seq;
     kvec64_t c_path, opt_path;
+    void *km; // thread-local arena for DP matrix snapshots
 } dfs_info_t;
 
 typedef struct {
     wf_config_t *conf;
     kstring_t *seq, *c_seq;
-    kvec64_t *c_kmer;
+    kvec32_t *c_kmer;
     kvec32_t *c_mpos;
     dfs_info_t *dfs;
     long stats[11]; // tail_err ec_status[4] middle_err ec_status[4] overlap_err
@@ -83,10 +85,9 @@ typedef struct {
     double max_edist;
     ec_cached_t *cache;
     FILE *fo;
+    pthread_mutex_t mutex; // guards fo; per call so samples sharing a process do not contend
 } ec_shared_t;
 
-pthread_mutex_t mutex;
-
 static void dfs_info_destroy(dfs_info_t *dfs)
 {
     if (!dfs) return;
@@ -94,6 +95,7 @@ static void dfs_info_destroy(dfs_info_t *dfs)
     free(dfs->opt_seq.s);
     free(dfs->c_path.a);
     free(dfs->opt_path.a);
+    km_destroy(dfs->km);
     free(dfs);
 }
 
@@ -168,7 +170,7 @@ static void dfs_search(asmg_t *asmg, syncmer_t *scms, dfs_info_t *dfs_info, uint
     s0 = conf->score;
     d0 = conf->wf_diag->n;
     // make a copy of DP matrix
-    MYMALLOC(wf_diag1, d0);
+    KMALLOC(dfs_info->km, wf_diag1, d0);
     memcpy(wf_diag1, conf->wf_diag->a, sizeof(wf_diag1_t) * d0);
 
     // process each arc
@@ -285,7 +287,7 @@ static void dfs_search(asmg_t *asmg, syncmer_t *scms, dfs_info_t *dfs_info, uint
         memcpy(conf->wf_diag->a, wf_diag1, sizeof(wf_diag1_t) * d0);
     }
     
-    free(wf_diag1);
+    kfree(dfs_info->km, wf_diag1);
 }
 
 int error_correction_by_graph_path_search(asmg_t *asmg, syncmer_t *scms, uint64_t source, uint64_t sink, wf_config_t *conf, dfs_info_t *dfs_info) {
@@ -343,8 +345,8 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
     sr_t *sr;
     asmg_t *asmg;
     syncmer_t *scms;
-    uint32_t *m_pos, beg_pos, end_pos;
-    uint64_t *k_mer, beg_utg, end_utg;
+    uint32_t *k_mer, *m_pos, beg_pos, end_pos;
+    uint64_t beg_utg, end_utg;
     int32_t j, l, r, n, n_scm, kmer_size, beg, end;
     int updated;
     double max_edist;
@@ -353,7 +355,7 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
     wf_config_t *conf;
     dfs_info_t *dfs;
     kstring_t *seq, *c_seq;
-    kvec64_t *c_kmer;
+    kvec32_t *c_kmer;
     kvec32_t *c_mpos;
 
     asmg = shared->g->utg_asmg;
@@ -375,7 +377,7 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
 
 #ifdef DEBUG_SYNCMER_CORRECTION
     // read information for debugging
-    fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] %lu %s %u %u:", __func__, 
+    fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] %u %s %u %u:", __func__, 
             sr->sid, sr->sname, sr->hoco_l, sr->n);
     for (j = 0; j < n_scm; ++j) {
         if (j > 0) { // print arc coverage
@@ -383,11 +385,11 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
                         (k_mer[j-1]&MASK_ONE) | (m_pos[j-1]&1),
                         (k_mer[j]&MASK_ONE) | (m_pos[j]&1))->cov);
         }
-        fprintf(stderr, " (%d u%lu%c %u)", j, k_mer[j]>>1, "+-"[m_pos[j]&1], scms[k_mer[j]>>1].cov);
+        fprintf(stderr, " (%d u%u%c %u)", j, k_mer[j]>>1, "+-"[m_pos[j]&1], scms[k_mer[j]>>1].cov);
     }
     fputc('\n', stderr);
     // position of syncmers on read
-    fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] %lu %s %u %u:", __func__,
+    fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] %u %s %u %u:", __func__,
             sr->sid, sr->sname, sr->hoco_l, sr->n);
     for (j = 0; j < n_scm; ++j) fprintf(stderr, " %u", m_pos[j]>>1);
     fputc('\n', stderr);
@@ -416,7 +418,7 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
                 break;
 
 #ifdef DEBUG_SYNCMER_CORRECTION
-        fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] RID %lu ERROR BLOCK %d: %d %d\n", __func__, sr->sid, ++err_block, beg, end);
+        fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] RID %u ERROR BLOCK %d: %d %d\n", __func__, sr->sid, ++err_block, beg, end);
 #endif
 
         // do error correction for reads with at least one syncmer anchor
@@ -486,7 +488,7 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
                 err_c1 = error_correction_by_graph_path_search(asmg, scms, beg_utg, end_utg, conf, dfs);
 
 #ifdef DEBUG_SYNCMER_CORRECTION
-                fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] RID %lu ERROR BLOCK %d [%s] (PATH = %d): %u %d (u%lu%c u%lu%c) %.*s\n",
+                fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] RID %u ERROR BLOCK %d [%s] (PATH = %d): %u %d (u%lu%c u%lu%c) %.*s\n",
                         __func__, sr->sid, err_block, EC_STATUS[err_c1], dfs->n_path, 
                         beg_pos, l, beg_utg>>1, "+-"[beg_utg&1], end_utg>>1, "+-"[end_utg&1], l, seq->s);
 #endif
@@ -504,7 +506,7 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
                 err_c1 = EC_FAILURE;
                 ++stats[10];
 #ifdef DEBUG_SYNCMER_CORRECTION
-                fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::WARN::%s] RID %lu ERROR BLOCK %d FLANKING SYNCMER OVERLAPPED: %u %d (%lu%c %lu%c)\n",
+                fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::WARN::%s] RID %u ERROR BLOCK %d FLANKING SYNCMER OVERLAPPED: %u %d (%lu%c %lu%c)\n",
                         __func__, sr->sid, err_block, beg_pos, l, beg_utg>>1, "+-"[beg_utg&1], end_utg>>1, "+-"[end_utg&1]);
                 print_aligned_syncmers_on_seq(sr, kmer_size, 0, UINT32_MAX, stderr);
 #endif
@@ -517,27 +519,27 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
                 if (r) {
                     // end_utg == UINT64_MAX
                     for (j = n - 1; j > 0; --j) {
-                        kv_push(uint64_t, *c_kmer, (dfs->opt_path.a[j]&MASK_ONE) | 1);
+                        kv_push(uint32_t, *c_kmer, (dfs->opt_path.a[j]&MASK_ONE) | 1);
                         kv_push(uint32_t, *c_mpos, UINT32_MAX ^ (dfs->opt_path.a[j]&1));
                     }
                 } else {
                     for (j = 1; j < n - 1; ++j) {
-                        kv_push(uint64_t, *c_kmer, (dfs->opt_path.a[j]&MASK_ONE) | 1);
+                        kv_push(uint32_t, *c_kmer, (dfs->opt_path.a[j]&MASK_ONE) | 1);
                         kv_push(uint32_t, *c_mpos, MASK_ONE | (dfs->opt_path.a[j]&1));
                     }
                     if (end_utg == UINT64_MAX && n > 1) {
                         // j == n-1
-                        kv_push(uint64_t, *c_kmer, (dfs->opt_path.a[j]&MASK_ONE) | 1);
+                        kv_push(uint32_t, *c_kmer, (dfs->opt_path.a[j]&MASK_ONE) | 1);
                         kv_push(uint32_t, *c_mpos, MASK_ONE | (dfs->opt_path.a[j]&1));
                     }
                 }
             } else {
                 // append the original sycnmer list
                 if (r) {
-                    kv_pushn(uint64_t, *c_kmer, k_mer, beg);
+                    kv_pushn(uint32_t, *c_kmer, k_mer, beg);
                     kv_pushn(uint32_t, *c_mpos, m_pos, beg);
                 } else if (beg + 1 < n_scm) {
-                    kv_pushn(uint64_t, *c_kmer, &k_mer[beg + 1], end - beg - 1);
+                    kv_pushn(uint32_t, *c_kmer, &k_mer[beg + 1], end - beg - 1);
                     kv_pushn(uint32_t, *c_mpos, &m_pos[beg + 1], end - beg - 1);
                 }
             }
@@ -565,11 +567,11 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
         } else {
             // no good syncmers on the read
 #ifdef DEBUG_SYNCMER_CORRECTION
-            pthread_mutex_lock(&mutex);
-            fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] %s RID %lu no correct syncmers L=%u N=%u:", __func__, sr->sname, sr->sid, sr->hoco_l, sr->n);
+            pthread_mutex_lock(&shared->mutex);
+            fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] %s RID %u no correct syncmers L=%u N=%u:", __func__, sr->sname, sr->sid, sr->hoco_l, sr->n);
             for (j = 0; j < n_scm; ++j) fprintf(stderr, " %u", scms[k_mer[j]>>1].cov);
             fputc('\n', stderr);
-            pthread_mutex_unlock(&mutex);
+            pthread_mutex_unlock(&shared->mutex);
 #endif
             updated = 0;
         }
@@ -584,7 +586,7 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
         if (beg > n_scm) break;
 
         // append kmer and mpos between [end, beg-1]
-        kv_pushn(uint64_t, *c_kmer, &k_mer[end], beg - end);
+        kv_pushn(uint32_t, *c_kmer, &k_mer[end], beg - end);
         kv_pushn(uint32_t, *c_mpos, &m_pos[end], beg - end);
 
         // append sequence between [end, beg-1]
@@ -601,14 +603,11 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
     if (updated) {
         // here is to update syncmer seq for the read
         // TODO need to consider data consistency
-        size_t s, n_c = c_kmer->n;
+        size_t n_c = c_kmer->n;
         MYREALLOC(sr->k_mer, n_c);
-        memcpy(sr->k_mer, c_kmer->a, sizeof(uint64_t) * n_c);
+        memcpy(sr->k_mer, c_kmer->a, sizeof(uint32_t) * n_c);
         MYREALLOC(sr->m_pos, n_c);
         memcpy(sr->m_pos, c_mpos->a, sizeof(uint32_t) * n_c);
-        MYREALLOC(sr->s_mer, n_c);
-        for (s = 0; s < n_c; ++s)
-            sr->s_mer[s] = scms[sr->k_mer[s]>>1].s;
         sr->n = n_c;
     }
 
@@ -619,14 +618,14 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
             get_kmer_dna_seq(sr->hoco_s, 0, l, 0, c_seq->s);
             c_seq->l = l;
         }
-        pthread_mutex_lock(&mutex);
+        pthread_mutex_lock(&shared->mutex);
         fprintf(fo, ">%s\n%.*s\n", sr->sname, (int) c_seq->l, c_seq->s);
-        pthread_mutex_unlock(&mutex);
+        pthread_mutex_unlock(&shared->mutex);
     }
 
 #ifdef DEBUG_SYNCMER_CORRECTION
     // read information for debugging
-    fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] ERROR CORRECTION RESULT - %lu %s %u %u:", __func__,
+    fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] ERROR CORRECTION RESULT - %u %s %u %u:", __func__,
             sr->sid, sr->sname, sr->hoco_l, sr->n);
     n_scm = sr->n;
     k_mer = sr->k_mer;
@@ -637,11 +636,11 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
                         (k_mer[j-1]&MASK_ONE) | (m_pos[j-1]&1),
                         (k_mer[j]&MASK_ONE) | (m_pos[j]&1))->cov);
         }
-        fprintf(stderr, " (%d u%lu%c %u)", j, k_mer[j]>>1, "+-"[m_pos[j]&1], scms[k_mer[j]>>1].cov);
+        fprintf(stderr, " (%d u%u%c %u)", j, k_mer[j]>>1, "+-"[m_pos[j]&1], scms[k_mer[j]>>1].cov);
     }
     fputc('\n', stderr);
     // position of syncmers on read
-    fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] ERROR CORRECTION RESULT - %lu %s %u %u:", __func__,
+    fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] ERROR CORRECTION RESULT - %u %s %u %u:", __func__,
             sr->sid, sr->sname, sr->hoco_l, sr->n);
     for (j = 0; j < n_scm; ++j) fprintf(stderr, " %u", m_pos[j]>>1);
     fputc('\n', stderr);
@@ -660,7 +659,7 @@ static void read_error_correction_analysis_thread(void *_data, long i, int tid)
         wf_print_alignment(seq->s, seq->l, c_seq->s, c_seq->l, cigar, n_cigar, 0, stderr);
         free(cigar);
         if (score != edist)
-            fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::WARN::%s] RID %lu INCONSISTENT ERROR CORRECTION RESULT - EC=%d, EDIST=%d\n", 
+            fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::WARN::%s] RID %u INCONSISTENT ERROR CORRECTION RESULT - EC=%d, EDIST=%d\n", 
                     __func__, sr->sid, score, edist);
     }
 #endif
@@ -771,8 +770,8 @@ static void update_syncmer_db(sr_db_t *sr_db, syncmer_db_t *scm_db)
 {
     uint64_t i, j, k, n, m;
     syncmer_t *scms;
-    uint64_t *k_mer, sid;
-    uint32_t *m_pos, *c_cov;
+    uint64_t sid;
+    uint32_t *k_mer, *m_pos, *c_cov;
     // clean scm_db
     free(scm_db->c); scm_db->c = 0;
     free(scm_db->h); scm_db->h = 0;
@@ -818,14 +817,14 @@ static void update_syncmer_db(sr_db_t *sr_db, syncmer_db_t *scm_db)
 // the syncmer consensus sequences need to be presented in input syncmer graph
 // max_edist = 0.02 max edit distance to correct a read
 void read_error_correction(sr_db_t *sr_db, scg_t *g, double max_edist, uint32_t err_mer_c, uint32_t max_err_c, 
-        uint32_t err_arc_c, double max_arc_f, int n_threads, FILE *fo, int verbose)
+        uint32_t err_arc_c, double max_arc_f, const kt_ctx_t *kc, FILE *fo, int verbose)
 {
-    if (n_threads <= 0)
-        n_threads = 1;
+    int n_threads = kc? kc->n_threads : 1;
 
 #ifdef DEBUG_SYNCMER_CORRECTION
     if (n_threads > 1) {
         n_threads = 1;
+        kc = 0;
         fprintf(stderr, "[DEBUG_SYNCMER_CORRECTION::%s] set thread number to one for debugging mode\n", __func__);
     }
 #endif
@@ -867,6 +866,7 @@ void read_error_correction(sr_db_t *sr_db, scg_t *g, double max_edist, uint32_t
         MYCALLOC(cached[t].c_kmer, 1);
         MYCALLOC(cached[t].c_mpos, 1);
         MYCALLOC(cached[t].dfs, 1);
+        cached[t].dfs->km = km_init();
         MYBZERO(cached[t].stats, 11);
     }
 
@@ -876,12 +876,12 @@ void read_error_correction(sr_db_t *sr_db, scg_t *g, double max_edist, uint32_t
     shared.cache = cached;
     shared.fo = fo;
     
-    if (pthread_mutex_init(&mutex, NULL) != 0) {
+    if (pthread_mutex_init(&shared.mutex, NULL) != 0) {
         fprintf(stderr, "[E::%s] pthread mutex init failed\n", __func__);
         goto do_clean;
     }
-    kt_for(n_threads, read_error_correction_analysis_thread, &shared, sr_db->n);
-    pthread_mutex_destroy(&mutex);
+    kt_ctx_for(kc, read_error_correction_analysis_thread, &shared, sr_db->n);
+    pthread_mutex_destroy(&shared.mutex);
     
     /***
     uint64_t rids[] = {0, 9, 15, 21, 31}; //{9007, 58477, 59602, 89548, 129398, 192, 15778, 24013, 25430, 44358, 102676, 103790, 129066, 140012};
@@ -30,9 +30,10 @@
 #include <stdio.h>
 #include <assert.h>
 #include <math.h>
-#include <pthread.h>
 
 #include "misc.h"
+#include "kalloc.h"
+#include "kthread.h"
 #include "khashl.h"
 #include "kvec.h"
 #include "syncmer.h"
@@ -170,9 +171,9 @@ uint64_t MurmurHash64A(const void *key, uint32_t len, uint64_t seed)
 }
 
 #ifdef DEBUG_KMER_EXTRACTION
-static uint64_t kmer_hash64(uint64_t sid, uint8_t *s, uint32_t p, int w)
+static uint64_t kmer_hash64(void *km, uint64_t sid, uint8_t *s, uint32_t p, int w)
 #else
-static uint64_t kmer_hash64(uint8_t *s, uint32_t p, int w)
+static uint64_t kmer_hash64(void *km, uint8_t *s, uint32_t p, int w)
 #endif
 {
     uint64_t h64;
@@ -187,7 +188,7 @@ static uint64_t kmer_hash64(uint8_t *s, uint32_t p, int w)
     // res = rev? 6 - p1 % 4 * 2 : p0 % 4 * 2; // shift bits
     res = rev? ((p1&3)^3)<<1 : (p0&3)<<1;
     b = p1 / 4 - p0 / 4 + 1; // number bytes holding syncmer
-    MYMALLOC(key, b);
+    KMALLOC(km, key, b);
     memcpy(key, s + p0 / 4, b);
     // key[b-1] needs bit shift
     // when the last byte is partially filled
@@ -221,11 +222,21 @@ static uint64_t kmer_hash64(uint8_t *s, uint32_t p, int w)
     fputc('\n', stderr);
 #endif
 
-    free(key);
+    kfree(km, key);
     
     return h64;
 }
 
+// kmer hash of the n-th syncmer on a read
+static inline uint64_t sr_kmer_hash(void *km, sr_t *sr, uint32_t n, int w)
+{
+#ifdef DEBUG_KMER_EXTRACTION
+    return kmer_hash64(km, sr->sid, sr->hoco_s, sr->m_pos[n], w);
+#else
+    return kmer_hash64(km, sr->hoco_s, sr->m_pos[n], w);
+#endif
+}
+
 typedef struct {
     int n_reads;
     uint64_t *sid;
@@ -233,8 +244,21 @@ typedef struct {
     char **seq;
     int *len;
     sr_db_t *sr_db;
+    sr_bait_t *bait; // keep only reads recruited by the baits if not NULL
+    void *km; // thread-local scratch arena
 } p_data_t;
 
+// reset the scratch arena when an outlier read blew it up
+#define SR_KM_MAX_CAP (1ULL<<26)
+
+// copy an arena-backed vector to an exactly sized heap array owned by the read
+#define kv_export(type, v, p) do { \
+    if ((v).n) { \
+        MYMALLOC((p), (v).n); \
+        memcpy((p), (v).a, sizeof(type) * (v).n); \
+    } else (p) = 0; \
+} while (0)
+
 static inline int q_next(int i, int q)
 {
     ++i;
@@ -251,6 +275,7 @@ static void *sr_read_analysis_thread(void *args)
     assert(k > 0 && k < 32 && w > k);
 
     int r;
+    void *km = dat->km;
     for (r = 0; r < dat->n_reads; ++r) {
         sr_t sr;
         sr.sid = dat->sid[r];
@@ -262,7 +287,6 @@ static void *sr_read_analysis_thread(void *args)
         kvec_t(uint8_t) hoco_s, ho_rl;
         kvec_t(uint32_t) ho_l_rl, n_nucl, m_pos;
         kvec_t(uint64_t) s_mer;
-        kvec_t(uint64_t) k_mer;
     
         kv_init(hoco_s);
         kv_init(ho_rl);
@@ -270,20 +294,21 @@ static void *sr_read_analysis_thread(void *args)
         kv_init(n_nucl);
         kv_init(m_pos);
         kv_init(s_mer);
-        kv_init(k_mer);
 
         int q = w - k + 1; // buf q size
         uint64_t m, s, z, mz, shift1 = 2 * (k - 1), mask = (1ULL<<2*k) - 1, kmer[2] = {0, 0}, buf_m[q], buf_s[q];
         int i, j, l, c, neq, rl, hoco_l, buf_pos, mz_pos;
+        uint32_t n_rl;
 
         MYBONE(buf_m, q);
         MYBONE(buf_s, q);
         mz = UINT64_MAX; // minimizer
         l = hoco_l = buf_pos = mz_pos = 0;
+        n_rl = 0;
         for (i = 0; i < len; ++i) {
             c = seq_nt4_table[(uint8_t) seq[i]];
             m = s = UINT64_MAX;
-            if ((hoco_l++ & 3) == 0) kv_push(uint8_t, hoco_s, 0);
+            if ((hoco_l++ & 3) == 0) kv_push_km(uint8_t, km, hoco_s, 0);
             if (c < 4) { // not an ambiguous base
                 // hoco_s.a[hoco_s.n - 1] = hoco_s.a[hoco_s.n - 1] << 2 | c;
                 if (c) hoco_s.a[hoco_s.n - 1] |= c << ((((hoco_l-1)&3)^3)<<1); // 6 - ((hoco_l - 1) % 4) << 1;
@@ -297,10 +322,13 @@ static void *sr_read_analysis_thread(void *args)
                     i += rl - 1; // put $i at the end of the current homopolymer run
                 }
 #endif
-                if (rl > 255)
-                    kv_push(uint32_t, ho_l_rl, rl - 1);
-                rl = MIN(rl, 256);
-                kv_push(uint8_t, ho_rl, rl - 1);
+                if (rl > SR_RL_ESC) {
+                    kv_push_km(uint32_t, km, ho_l_rl, n_rl);
+                    kv_push_km(uint32_t, km, ho_l_rl, rl - 1);
+                    rl = SR_RL_ESC + 1;
+                }
+                if (n_rl++ & 1) ho_rl.a[ho_rl.n - 1] |= (rl - 1) << 4;
+                else kv_push_km(uint8_t, km, ho_rl, rl - 1);
             
                 ++l;
                 kmer[0] = (kmer[0] << 2 | c) & mask;           // forward k-mer
@@ -316,23 +344,18 @@ static void *sr_read_analysis_thread(void *args)
                 // ambiguous bases are converted to base 'A'
                 // ambiguous bases are not homopolymer compressed
                 // hoco_s.a[hoco_s.n - 1] <<= 2;
-                kv_push(uint32_t, n_nucl, i);
+                kv_push_km(uint32_t, km, n_nucl, i);
                 l = 0;
             }
 
             if (buf_pos == mz_pos && mz != UINT64_MAX && l > w) {
                 // open syncmer
                 z = buf_s[buf_pos] & 1;
-                kv_push(uint64_t, s_mer, buf_s[buf_pos]);
-                kv_push(uint32_t, m_pos, (hoco_l - w - 1) << 1 | z);
-#ifdef DEBUG_KMER_EXTRACTION
-                kv_push(uint64_t, k_mer, kmer_hash64(sr.sid, hoco_s.a, m_pos.a[m_pos.n-1], w));
-#else
-                kv_push(uint64_t, k_mer, kmer_hash64(hoco_s.a, m_pos.a[m_pos.n-1], w));
-#endif
+                kv_push_km(uint64_t, km, s_mer, buf_s[buf_pos]);
+                kv_push_km(uint32_t, km, m_pos, (hoco_l - w - 1) << 1 | z);
                 // remove syncmers at the same position on a read
                 // this is possible as a syncmer could start and end with the same smer
-                if (m_pos.n >= 2 && m_pos.a[m_pos.n-1] >> 1 == m_pos.a[m_pos.n-2] >> 1) s_mer.n -= 2, m_pos.n -= 2, k_mer.n -= 2;
+                if (m_pos.n >= 2 && m_pos.a[m_pos.n-1] >> 1 == m_pos.a[m_pos.n-2] >> 1) s_mer.n -= 2, m_pos.n -= 2;
             }
             
             buf_m[buf_pos] = m;
@@ -341,13 +364,8 @@ static void *sr_read_analysis_thread(void *args)
                 if (l >= w) {
                     // close syncmer
                     z = s & 1;
-                    kv_push(uint64_t, s_mer, s^1);
-                    kv_push(uint32_t, m_pos, (hoco_l - w) << 1 | z);
-#ifdef DEBUG_KMER_EXTRACTION
-                    kv_push(uint64_t, k_mer, kmer_hash64(sr.sid, hoco_s.a, m_pos.a[m_pos.n-1], w));
-#else
-                    kv_push(uint64_t, k_mer, kmer_hash64(hoco_s.a, m_pos.a[m_pos.n-1], w));
-#endif
+                    kv_push_km(uint64_t, km, s_mer, s^1);
+                    kv_push_km(uint32_t, km, m_pos, (hoco_l - w) << 1 | z);
                 }
                 if (m < mz) mz = m, mz_pos = buf_pos;
             }
@@ -364,13 +382,8 @@ static void *sr_read_analysis_thread(void *args)
                     // newly added S-mer is a minimizer
                     // close syncmer
                     z = s & 1;
-                    kv_push(uint64_t, s_mer, s^1);
-                    kv_push(uint32_t, m_pos, (hoco_l - w) << 1 | z);
-#ifdef DEBUG_KMER_EXTRACTION
-                    kv_push(uint64_t, k_mer, kmer_hash64(sr.sid, hoco_s.a, m_pos.a[m_pos.n-1], w));
-#else
-                    kv_push(uint64_t, k_mer, kmer_hash64(hoco_s.a, m_pos.a[m_pos.n-1], w));
-#endif
+                    kv_push_km(uint64_t, km, s_mer, s^1);
+                    kv_push_km(uint32_t, km, m_pos, (hoco_l - w) << 1 | z);
                 }
             }
             
@@ -381,62 +394,99 @@ static void *sr_read_analysis_thread(void *args)
         if (buf_pos == mz_pos && mz != UINT64_MAX && l >= w) { // not (l > w) as l no self increment yet
             // open syncmer
             z = buf_s[buf_pos] & 1;
-            kv_push(uint64_t, s_mer, buf_s[buf_pos]);
-            kv_push(uint32_t, m_pos, (hoco_l - w) << 1 | z); // not (hoco_l - w - 1) as hoco_l no self increment yet
-#ifdef DEBUG_KMER_EXTRACTION
-            kv_push(uint64_t, k_mer, kmer_hash64(sr.sid, hoco_s.a, m_pos.a[m_pos.n-1], w));
-#else
-            kv_push(uint64_t, k_mer, kmer_hash64(hoco_s.a, m_pos.a[m_pos.n-1], w));
-#endif
-            if (m_pos.n >= 2 && m_pos.a[m_pos.n-1] >> 1 == m_pos.a[m_pos.n-2] >> 1) s_mer.n -= 2, m_pos.n -= 2, k_mer.n -= 2;
+            kv_push_km(uint64_t, km, s_mer, buf_s[buf_pos]);
+            kv_push_km(uint32_t, km, m_pos, (hoco_l - w) << 1 | z); // not (hoco_l - w - 1) as hoco_l no self increment yet
+            if (m_pos.n >= 2 && m_pos.a[m_pos.n-1] >> 1 == m_pos.a[m_pos.n-2] >> 1) s_mer.n -= 2, m_pos.n -= 2;
         }
     
-        if (hoco_s.n) MYREALLOC(hoco_s.a, hoco_s.n);
-        if (ho_rl.n) MYREALLOC(ho_rl.a, ho_rl.n);
-        if (ho_l_rl.n) MYREALLOC(ho_l_rl.a, ho_l_rl.n);
-        if (n_nucl.n) MYREALLOC(n_nucl.a, n_nucl.n);
-        if (m_pos.n) MYREALLOC(m_pos.a, m_pos.n);
-        if (s_mer.n) MYREALLOC(s_mer.a, s_mer.n);
-        if (k_mer.n) MYREALLOC(k_mer.a, k_mer.n);
-
-        sr.hoco_l = hoco_l;
-        sr.hoco_s = hoco_s.a;
-        sr.ho_rl = ho_rl.a;
-        sr.ho_l_rl = ho_l_rl.a;
-        sr.n_nucl = n_nucl.a;
-        sr.n = m_pos.n;
-        sr.m_pos = m_pos.a;
-        sr.s_mer = s_mer.a;
-        sr.k_mer = k_mer.a;
-        kv_push(sr_t, *dat->sr_db, sr);
+        if (dat->bait && sr_bait_count(dat->bait, s_mer.a, s_mer.n) < dat->bait->min_hit) {
+            // not recruited; dropped before anything is copied out of the arena
+            // a zero length tells the caller the read was not kept
+            free(sr.sname);
+            dat->len[r] = 0;
+        } else {
+            sr.hoco_l = hoco_l;
+            kv_export(uint8_t, hoco_s, sr.hoco_s);
+            kv_export(uint8_t, ho_rl, sr.ho_rl);
+            if (ho_l_rl.n) {
+                // the first number is the number of long runs
+                MYMALLOC(sr.ho_l_rl, ho_l_rl.n + 1);
+                sr.ho_l_rl[0] = ho_l_rl.n >> 1;
+                memcpy(sr.ho_l_rl + 1, ho_l_rl.a, sizeof(uint32_t) * ho_l_rl.n);
+            } else sr.ho_l_rl = 0;
+            if (n_nucl.n) {
+                // the first number is the number of ambiguous bases
+                MYMALLOC(sr.n_nucl, n_nucl.n + 1);
+                sr.n_nucl[0] = n_nucl.n;
+                memcpy(sr.n_nucl + 1, n_nucl.a, sizeof(uint32_t) * n_nucl.n);
+            } else sr.n_nucl = 0;
+            sr.n = m_pos.n;
+            kv_export(uint32_t, m_pos, sr.m_pos);
+            kv_export(uint64_t, s_mer, sr.s_mer);
+            sr.k_mer = 0; // kmers are hashed and numbered when syncmers are collected
+            kv_push(sr_t, *dat->sr_db, sr);
+        }
+
+        // the arena only needs a reset after an outlier read
+        int trim = hoco_s.m + ho_rl.m + (ho_l_rl.m + n_nucl.m + m_pos.m) * sizeof(uint32_t) +
+            s_mer.m * sizeof(uint64_t) > SR_KM_MAX_CAP;
+        kv_destroy_km(km, hoco_s);
+        kv_destroy_km(km, ho_rl);
+        kv_destroy_km(km, ho_l_rl);
+        kv_destroy_km(km, n_nucl);
+        kv_destroy_km(km, m_pos);
+        kv_destroy_km(km, s_mer);
+        if (trim) km = km_trim(km, SR_KM_MAX_CAP);
 
         free(seq);
     }
+    dat->km = km;
     
     return NULL;
 }
 
-static void do_analysis(p_data_t *dat, pthread_t *threads, int n_threads, sr_db_t *sr_db)
+static void sr_read_analysis_for(void *_data, long i, int tid) // kt_for() callback
 {
-    int t;
-    for (t = 1; t < n_threads; ++t)
-        pthread_create(threads + t, NULL, sr_read_analysis_thread, &dat[t]);
-
-    sr_read_analysis_thread(dat);
+    sr_read_analysis_thread((p_data_t *) _data + i);
+}
 
-    for (t = 1; t < n_threads; ++t)
-        pthread_join(threads[t], NULL);
+// if D is not NULL, the bases of the kept reads are added to *D and
+// the reads past the data limit mD are dropped; returns 1 if the limit is reached
+static int do_analysis(p_data_t *dat, const kt_ctx_t *kc, sr_db_t *sr_db, size_t *D, size_t mD)
+{
+    int t, full, n_threads = kc->n_threads;
+    size_t i, r, m;
+    // one job per batch slot; each slot has its own arena so tid is not needed
+    kt_ctx_for(kc, sr_read_analysis_for, dat, n_threads);
 
+    full = 0;
     for (t = 0; t < n_threads; ++t) {
+        m = dat[t].sr_db->n;
+        if (D) {
+            // slots hold the reads in input order; dropped reads have zero length
+            for (r = i = 0; r < (size_t) dat[t].n_reads && i < m && !full; ++r) {
+                if (dat[t].len[r] == 0) continue;
+                ++i;
+                *D += dat[t].len[r];
+                if (*D >= mD) full = 1;
+            }
+            if (full) {
+                while (m > i) sr_destroy(&dat[t].sr_db->a[--m]);
+                dat[t].sr_db->n = m;
+            }
+        }
+        // reads dropped by the baits leave gaps; seq ids are indices into sr_db
+        for (i = 0; i < dat[t].sr_db->n; ++i)
+            dat[t].sr_db->a[i].sid = sr_db->n + i;
         kv_pushn(sr_t, *sr_db, dat[t].sr_db->a, dat[t].sr_db->n);
         dat[t].n_reads = 0;
         dat[t].sr_db->n = 0;
     }
 
-    return;
+    return full;
 }
 
-static void sr_read_single_thread(sstream_t *s_stream, sr_db_t *sr_db, size_t mD)
+static void sr_read_single_thread(sstream_t *s_stream, sr_db_t *sr_db, size_t mD, sr_bait_t *bait)
 {
     sr_db_clean(sr_db);
     sr_db_init(sr_db, sr_db->k, sr_db->s);
@@ -452,19 +502,20 @@ static void sr_read_single_thread(sstream_t *s_stream, sr_db_t *sr_db, size_t mD
     MYMALLOC(dat->seq, 1);
     MYMALLOC(dat->len, 1);
     dat->sr_db = sr_db;
+    dat->bait = bait;
+    dat->km = km_init();
 
     int l;
-    uint64_t i;
     size_t D;
-    i = 0;
     D = 0;
     while ((l = sstream_read(s_stream)) >= 0) {
-        dat->sid[0] = i++;
+        dat->sid[0] = sr_db->n;
         dat->name[0] = strdup(s_stream->s->ks->name.s);
         dat->seq[0] = strdup(s_stream->s->ks->seq.s);
         dat->len[0] = l;
         sr_read_analysis_thread(dat);
-        D += l;
+        // with baits only the recruited reads count towards the data limit
+        D += dat->len[0];
         if (D >= mD) {
             fprintf(stderr, "[M::%s] data limit (%lu) reached. Discard the remaining sequences...\n", __func__, mD);
             break;
@@ -475,16 +526,18 @@ static void sr_read_single_thread(sstream_t *s_stream, sr_db_t *sr_db, size_t mD
     free(dat->name);
     free(dat->seq);
     free(dat->len);
+    km_destroy(dat->km);
     free(dat);
 
     return;
 }
 
-void sr_read(sstream_t *s_stream, sr_db_t *sr_db, size_t mD, int n_threads)
+void sr_read(sstream_t *s_stream, sr_db_t *sr_db, size_t mD, sr_bait_t *bait, const kt_ctx_t *kc)
 {
+    int n_threads = kc? kc->n_threads : 1;
     if (n_threads == 1) {
-        sr_read_single_thread(s_stream, sr_db, mD);
-        return;
+        sr_read_single_thread(s_stream, sr_db, mD, bait);
+        goto do_report;
     }
 
     sr_db_clean(sr_db);
@@ -507,14 +560,16 @@ void sr_read(sstream_t *s_stream, sr_db_t *sr_db, size_t mD, int n_threads)
         MYMALLOC(dat[t].sr_db, 1);
         sr_db_init(dat[t].sr_db, sr_db->k, sr_db->s);
         kv_resize(sr_t, *dat[t].sr_db, batch_n);
+        dat[t].bait = bait;
+        dat[t].km = km_init();
     }
 
-    pthread_t threads[n_threads];
-    int l;
+    int l, full;
     uint64_t i, j, n;
     size_t D;
     i = j = n = 0;
     D = 0;
+    full = 0;
     while ((l = sstream_read(s_stream)) >= 0) {
         t = j / batch_n;
         n = dat[t].n_reads;
@@ -526,17 +581,23 @@ void sr_read(sstream_t *s_stream, sr_db_t *sr_db, size_t mD, int n_threads)
 
         ++i, ++j;
         if (j == batch_n * n_threads) {
-            do_analysis(dat, threads, n_threads, sr_db);
+            // with baits only the recruited reads count towards the data limit
+            full = do_analysis(dat, kc, sr_db, bait? &D : 0, mD);
             j = 0;
+            if (full) break;
         }
 
-        D += l;
-        if (D >= mD) {
-            fprintf(stderr, "[M::%s] data limit (%lu) reached. Discard the remaining sequences...\n", __func__, mD);
-            break;
+        if (!bait) {
+            D += l;
+            if (D >= mD) {
+                full = 1;
+                break;
+            }
         }
     }
-    if (j > 0) do_analysis(dat, threads, n_threads, sr_db);
+    if (j > 0 && do_analysis(dat, kc, sr_db, bait? &D : 0, mD)) full = 1;
+    if (full)
+        fprintf(stderr, "[M::%s] data limit (%lu) reached. Discard the remaining sequences...\n", __func__, mD);
 
     for (t = 0; t < n_threads; ++t) {
         free(dat[t].sid);
@@ -545,12 +606,60 @@ void sr_read(sstream_t *s_stream, sr_db_t *sr_db, size_t mD, int n_threads)
         free(dat[t].len);
         free(dat[t].sr_db->a);
         free(dat[t].sr_db);
+        km_destroy(dat[t].km);
     }
     free(dat);
 
+do_report:
+    if (bait)
+        fprintf(stderr, "[M::%s] %lu of %lu sequence(s) recruited by %lu bait syncmers\n", __func__,
+                sr_db->n, s_stream->n_seq, sr_bait_size(bait));
     return;
 }
 
+KHASHL_SET_INIT(KH_LOCAL, kh_bait_t, kh_bait, uint64_t, kh_hash_uint64, kh_eq_generic)
+
+sr_bait_t *sr_bait_init(uint32_t min_hit)
+{
+    sr_bait_t *bait;
+    MYCALLOC(bait, 1);
+    bait->min_hit = min_hit > 0? min_hit : 1;
+    bait->h = kh_bait_init();
+    return bait;
+}
+
+void sr_bait_destroy(sr_bait_t *bait)
+{
+    if (!bait) return;
+    kh_bait_destroy((kh_bait_t *) bait->h);
+    free(bait);
+}
+
+// add the smer of a syncmer as in sr_t s_mer or syncmer_t s; return 1 if it is new
+size_t sr_bait_add(sr_bait_t *bait, uint64_t s)
+{
+    int absent;
+    kh_bait_put((kh_bait_t *) bait->h, s >> 1, &absent);
+    return absent > 0;
+}
+
+size_t sr_bait_size(sr_bait_t *bait)
+{
+    return kh_size((kh_bait_t *) bait->h);
+}
+
+// number of syncmers of a read in the bait set, counting stops at min_hit
+// lookups only so safe to call from many threads
+uint32_t sr_bait_count(sr_bait_t *bait, uint64_t *s_mer, uint32_t n)
+{
+    kh_bait_t *h = (kh_bait_t *) bait->h;
+    uint32_t i, c;
+    for (i = c = 0; i < n && c < bait->min_hit; ++i)
+        if (kh_bait_get(h, s_mer[i] >> 1) != kh_end(h))
+            ++c;
+    return c;
+}
+
 KHASHL_MAP_INIT(KH_LOCAL, kh_ctab_t, kh_ctab, khint_t, int, kh_hash_uint32, kh_eq_generic)
 
 static int syncmer_s_cmpfunc(const void *a, const void *b)
@@ -860,9 +969,27 @@ static int ha_analyze_count(int n_cnt, int start_cnt, const int64_t *cnt, int *p
     }
 }
 
-void sr_db_stat(sr_db_t *sr_db, FILE *fo, int verbose)
+// heap bytes held by a read, allocator overhead not included
+static size_t sr_mem_size(sr_t *sr)
+{
+    size_t m;
+    uint32_t n_amb;
+    n_amb = sr->n_nucl? sr->n_nucl[0] : 0;
+    m = sizeof(sr_t);
+    if (sr->sname) m += strlen(sr->sname) + 1;
+    m += (sr->hoco_l + 3) / 4;
+    m += sr_rl_size(sr->hoco_l - n_amb);
+    if (sr->ho_l_rl) m += (sr->ho_l_rl[0] * 2 + 1) * sizeof(uint32_t);
+    if (n_amb) m += (n_amb + 1) * sizeof(uint32_t);
+    m += (size_t) sr->n * sizeof(uint32_t);
+    if (sr->s_mer) m += (size_t) sr->n * sizeof(uint64_t);
+    if (sr->k_mer) m += (size_t) sr->n * sizeof(uint32_t);
+    return m;
+}
+
+void sr_db_stat(sr_db_t *sr_db, syncmer_db_t *scm_db, FILE *fo, int verbose)
 {
-    size_t i, j, n, m;
+    size_t i, j, n, m, hoco_l, mem;
     int c, w, p0, p1;
     uint64_t s;
     uint64_t h;
@@ -883,13 +1010,15 @@ void sr_db_stat(sr_db_t *sr_db, FILE *fo, int verbose)
     kv_init(syncmers);
     w = sr_db->k;
     n = sr_db->n;
-    m = 0;
+    m = hoco_l = mem = 0;
     for (i = 0; i < n; ++i) {
         sr_t s = sr_db->a[i];
         m += s.n;
+        hoco_l += s.hoco_l;
+        mem += sr_mem_size(&s);
         p0 = p1 = MAX_RD_LEN;
         for (j = 0; j < s.n; ++j) {
-            syncmer_t a = {s.k_mer[j] >> 1, s.s_mer[j], 0, 0, 0};
+            syncmer_t a = {s.k_mer[j] >> 1, scm_db->a[s.k_mer[j] >> 1].s, 0, 0, 0};
             kv_push(syncmer_t, syncmers, a);
             p0 = p1;
             p1 = s.m_pos[j] >> 1;
@@ -984,6 +1113,7 @@ void sr_db_stat(sr_db_t *sr_db, FILE *fo, int verbose)
 
     fprintf(fo, "[M::%s] number syncmers collected: %lu\n", __func__, m);
     fprintf(fo, "[M::%s] number syncmers per read: %.3f\n", __func__, (double) m / n);
+    fprintf(fo, "[M::%s] read storage: %.1f bytes per read; %.3f bytes per hoco base\n", __func__, (double) mem / n, (double) mem / hoco_l);
     fprintf(fo, "[M::%s] average kmer space: %.3f\n", __func__, dist);
     fprintf(fo, "[M::%s] number uniqe smer: %d; singletons: %d (%.3f%%)\n", __func__, smeru, smer1, (double) smer1 * 100 / smeru);
     fprintf(fo, "[M::%s] average smer count: %.3f\n", __func__, smera);
@@ -1059,15 +1189,54 @@ void sr_db_init(sr_db_t *sr_db, int k, int s)
     kv_init(*sr_db);
     sr_db->k = k;
     sr_db->s = s;
+    sr_db->dup = 0;
+    sr_db->collected = 0;
     sr_db->stats = 0;
 }
 
+// only the syncmer lists, which error correction and syncmer collection rewrite, are copied
+// names and hoco sequences are shared so the source must outlive the copy
+sr_db_t *sr_db_dup(sr_db_t *sr_db)
+{
+    size_t i;
+    sr_t *sr, *sr1;
+    sr_db_t *sr_db1;
+    MYMALLOC(sr_db1, 1);
+    sr_db_init(sr_db1, sr_db->k, sr_db->s);
+    sr_db1->dup = 1;
+    sr_db1->collected = sr_db->collected;
+    sr_db1->n = sr_db1->m = sr_db->n;
+    MYMALLOC(sr_db1->a, sr_db->n);
+    for (i = 0; i < sr_db->n; ++i) {
+        sr = &sr_db->a[i];
+        sr1 = &sr_db1->a[i];
+        *sr1 = *sr;
+        sr1->s_mer = 0; // only kept before syncmer collection
+        MYMALLOC(sr1->m_pos, sr->n);
+        MYMALLOC(sr1->k_mer, sr->n);
+        memcpy(sr1->m_pos, sr->m_pos, sizeof(uint32_t) * sr->n);
+        memcpy(sr1->k_mer, sr->k_mer, sizeof(uint32_t) * sr->n);
+    }
+    if (sr_db->stats) {
+        MYMALLOC(sr_db1->stats, 1);
+        *sr_db1->stats = *sr_db->stats;
+    }
+    return sr_db1;
+}
+
 void sr_db_clean(sr_db_t *sr_db)
 {
     if (!sr_db) return;
     size_t i;
-    for (i = 0; i < sr_db->n; ++i)
-        sr_destroy(&sr_db->a[i]);
+    for (i = 0; i < sr_db->n; ++i) {
+        if (sr_db->dup) {
+            free(sr_db->a[i].m_pos);
+            free(sr_db->a[i].s_mer);
+            free(sr_db->a[i].k_mer);
+        } else {
+            sr_destroy(&sr_db->a[i]);
+        }
+    }
     kv_destroy(*sr_db);
     free(sr_db->stats);
 }
@@ -1105,6 +1274,30 @@ void syncmer_db_destroy(syncmer_db_t *scm_db)
     free(scm_db);
 }
 
+syncmer_db_t *syncmer_db_dup(syncmer_db_t *scm_db)
+{
+    size_t i;
+    syncmer_db_t *scm_db1;
+    MYMALLOC(scm_db1, 1);
+    syncmer_db_init(scm_db1);
+    scm_db1->n = scm_db1->m = scm_db->n;
+    MYMALLOC(scm_db1->a, scm_db->n);
+    for (i = 0; i < scm_db->n; ++i) {
+        scm_db1->a[i] = scm_db->a[i];
+        MYMALLOC(scm_db1->a[i].m_pos, scm_db->a[i].cov);
+        memcpy(scm_db1->a[i].m_pos, scm_db->a[i].m_pos, sizeof(uint64_t) * scm_db->a[i].cov);
+    }
+    if (scm_db->c) {
+        MYMALLOC(scm_db1->c, scm_db->n);
+        memcpy(scm_db1->c, scm_db->c, sizeof(uint16_t) * scm_db->n);
+    }
+    if (scm_db->h) {
+        MYMALLOC(scm_db1->h, scm_db->n);
+        memcpy(scm_db1->h, scm_db->h, sizeof(uint64_t) * scm_db->n);
+    }
+    return scm_db1;
+}
+
 static void fputs_smer(uint64_t s, int k, FILE *fo)
 {
     int i;
@@ -1159,12 +1352,12 @@ void print_syncmer_on_seq(sr_t *sr, uint32_t n, int k, int w, FILE *fo)
 {
     if (n >= sr->n) return;
     if ((sr->m_pos[n]>>1) == MAX_RD_LEN) return; // this is a corrected mer
-    fprintf(fo, ">%lu_%d_%u_%lu_%u\t", sr->sid, n, sr->m_pos[n] >> 1, sr->s_mer[n] & 1, sr->m_pos[n] & 1);
-    fprintf(fo, "RD:Z:%lu\t", sr->sid);
+    fprintf(fo, ">%u_%d_%u_%lu_%u\t", sr->sid, n, sr->m_pos[n] >> 1, sr->s_mer[n] & 1, sr->m_pos[n] & 1);
+    fprintf(fo, "RD:Z:%u\t", sr->sid);
     fprintf(fo, "MM:Z:");
     fputs_smer(sr->s_mer[n] >> 1, k, fo);
     fputc('\t', fo);
-    fprintf(fo, "KH:Z:%lu\n", sr->k_mer[n]);
+    fprintf(fo, "KH:Z:%lu\n", sr_kmer_hash(0, sr, n, w));
     fputs_kmer(sr->hoco_s, sr->m_pos[n], w, fo);
     fputc('\n', fo);
 }
@@ -1261,10 +1454,10 @@ static inline int equal_array(void *a, void *b, int n)
 // process a cluster of kmers with the same hash value
 // check hash collisions
 // add kmer to database
-static void process_kmer_cluster(uint128_t *scm, uint32_t n, syncmer_db_t *scm_db, sr_db_t *sr_db)
+static void process_kmer_cluster(void *km, uint128_t *scm, uint32_t n, syncmer_db_t *scm_db, sr_db_t *sr_db)
 {
     int n_clus, *clus;
-    MYMALLOC(clus, n);
+    KMALLOC(km, clus, n);
 
     if (n == 1) {
         // no hash collision for sure
@@ -1282,7 +1475,7 @@ static void process_kmer_cluster(uint128_t *scm, uint32_t n, syncmer_db_t *scm_d
         C = B >> 3; // number of comparsions of 64bit interger
         n_clus = 0;
         kmer_list = 0;
-        MYMALLOC(kmer, B);
+        KMALLOC(km, kmer, B);
 
         for (s = 0; s < n; ++s) {
             sid = (uint64_t) scm[s] >> 32;
@@ -1321,7 +1514,7 @@ static void process_kmer_cluster(uint128_t *scm, uint32_t n, syncmer_db_t *scm_d
                 // new kmer
                 // add to kmer list
                 ++n_clus;
-                MYREALLOC(kmer_list, n_clus * B);
+                KREALLOC(km, kmer_list, n_clus * B);
                 memcpy(&kmer_list[(n_clus - 1) * B], kmer, B);
             }
         }
@@ -1330,13 +1523,13 @@ static void process_kmer_cluster(uint128_t *scm, uint32_t n, syncmer_db_t *scm_d
         for (i = 0; i < n_clus; ++i)
             assert(h64 == MurmurHash64A(&kmer_list[i * B], (k - 1) / 4 + 1, murmur3_seed));
 #endif
-        free(kmer);
-        free(kmer_list);
+        kfree(km, kmer);
+        kfree(km, kmer_list);
     }
 
     // add each cluster to syncmer database
     uint32_t s, *cnts;
-    MYCALLOC(cnts, n_clus);
+    KCALLOC(km, cnts, n_clus);
     for (s = 0; s < n; ++s)
         ++cnts[clus[s]];
 
@@ -1380,34 +1573,75 @@ static void process_kmer_cluster(uint128_t *scm, uint32_t n, syncmer_db_t *scm_d
     }
 #endif    
 
-    free(cnts);
-    free(clus);
+    kfree(km, cnts);
+    kfree(km, clus);
+}
+
+typedef struct {
+    sr_db_t *sr_db;
+    uint64_t *off; // first slot of each read in a
+    uint128_t *a; // kmer hash << 64 | sid << 32 | index << 1 | rev
+    void **km; // per-thread scratch arena
+} scm_hash_t;
+
+static void scm_hash_for(void *_data, long i, int tid)
+{
+    scm_hash_t *d = (scm_hash_t *) _data;
+    sr_t *s = &d->sr_db->a[i];
+    uint128_t *a = &d->a[d->off[i]];
+    uint64_t j;
+    for (j = 0; j < s->n; ++j)
+        a[j] = (uint128_t) sr_kmer_hash(d->km[tid], s, j, d->sr_db->k) << 64 |
+            (((uint64_t) s->sid << 32) | (j << 1) | (s->m_pos[j] & 1));
 }
 
 // make syncmer database from reads
-// change the read kmer hash to kmer id
-syncmer_db_t *collect_syncmer_from_reads(sr_db_t *sr_db)
+// set the read kmer ids and free the read smers
+syncmer_db_t *collect_syncmer_from_reads(sr_db_t *sr_db, const kt_ctx_t *kc)
 {
-    size_t i, j;
+    size_t i;
     uint64_t n1, n2;
+    int t, n_threads;
     sr_t *s;
     kvec_t(uint128_t) scm;
+    scm_hash_t hd;
     kv_init(scm);
     n1 = 0;
+    MYMALLOC(hd.off, sr_db->n);
     for (i = 0; i < sr_db->n; ++i) {
         s = &sr_db->a[i];
         assert(s->sid == i);
+        hd.off[i] = n1;
         n1 += s->n;
-        for (j = 0; j < s->n; ++j) {
-            uint128_t s1 = (uint128_t) s->k_mer[j] << 64 | ((s->sid << 32) | (j << 1) | (s->m_pos[j] & 1));
-            kv_push(uint128_t, scm, s1);
-        }
     }
-    if (scm.n == 0) {
-        kv_destroy(scm);
+    if (n1 > MAX_SCM_NUM) {
+        fprintf(stderr, "[E::%s] syncmer number exceeds the limit %llu\n", __func__, MAX_SCM_NUM);
+        exit(EXIT_FAILURE);
+    }
+    if (n1 == 0) {
+        free(hd.off);
         return 0;
     }
 
+    // kmers are hashed here rather than kept on the reads
+    n_threads = kc? kc->n_threads : 1;
+    MYMALLOC(scm.a, n1);
+    scm.n = scm.m = n1;
+    MYMALLOC(hd.km, n_threads);
+    for (t = 0; t < n_threads; ++t) hd.km[t] = km_init();
+    hd.sr_db = sr_db, hd.a = scm.a;
+    kt_ctx_for(kc, scm_hash_for, &hd, sr_db->n);
+    for (t = 0; t < n_threads; ++t) km_destroy(hd.km[t]);
+    free(hd.km);
+    free(hd.off);
+
+    for (i = 0; i < sr_db->n; ++i) {
+        s = &sr_db->a[i];
+        free(s->k_mer);
+        s->k_mer = 0;
+        if (s->n) MYMALLOC(s->k_mer, s->n);
+    }
+
     qsort(scm.a, scm.n, sizeof(uint128_t), uint128_cmpfunc);
 
     // pack syncmers by kmer hash
@@ -1415,20 +1649,30 @@ syncmer_db_t *collect_syncmer_from_reads(sr_db_t *sr_db)
     syncmer_db_t *scm_db;
     size_t last;
     uint64_t h64;
+    void *km;
+    km = km_init();
     MYMALLOC(scm_db, 1);
     syncmer_db_init(scm_db);
     h64 = (uint64_t) (scm.a[0] >> 64);
     for (i = 1, last = 0; i < scm.n; ++i) {
         if ((uint64_t) (scm.a[i] >> 64) != h64) {
             // process kmer cluster
-            process_kmer_cluster(&scm.a[last], i - last, scm_db, sr_db);
+            process_kmer_cluster(km, &scm.a[last], i - last, scm_db, sr_db);
 
             last = i;
             h64 = (uint64_t) (scm.a[i] >> 64);
         }
     }
-    process_kmer_cluster(&scm.a[last], i - last, scm_db, sr_db);
+    process_kmer_cluster(km, &scm.a[last], i - last, scm_db, sr_db);
     kv_destroy(scm);
+    km_destroy(km);
+
+    // the smers live on in the syncmer database
+    for (i = 0; i < sr_db->n; ++i) {
+        free(sr_db->a[i].s_mer);
+        sr_db->a[i].s_mer = 0;
+    }
+    sr_db->collected = 1;
 
     MYREALLOC(scm_db->a, scm_db->n);
     scm_db->m = scm_db->n;
@@ -34,6 +34,7 @@
 #include <stdint.h>
 
 #include "kstring.h"
+#include "kthread.h"
 #include "sstream.h"
 
 extern const unsigned char seq_nt4_table[256];
@@ -44,31 +45,48 @@ extern const char char_nt4_table[4];
 #define MAX_RD_NUM 0xFFFFFFFFULL
 #define MAX_RD_LEN 0x7FFFFFFFULL
 #define MAX_RD_SCM 0x7FFFFFFFULL
+#define MAX_SCM_NUM 0x7FFFFFFFULL
+
+#define SR_RL_ESC 15 // packed run length marking a long homopolymer run
+#define sr_rl_size(n) (((size_t) (n) + 1) >> 1) // bytes for n packed run lengths
 
 typedef struct {
-    uint64_t sid; // seq id
-    char *sname; // seq name
+    uint32_t sid; // seq id, bounded by MAX_RD_NUM
     uint32_t hoco_l; // hoco seq length
+    uint32_t n; // number s/kmer
+    char *sname; // seq name
     // homopolymer compressed seq
     // every byte packs 4 bases (00->A, 01->C, 10->G, 11->T)
     // ambiguous bases are converted to 'A'
     uint8_t *hoco_s;
-    // homopolymer run length (rl)
-    // the real rl of a position with rl=255 is stored in ho_l_rl
+    // homopolymer run length (rl) minus one
+    // every byte packs 2 positions, low nibble first
+    // the real rl of a position with packed value SR_RL_ESC is stored in ho_l_rl
     uint8_t *ho_rl;
-    // large homopolymer run length (>254)
+    // long homopolymer runs (>SR_RL_ESC)
+    // the first number stores the number of runs
+    // followed by (position, rl-1) pairs sorted by position
     // mostly would be NULL
     uint32_t *ho_l_rl;
     // positions of ambiguous bases [hoco space]
     // this first number stores the number of ambiguous bases
     // mostly would be NULL
     uint32_t *n_nucl;
-    uint32_t n; // number s/kmer
     uint32_t *m_pos; // s/kmer positions: pos << 1 | rev [hoco space]
-    uint64_t *s_mer; // smer << 1 | o/c
-    uint64_t *k_mer; // kmer id << 1 | ec error corrected
+    // smer << 1 | o/c
+    // freed once syncmers are collected; syncmer_t s holds the same smer
+    uint64_t *s_mer;
+    // kmer id << 1 | ec error corrected, bounded by MAX_SCM_NUM
+    // set when syncmers are collected
+    uint32_t *k_mer;
 } sr_t;
 
+// packed run length minus one at position i; SR_RL_ESC needs a ho_l_rl lookup
+static inline uint32_t sr_rl_get(const uint8_t *ho_rl, uint32_t i)
+{
+    return ho_rl[i>>1] >> ((i&1)<<2) & 15;
+}
+
 typedef struct {
     uint64_t syncmer_n;
     double syncmer_per_read, syncmer_avg_dist, smer_avg_cnt, kmer_avg_cnt;
@@ -80,6 +98,8 @@ typedef struct {
     size_t n, m;
     sr_t *a;
     int k, s; // kmer and smer size
+    int dup; // sequences are shared with the database this one was duplicated from
+    int collected; // syncmers are collected: kmer ids are set and smers are freed
     sr_stat_t *stats;
 } sr_db_t;
 
@@ -113,12 +133,20 @@ typedef struct {
     uint64_t *h;
 } syncmer_db_t;
 
+// syncmers of a related organelle genome used to recruit reads
+// syncmers are matched by their smer rather than the whole kmer
+// which rarely survives the divergence between species
+typedef struct {
+    uint32_t min_hit; // reads sharing fewer syncmers are dropped
+    void *h; // smer set
+} sr_bait_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void sr_read(sstream_t *s_stream, sr_db_t *sr_db, size_t m_data, int n_threads);
-syncmer_db_t *collect_syncmer_from_reads(sr_db_t *sr_db);
+void sr_read(sstream_t *s_stream, sr_db_t *sr_db, size_t m_data, sr_bait_t *bait, const kt_ctx_t *kc);
+syncmer_db_t *collect_syncmer_from_reads(sr_db_t *sr_db, const kt_ctx_t *kc);
 int syncmer_link_coverage_analysis(sr_db_t *sr_db, syncmer_db_t *scm_db, uint32_t min_k_cov, 
         uint32_t min_n_seq, uint32_t min_pt, double min_f, double **_beta, 
         double **_bse, double **_r2, int verbose);
@@ -133,11 +161,18 @@ void sr_destroy(sr_t *sr);
 void sr_db_init(sr_db_t *sr_db, int k, int s);
 void sr_db_clean(sr_db_t *sr_db);
 void sr_db_destroy(sr_db_t *sr_db);
+sr_db_t *sr_db_dup(sr_db_t *sr_db);
 int sr_db_validate(sr_db_t *sr_db);
-void sr_db_stat(sr_db_t *sr_db, FILE *fo, int more);
+void sr_db_stat(sr_db_t *sr_db, syncmer_db_t *scm_db, FILE *fo, int more);
 void syncmer_db_init(syncmer_db_t *scm_db);
 void syncmer_db_clean(syncmer_db_t *scm_db);
 void syncmer_db_destroy(syncmer_db_t *scm_db);
+syncmer_db_t *syncmer_db_dup(syncmer_db_t *scm_db);
+sr_bait_t *sr_bait_init(uint32_t min_hit);
+void sr_bait_destroy(sr_bait_t *bait);
+size_t sr_bait_add(sr_bait_t *bait, uint64_t h);
+size_t sr_bait_size(sr_bait_t *bait);
+uint32_t sr_bait_count(sr_bait_t *bait, uint64_t *s_mer, uint32_t n);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,45 @@
+#!/bin/sh
+# annotation cache: a sequence cached for one database only must be annotated
+# from scratch when a second database is added, without duplicated rows
+# usage: test/annot_cache.sh [oatk binary]
+set -e
+dir=$(cd "$(dirname "$0")" && pwd)
+oatk=${1:-$dir/../oatk}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+awk 'BEGIN { srand(11); printf("H\tVN:Z:1.0\n");
+	for (i = 1; i <= 3; ++i) { s = ""; for (j = 0; j < 6000; ++j) s = s substr("ACGT", int(rand() * 4) + 1, 1);
+		printf("S\tu%d\t%s\tLN:i:6000\tSC:f:30\n", i, s) } }' > "$tmp/g.gfa"
+echo mito > "$tmp/mito.fam"
+echo pltd > "$tmp/pltd.fam"
+
+run() { # prefix, extra options
+	p=$1; shift
+	"$oatk" -G -t 2 --nhmmscan "$dir/nhmmscan_stub.sh" --annot-cache "$cache" -o "$tmp/$p" "$@" "$tmp/g.gfa" 2> "$tmp/$p.log" || true
+}
+
+cache=$tmp/cache
+run ref -m "$tmp/mito.fam"
+run mp -m "$tmp/mito.fam" -p "$tmp/pltd.fam"
+run mp2 -m "$tmp/mito.fam" -p "$tmp/pltd.fam"
+
+n=$(grep -vc '^#' "$tmp/ref.annot_mito.txt")
+[ "$n" -gt 0 ] || { echo "FAIL: no annotation rows"; exit 1; }
+for p in mp mp2; do
+	cmp -s "$tmp/ref.annot_mito.txt" "$tmp/$p.annot_mito.txt" || { echo "FAIL: $p mito rows differ from the mito-only run"; exit 1; }
+	[ "$(grep -vc '^#' "$tmp/$p.annot_pltd.txt")" -eq "$n" ] || { echo "FAIL: $p pltd row count"; exit 1; }
+done
+grep -q "3 of 3 sequences found in the annotation cache" "$tmp/mp2.log" || { echo "FAIL: cache not used"; exit 1; }
+for f in "$tmp"/cache/*/*; do
+	[ "$(wc -l < "$f")" -le 3 ] || { echo "FAIL: cache entry $f grows"; exit 1; }
+done
+
+# sequences skipped by the prefilter must not be cached as having no hits
+awk 'BEGIN { srand(5); s = ""; for (j = 0; j < 3000; ++j) s = s substr("ACGT", int(rand() * 4) + 1, 1); print ">ref"; print s }' > "$tmp/ref.fa"
+cache=$tmp/cache2
+run pf -m "$tmp/mito.fam" --prefilter-min 5 --prefilter-ref "$tmp/ref.fa"
+grep -q "3 of 3 sequences .* skipped by the k-mer prefilter" "$tmp/pf.log" || { echo "FAIL: prefilter did not skip"; exit 1; }
+run nopf -m "$tmp/mito.fam"
+cmp -s "$tmp/ref.annot_mito.txt" "$tmp/nopf.annot_mito.txt" || { echo "FAIL: sequences skipped by the prefilter were cached"; exit 1; }
+echo "PASS: annotation cache"
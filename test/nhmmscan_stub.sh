@@ -0,0 +1,17 @@
+#!/bin/sh
+# stand-in for nhmmscan: one fixed hit per 2 kb of each query, written to --tblout
+tbl= in=
+while [ $# -gt 0 ]; do
+	case "$1" in
+		-h|--help) echo "nhmmscan stub"; exit 0 ;;
+		--tblout) tbl=$2; shift ;;
+	esac
+	in=$1
+	shift
+done
+[ "$in" = "-" ] && in=/dev/stdin
+awk 'BEGIN { print "# stub" }
+	/^>/ { if (n != "") emit(); n = substr($1, 2); l = 0; next }
+	{ l += length($0) }
+	END { if (n != "") emit(); print "# done" }
+	function emit(  p) { for (p = 1; p < l - 1000; p += 2000) printf("g%d - %s - 1 300 %d %d %d %d 300 + 1e-80 300.0 0.0 d\n", g++ % 40, n, p, p + 900, p, p + 900) }' "$in" > "$tbl"